@@ -71,9 +71,15 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
+#include "sdkconfig.h"
 #include "esp_partition.h"
 #include "esp_spi_flash.h"
+#include "soc/soc.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_memory_layout.h"
 
 #ifdef __GNUG__
 #pragma implementation "i_system.h"
@@ -85,9 +91,13 @@
 int realtime=0;
 
 
+//vTaskDelay only sleeps in whole RTOS ticks (10ms). Sleep all but the last one, spin the rest.
 void I_uSleep(unsigned long usecs)
 {
-	vTaskDelay(usecs/1000);
+	int64_t end=esp_timer_get_time()+usecs;
+	TickType_t ticks=usecs/(portTICK_PERIOD_MS*1000);
+	if (ticks>1) vTaskDelay(ticks-1);
+	while (esp_timer_get_time()<end) ;
 }
 
 static unsigned long getMsTicks() {
@@ -140,6 +150,17 @@ fixed_t I_GetTimeFrac (void)
 }
 
 
+unsigned long I_GetTime_NextTicUS(void)
+{
+  struct timeval tv;
+  int next;
+
+  gettimeofday(&tv, NULL);
+  //Same steps as I_GetTime_RealTime: the next multiple of 1/TICRATE s in this second.
+  next = tv.tv_usec * TICRATE / 1000000 + 1;
+  return (next * 1000000 + TICRATE - 1) / TICRATE - tv.tv_usec;
+}
+
 void I_GetTime_SaveMS(void)
 {
   if (!movement_smooth)
@@ -150,6 +171,11 @@ void I_GetTime_SaveMS(void)
   tic_vars.step = tic_vars.next - tic_vars.start;
 }
 
+unsigned long I_GetTimeUS(void)
+{
+	return esp_timer_get_time();
+}
+
 unsigned long I_GetRandomTimeSeed(void)
 {
 	return 4; //per https://xkcd.com/221/
@@ -176,6 +202,45 @@ typedef struct {
 
 static FileDesc fds[32];
 
+//The WAD partition mapped in one go, if it fits the MMU. I_Mmap then only adds the offset.
+//The mapping outlives I_Close: CheckIWAD closes the WAD just before W_Init opens it again.
+static const esp_partition_t *wadPart;
+static const uint8_t *wadBase;
+static int wadSize;
+static spi_flash_mmap_handle_t wadHandle;
+static mmapstats_t mmapStats;
+
+#if CONFIG_HW_WAD_MMAP_WHOLE
+static void mapWholeWad(const esp_partition_t *part) {
+	struct {
+		char id[4];
+		int numlumps, infotableofs;
+	} header;
+	int64_t t=esp_timer_get_time();
+	esp_err_t err;
+
+	if (wadBase && wadPart==part) return;
+	//Only map up to the end of the lump directory, the partition is usually bigger than the WAD.
+	wadSize=part->size;
+	if (esp_partition_read(part, 0, &header, sizeof(header))==ESP_OK &&
+			header.numlumps>0 && header.infotableofs>0 &&
+			header.infotableofs+header.numlumps*16<=part->size) {
+		wadSize=header.infotableofs+header.numlumps*16;
+	}
+	err=esp_partition_mmap(part, 0, wadSize, SPI_FLASH_MMAP_DATA, (const void**)&wadBase, &wadHandle);
+	if (err!=ESP_OK) {
+		lprintf(LO_INFO, "I_Open: WAD doesn't fit the MMU (%x), mapping lumps as needed\n", err);
+		wadBase=NULL;
+		return;
+	}
+	wadPart=part;
+	mmapStats.mappings=1;
+	mmapStats.pages=(part->address+wadSize-1)/SPI_FLASH_MMU_PAGE_SIZE-part->address/SPI_FLASH_MMU_PAGE_SIZE+1;
+	lprintf(LO_INFO, "I_Open: WAD mapped whole, %d bytes in %d MMU pages, %d us\n",
+			wadSize, mmapStats.pages, (int)(esp_timer_get_time()-t));
+}
+#endif
+
 int I_Open(const char *wad, int flags) {
 	int x=3;
 	while (fds[x].part!=NULL) x++;
@@ -187,6 +252,15 @@ int I_Open(const char *wad, int flags) {
 		}
 		fds[x].offset=0;
 		fds[x].size=fds[x].part->size;
+#if CONFIG_HW_WAD_MMAP_WHOLE
+		mapWholeWad(fds[x].part);
+#endif
+	} else if (strcmp(wad, "rpatch.bin")==0) {
+		//Pre-baked patches (r_patch.c), optional
+		fds[x].part=esp_partition_find_first(66, 7, NULL);
+		if (fds[x].part == NULL) return -1;
+		fds[x].offset=0;
+		fds[x].size=fds[x].part->size;
 	} else {
 		lprintf(LO_INFO, "I_Open: open %s failed\n", wad);
 		return -1;
@@ -215,104 +289,230 @@ void I_Close(int fd) {
 }
 
 
+/*
+ Flash mmap cache. Mappings are made in whole 64K MMU pages, so all lumps in a page share one mapping.
+ pageMap gives, for every flash page, the mapping covering it that reaches furthest, so whether any mapping
+ covers a lump is a single lookup. Mappings nobody uses stay mapped on an LRU list and are only unmapped
+ when the MMU or the handles run out.
+ The IDF may hand a new mapping MMU entries an older one already has. So a pointer can't tell which
+ mapping it came from; instead every mapped address page has one owner in vaddrMap, and a pointer holds
+ a reference on the owner of each page it spans. Ownership only changes once the owner is unused.
+*/
+#define MMU_PAGE SPI_FLASH_MMU_PAGE_SIZE
+#define NO_MMAP_HANDLES 64
+#define NO_FLASH_PAGES 256 //16MB, all an ESP32 can address
+#define NO_VADDR_PAGES ((SOC_DROM_HIGH-SOC_DROM_LOW)/MMU_PAGE)
+
 typedef struct {
 	spi_flash_mmap_handle_t handle;
-	void *addr;
-	int offset;
-	size_t len;
+	const uint8_t *addr;		//NULL if the handle is free
+	int offset;					//partition offset addr points at
+	int size;
+	int firstPage, lastPage;	//flash pages covered
 	int used;
+	int prev, next;				//LRU list of unused mappings, oldest first
 } MmapHandle;
 
-#define NO_MMAP_HANDLES 128
 static MmapHandle mmapHandle[NO_MMAP_HANDLES];
+static uint8_t pageMap[NO_FLASH_PAGES];		//handle+1, 0 if none
+static uint8_t vaddrMap[NO_VADDR_PAGES];	//handle+1, 0 if none
+static int lruHead=-1, lruTail=-1;
 
-static int nextHandle=0;
-static int getFreeHandle() {
-	int n=NO_MMAP_HANDLES;
-	while (mmapHandle[nextHandle].used!=0 && n!=0) {
-		nextHandle++;
-		if (nextHandle==NO_MMAP_HANDLES) nextHandle=0;
-		n--;
-	}
-	if (n==0) {
-		lprintf(LO_ERROR, "I_Mmap: More mmaps than NO_MMAP_HANDLES!");
-		exit(0);
+static int vaddrPage(const void *addr) {
+	return ((uintptr_t)addr-SOC_DROM_LOW)/MMU_PAGE;
+}
+
+static void lruRemove(int h) {
+	MmapHandle *m=&mmapHandle[h];
+	if (m->prev>=0) mmapHandle[m->prev].next=m->next; else lruHead=m->next;
+	if (m->next>=0) mmapHandle[m->next].prev=m->prev; else lruTail=m->prev;
+}
+
+static void lruAppend(int h) {
+	MmapHandle *m=&mmapHandle[h];
+	m->prev=lruTail;
+	m->next=-1;
+	if (lruTail>=0) mmapHandle[lruTail].next=h; else lruHead=h;
+	lruTail=h;
+}
+
+//Takes (ref=1) or drops (ref=-1) a reference on the owners of the pages addr..addr+len-1.
+static void refPages(const uint8_t *addr, size_t len, int ref) {
+	int p, h;
+	for (p=vaddrPage(addr); p<=vaddrPage(addr+(len?len-1:0)); p++) {
+		h=vaddrMap[p]-1;
+		if (h<0 || mmapHandle[h].used+ref<0) {
+			lprintf(LO_ERROR, "I_Mmap: Freeing non-mmapped address/len combo!");
+			exit(0);
+		}
+		if (ref>0 && mmapHandle[h].used++==0) lruRemove(h);
+		if (ref<0 && --mmapHandle[h].used==0) lruAppend(h);
 	}
-	
-	if (mmapHandle[nextHandle].addr) {
-		spi_flash_munmap(mmapHandle[nextHandle].handle);
-		mmapHandle[nextHandle].addr=NULL;
-//		printf("mmap: freeing handle %d\n", nextHandle);
+}
+
+//Gives the address pages of h to h if nobody owns them, or to whoever else maps them if h is going away.
+static void setVaddrMap(int h) {
+	MmapHandle *m=&mmapHandle[h];
+	int p, o;
+	for (p=vaddrPage(m->addr); p<=vaddrPage(m->addr+m->size-1); p++) {
+		if (m->addr && vaddrMap[p]==0) {
+			vaddrMap[p]=h+1;
+		} else if (!m->addr && vaddrMap[p]==h+1) {
+			vaddrMap[p]=0;
+			for (o=0; o<NO_MMAP_HANDLES; o++) {
+				MmapHandle *n=&mmapHandle[o];
+				if (n->addr && vaddrPage(n->addr)<=p && vaddrPage(n->addr+n->size-1)>=p) {
+					vaddrMap[p]=o+1;
+					break;
+				}
+			}
+		}
 	}
-	int r=nextHandle;
-	nextHandle++;
-	if (nextHandle==NO_MMAP_HANDLES) nextHandle=0;
-
-	return r;
-}
-
-static void freeUnusedMmaps() {
-	for (int i=0; i<NO_MMAP_HANDLES; i++) {
-		//Check if handle is not in use but is mapped.
-		if (mmapHandle[i].used==0 && mmapHandle[i].addr!=NULL) {
-			spi_flash_munmap(mmapHandle[i].handle);
-			mmapHandle[i].addr=NULL;
-			mmapHandle[i].offset=0;
-			mmapHandle[i].len=0;
-			printf("Freeing handle %d\n", i);
+}
+
+//Points pageMap at the furthest-reaching mapping for the flash pages firstPage..lastPage.
+static void setPageMap(int firstPage, int lastPage) {
+	int p, h;
+	for (p=firstPage; p<=lastPage; p++) {
+		pageMap[p]=0;
+		for (h=0; h<NO_MMAP_HANDLES; h++) {
+			MmapHandle *m=&mmapHandle[h];
+			if (m->addr && m->firstPage<=p && m->lastPage>=p &&
+					(!pageMap[p] || mmapHandle[pageMap[p]-1].lastPage<m->lastPage)) {
+				pageMap[p]=h+1;
+			}
 		}
 	}
 }
 
-void *I_Mmap(void *addr, size_t length, int prot, int flags, int ifd, off_t offset) {
-	int i;
-	esp_err_t err;
-	void *retaddr=NULL;
+//Unmaps the least recently used mapping nobody uses. Returns 0 if there is none.
+static int evictLru() {
+	int h=lruHead;
+	MmapHandle *m;
+	if (h<0) return 0;
+	m=&mmapHandle[h];
+	lruRemove(h);
+	spi_flash_munmap(m->handle);
+	m->addr=NULL;
+	setVaddrMap(h);
+	setPageMap(m->firstPage, m->lastPage);
+	mmapStats.evictions++;
+	mmapStats.mappings--;
+	mmapStats.pages-=m->lastPage-m->firstPage+1;
+	return 1;
+}
 
-	for (i=0; i<NO_MMAP_HANDLES; i++) {
-		if (mmapHandle[i].offset==offset && mmapHandle[i].len==length) {
-			mmapHandle[i].used++;
-			return mmapHandle[i].addr;
+static int getFreeHandle() {
+	int h;
+	while (1) {
+		for (h=0; h<NO_MMAP_HANDLES; h++) {
+			if (!mmapHandle[h].addr) return h;
+		}
+		if (!evictLru()) {
+			lprintf(LO_ERROR, "I_Mmap: More mmaps than NO_MMAP_HANDLES!");
+			exit(0);
 		}
 	}
+}
 
-	i=getFreeHandle();
+void *I_Mmap(void *addr, size_t length, int prot, int flags, int ifd, off_t offset) {
+	const esp_partition_t *part=fds[ifd].part;
+	int firstPage=(part->address+offset)/MMU_PAGE;
+	int lastPage=(part->address+offset+(length?length-1:0))/MMU_PAGE;
+	int h=pageMap[firstPage]-1;
+	const uint8_t *ret;
+	MmapHandle *m;
+	esp_err_t err;
 
-	//lprintf(LO_INFO, "I_Mmap: mmaping offset %d size %d handle %d\n", (int)offset, (int)length, i);
-	err=esp_partition_mmap(fds[ifd].part, offset, length, SPI_FLASH_MMAP_DATA, (const void**)&retaddr, &mmapHandle[i].handle);
-	if (err==ESP_ERR_NO_MEM) {
-		lprintf(LO_ERROR, "I_Mmap: No free address space. Cleaning up unused cached mmaps...\n");
-		freeUnusedMmaps();
-		err=esp_partition_mmap(fds[ifd].part, offset, length, SPI_FLASH_MMAP_DATA, (const void**)&retaddr, &mmapHandle[i].handle);
+	if (wadBase && part==wadPart && offset+length<=wadSize) {
+		mmapStats.hits++;
+		return (void*)(wadBase+offset);
 	}
-	mmapHandle[i].addr=retaddr;
-	mmapHandle[i].len=length;
-	mmapHandle[i].used=1;
-	mmapHandle[i].offset=offset;
 
-	if (err!=ESP_OK) {
-		lprintf(LO_ERROR, "I_Mmap: Can't mmap: %x (len=%d)!", err, length);
-		return NULL;
+	if (h>=0 && mmapHandle[h].lastPage>=lastPage) {
+		m=&mmapHandle[h];
+		mmapStats.hits++;
+	} else {
+		mmapStats.misses++;
+		h=getFreeHandle();
+		m=&mmapHandle[h];
+		//Whole pages, clipped to the partition.
+		m->offset=firstPage*MMU_PAGE-part->address;
+		if (m->offset<0) m->offset=0;
+		m->size=(lastPage+1)*MMU_PAGE-part->address;
+		if (m->size>part->size) m->size=part->size;
+		m->size-=m->offset;
+		do {
+			err=esp_partition_mmap(part, m->offset, m->size, SPI_FLASH_MMAP_DATA, (const void**)&m->addr, &m->handle);
+		} while (err==ESP_ERR_NO_MEM && evictLru());
+		if (err!=ESP_OK) {
+			lprintf(LO_ERROR, "I_Mmap: Can't mmap: %x (len=%d)!", err, length);
+			m->addr=NULL;
+			return NULL;
+		}
+		m->firstPage=firstPage;
+		m->lastPage=lastPage;
+		m->used=0;
+		lruAppend(h);
+		setVaddrMap(h);
+		setPageMap(firstPage, lastPage);
+		mmapStats.mappings++;
+		mmapStats.pages+=lastPage-firstPage+1;
 	}
 
-	return retaddr;
+	ret=m->addr+(offset-m->offset);
+	refPages(ret, length, 1);
+	return (void*)ret;
 }
 
 
 int I_Munmap(void *addr, size_t length) {
-	int i;
-	for (i=0; i<NO_MMAP_HANDLES; i++) {
-		if (mmapHandle[i].addr==addr && mmapHandle[i].len==length) break;
-	}
-	if (i==NO_MMAP_HANDLES) {
-		lprintf(LO_ERROR, "I_Mmap: Freeing non-mmapped address/len combo!");
-		exit(0);
-	}
-//	lprintf(LO_INFO, "I_Mmap: freeing handle %d\n", i);
-	mmapHandle[i].used--;
+	if (wadBase && (const uint8_t*)addr>=wadBase && (const uint8_t*)addr<wadBase+wadSize) return 0;
+	refPages(addr, length, -1);
 	return 0;
 }
 
+void I_GetMmapStats(mmapstats_t *stats)
+{
+	*stats=mmapStats;
+}
+
+//Level arenas are never given back, so the internal RAM ones just have to stay within budget.
+static size_t zoneFastUsed;
+
+void *I_ZoneArenaAlloc(size_t size, int fast)
+{
+	void *p;
+	if (fast) {
+		if (zoneFastUsed+size > CONFIG_HW_ZONE_FAST_KB*1024) return NULL;
+		p=heap_caps_malloc(size, MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+		if (p) zoneFastUsed+=size;
+		return p;
+	}
+	return heap_caps_malloc(size, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+}
+
+static void I_GetHeapCaps(heapstats_t *stats, uint32_t caps)
+{
+	multi_heap_info_t info;
+	heap_caps_get_info(&info, caps);
+	stats->size=info.total_free_bytes+info.total_allocated_bytes;
+	stats->free=info.total_free_bytes;
+	stats->minfree=info.minimum_free_bytes;
+	stats->largest=info.largest_free_block;
+}
+
+void I_GetHeapStats(heapstats_t *internal, heapstats_t *external)
+{
+	I_GetHeapCaps(internal, MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+	I_GetHeapCaps(external, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+}
+
+int I_IsFastMemory(const void *p)
+{
+	return esp_ptr_internal(p);
+}
+
 void I_Read(int ifd, void* vbuf, size_t sz)
 {
 	uint8_t *d=I_Mmap(NULL, sz, 0, 0, ifd, fds[ifd].offset);
@@ -339,6 +539,60 @@ void I_SetAffinityMask(void)
 {
 }
 
+//Split-frame rendering. The engine task draws slice 0 on core 0, a render task on core 1 draws the other
+//slices in turn. It shares that core with the display task, which mostly waits for SPI DMA.
+static SemaphoreHandle_t renderStart, renderDone, sharedMux;
+static void (*renderFunc)(int slice);
+static int renderCount;
+static volatile int sharedActive;
+
+static void renderTask(void *arg) {
+	int i;
+	while(1) {
+		xSemaphoreTake(renderStart, portMAX_DELAY);
+		for (i=1; i<renderCount; i++) renderFunc(i);
+		xSemaphoreGive(renderDone);
+	}
+}
+
+int I_RenderThreads(void)
+{
+#if CONFIG_FREERTOS_UNICORE
+	return 1;
+#else
+	return CONFIG_HW_RENDER_THREADS;
+#endif
+}
+
+void I_RunRenderThreads(int count, void (*func)(int slice))
+{
+	if (!renderStart) {
+		renderStart=xSemaphoreCreateBinary();
+		renderDone=xSemaphoreCreateBinary();
+		sharedMux=xSemaphoreCreateRecursiveMutex();
+		//Renderer thread state lives in TLS and malloced arrays, so the stack can stay small.
+		xTaskCreatePinnedToCore(&renderTask, "render", 8192, NULL, 5, NULL, 1);
+	}
+	renderFunc=func;
+	renderCount=count;
+	sharedActive=1;
+	xSemaphoreGive(renderStart);
+	func(0);
+	xSemaphoreTake(renderDone, portMAX_DELAY);
+	sharedActive=0;
+}
+
+//Zone heap and lump/patch caches, only contended while the render task runs.
+void I_LockShared(void)
+{
+	if (sharedActive) xSemaphoreTakeRecursive(sharedMux, portMAX_DELAY);
+}
+
+void I_UnlockShared(void)
+{
+	if (sharedActive) xSemaphoreGiveRecursive(sharedMux);
+}
+
 
 
 
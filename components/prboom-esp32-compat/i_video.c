@@ -34,13 +34,18 @@
 
 #include "config.h"
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <fcntl.h>
 #include "m_argv.h"
 #include "doomstat.h"
 #include "doomdef.h"
 #include "doomtype.h"
 #include "v_video.h"
 #include "r_draw.h"
+#include "r_main.h"
 #include "d_main.h"
 #include "d_event.h"
 #include "gamepad.h"
@@ -53,22 +58,60 @@
 #include "lprintf.h"
 
 #include "rom/ets_sys.h"
+#include "sdkconfig.h"
 #include "spi_lcd.h"
 
 #include "esp_heap_caps.h"
 
 int use_fullscreen=0;
 int use_doublebuffer=0;
+//screens[0] is swapped for another buffer from the display task on every I_FinishUpdate
+int use_pageflip=1;
 
 
+//The serial console only takes the census command: a line reading idmem is
+//fed to the game as that cheat, anything else is dropped
+#define CONSOLE_COMMAND "idmem"
+
+static void I_ConsolePoll(void)
+{
+	static char line[sizeof(CONSOLE_COMMAND)];
+	static int len;
+	event_t ev;
+	const char *p;
+	char c;
+
+	while (read(fileno(stdin), &c, 1)==1) {
+		if (c!='\r' && c!='\n') {
+			//a line too long to be the command can't become one
+			if (len<sizeof(line)) line[len]=tolower((unsigned char)c);
+			len++;
+			continue;
+		}
+		if (len==sizeof(line)-1 && !memcmp(line, CONSOLE_COMMAND, len)) {
+			for (p=CONSOLE_COMMAND; *p; p++) {
+				ev.type=ev_keydown;
+				ev.data1=*p;
+				ev.data2=ev.data3=0;
+				D_PostEvent(&ev);
+				ev.type=ev_keyup;
+				D_PostEvent(&ev);
+			}
+		}
+		len=0;
+	}
+}
+
 void I_StartTic (void)
 {
 	gamepadPoll();
+	I_ConsolePoll();
 }
 
 
 static void I_InitInputs(void)
 {
+	fcntl(fileno(stdin), F_SETFL, O_NONBLOCK);
 }
 
 
@@ -99,7 +142,6 @@ void I_StartFrame (void)
 
 int I_StartDisplay(void)
 {
-	spi_lcd_wait_finish();
   return true;
 }
 
@@ -109,24 +151,68 @@ void I_EndDisplay(void)
 
 
 
-static uint16_t *screena, *screenb;
-
 int16_t lcdpal[256] = {0};
 
+unsigned char *screenbuf;
+//The frame handed to the display task last. It stays untouched until the next I_FinishUpdate.
+static unsigned char *lastframe;
+
 //
 // I_FinishUpdate
 //
 
 void I_FinishUpdate (void)
 {
-	spi_lcd_send((uint16_t*)screens[0].data);
+	stdirty_t dirty[ST_MAXDIRTY];
+	spi_lcd_rect_t rects[ST_MAXDIRTY];
+	int i, n=ST_GetDirtyRects(dirty);
+	if (n<0) {
+		spi_lcd_send(screens[0].data, lcdpal);
+	} else {
+		//The status bar rows only changed where its widgets were redrawn.
+		for (i=0; i<n; i++) {
+			rects[i].x=dirty[i].x;
+			rects[i].y=dirty[i].y;
+			rects[i].w=dirty[i].w;
+			rects[i].h=dirty[i].h;
+		}
+		spi_lcd_send_split(screens[0].data, lcdpal, ST_SCALED_Y, rects, n);
+	}
+	lastframe=screens[0].data;
+	//The display task owns that frame now; render the next one into another buffer.
+	screenbuf=spi_lcd_get_fb();
+	screens[0].data=screenbuf;
+	if (scaledviewwidth) R_InitBuffer(scaledviewwidth, viewheight);
+}
+
+//
+// I_ReadScreen
+// Copies what is currently on the display, which is not what screens[0] holds.
+//
+void I_ReadScreen (screeninfo_t *dest)
+{
+	int y;
+	unsigned char *src=lastframe ? lastframe : screens[0].data;
+	for (y=0; y<SCREENHEIGHT; y++)
+		memcpy(dest->data+y*dest->byte_pitch, src+y*screens[0].byte_pitch, SCREENWIDTH*V_GetPixelDepth());
+}
+
+unsigned long I_GetScanoutUS(void)
+{
+	spi_lcd_stats_t stats;
+	spi_lcd_get_stats(&stats);
+	return stats.scanoutUs;
 }
 
 void I_SetPalette (int pal)
 {
 	int i, r, g, b, v;
-	int pplump = W_GetNumForName("PLAYPAL");
-	const byte * palette = W_CacheLumpNum(pplump);
+	int pplump;
+	const byte * palette;
+	//In RGB565 the engine's own 16 bit palette (V_Palette16) is applied while drawing.
+	if (V_GetMode()!=VID_MODE8) return;
+	pplump = W_GetNumForName("PLAYPAL");
+	palette = W_CacheLumpNum(pplump);
 	palette+=pal*(3*256);
 	for (i=0; i<256 ; i++) {
 		v=((palette[0]>>3)<<11)+((palette[1]>>2)<<5)+(palette[2]>>3);
@@ -138,8 +224,6 @@ void I_SetPalette (int pal)
 }
 
 
-unsigned char *screenbuf;
-
 #define INTERNAL_MEM_FB
 
 
@@ -147,7 +231,8 @@ void I_PreInitGraphics(void)
 {
 	lprintf(LO_INFO, "preinitgfx");
 #ifdef INTERNAL_MEM_FB
-	screenbuf=heap_caps_malloc(SCREENWIDTH*SCREENHEIGHT, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+	//The framebuffers belong to the display task; borrow the first one.
+	screenbuf=spi_lcd_get_fb();
 	assert(screenbuf);
 #endif
 }
@@ -158,7 +243,7 @@ void I_PreInitGraphics(void)
 // Sets the screen resolution
 void I_SetRes(void)
 {
-  int i;
+  int i, pitch = SCREENPITCH*V_GetPixelDepth();
 
 //  I_CalculateRes(SCREENWIDTH, SCREENHEIGHT);
 
@@ -166,24 +251,17 @@ void I_SetRes(void)
   for (i=0; i<3; i++) {
     screens[i].width = SCREENWIDTH;
     screens[i].height = SCREENHEIGHT;
-    screens[i].byte_pitch = SCREENPITCH;
-    screens[i].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
-    screens[i].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+    screens[i].byte_pitch = pitch;
+    screens[i].short_pitch = pitch / V_GetModePixelDepth(VID_MODE16);
+    screens[i].int_pitch = pitch / V_GetModePixelDepth(VID_MODE32);
   }
 
   // statusbar
   screens[4].width = SCREENWIDTH;
   screens[4].height = (ST_SCALED_HEIGHT+1);
-  screens[4].byte_pitch = SCREENPITCH;
-  screens[4].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
-  screens[4].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
-
-//Attempt at double-buffering. Does not work.
-//  free(screena);
-//  free(screenb);
-//  screena=malloc(SCREENPITCH*SCREENHEIGHT);
-//  screenb=malloc(SCREENPITCH*SCREENHEIGHT);
-
+  screens[4].byte_pitch = pitch;
+  screens[4].short_pitch = pitch / V_GetModePixelDepth(VID_MODE16);
+  screens[4].int_pitch = pitch / V_GetModePixelDepth(VID_MODE32);
 
 #ifdef INTERNAL_MEM_FB
   screens[0].not_on_heap=true;
@@ -227,8 +305,11 @@ void I_UpdateVideoMode(void)
 
   lprintf(LO_INFO, "I_UpdateVideoMode: %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
 
-//    mode = VID_MODE16;
+#if CONFIG_HW_LCD_RGB565
+    mode = VID_MODE16;
+#else
     mode = VID_MODE8;
+#endif
 
   V_InitMode(mode);
   V_DestroyUnusedTrueColorPalettes();
@@ -0,0 +1,75 @@
+#ifndef LCD_CONVERT_H
+#define LCD_CONVERT_H
+
+#include <stdint.h>
+
+/*
+ Palette index to RGB565 conversion for the LCD. Sources are 32-bit words of four palette indices, the
+ leftmost pixel in the low byte; destinations are pairs of RGB565 pixels in 32-bit words, the leftmost pixel in
+ the low halfword, which on the little-endian ESP32 is the memory order the SPI DMA sends out. Everything is
+ static inline so that it ends up in the IRAM display task, and so that the native build and lcdbench can use
+ the very same code.
+*/
+
+//Entries in a pair table: every combination of two palette indices
+#define LCD_PAIRS 65536
+
+//The plain version, one halfword store per pixel. What the others must match.
+static inline void lcd_convert_ref(uint16_t *dst, const uint32_t *src, int words, const int16_t *pal) {
+	while (words--) {
+		uint32_t d=*src++;
+		*dst++=pal[(d>>0)&0xff];
+		*dst++=pal[(d>>8)&0xff];
+		*dst++=pal[(d>>16)&0xff];
+		*dst++=pal[(d>>24)&0xff];
+	}
+}
+
+//Four lookups per source word, packed into two word stores; two source words per round.
+static inline void lcd_convert_words(uint32_t *dst, const uint32_t *src, int words, const int16_t *pal) {
+	const uint16_t *p=(const uint16_t *)pal;
+	for (; words>=2; words-=2) {
+		uint32_t d0=src[0], d1=src[1];
+		src+=2;
+		dst[0]=p[d0&0xff]|((uint32_t)p[(d0>>8)&0xff]<<16);
+		dst[1]=p[(d0>>16)&0xff]|((uint32_t)p[d0>>24]<<16);
+		dst[2]=p[d1&0xff]|((uint32_t)p[(d1>>8)&0xff]<<16);
+		dst[3]=p[(d1>>16)&0xff]|((uint32_t)p[d1>>24]<<16);
+		dst+=4;
+	}
+	if (words) {
+		uint32_t d0=*src;
+		dst[0]=p[d0&0xff]|((uint32_t)p[(d0>>8)&0xff]<<16);
+		dst[1]=p[(d0>>16)&0xff]|((uint32_t)p[d0>>24]<<16);
+	}
+}
+
+//Fills a pair table for pal: entry i holds the pixels of index i&0xff and i>>8, as lcd_convert_words packs them.
+static inline void lcd_build_pairs(uint32_t *pairs, const int16_t *pal) {
+	const uint16_t *p=(const uint16_t *)pal;
+	int hi, lo;
+	for (hi=0; hi<256; hi++) {
+		uint32_t h=(uint32_t)p[hi]<<16;
+		for (lo=0; lo<256; lo++) *pairs++=p[lo]|h;
+	}
+}
+
+//Two lookups per source word in a table from lcd_build_pairs.
+static inline void lcd_convert_pairs(uint32_t *dst, const uint32_t *src, int words, const uint32_t *pairs) {
+	for (; words>=2; words-=2) {
+		uint32_t d0=src[0], d1=src[1];
+		src+=2;
+		dst[0]=pairs[d0&0xffff];
+		dst[1]=pairs[d0>>16];
+		dst[2]=pairs[d1&0xffff];
+		dst[3]=pairs[d1>>16];
+		dst+=4;
+	}
+	if (words) {
+		uint32_t d0=*src;
+		dst[0]=pairs[d0&0xffff];
+		dst[1]=pairs[d0>>16];
+	}
+}
+
+#endif
@@ -1,3 +1,37 @@
-void spi_lcd_wait_finish();
-void spi_lcd_send(uint16_t *scr);
+#include <stdint.h>
+
+//Display task counters. frames/fullFrames/totalBytes are running totals, the others describe the last frame
+//sent to the LCD.
+typedef struct {
+	uint32_t frames;
+	uint32_t fullFrames;
+	uint32_t regions;
+	uint32_t dirtyBytes;
+	uint32_t statusBytes;	//of dirtyBytes, the ones sent for rects below the view
+	uint32_t scanoutUs;		//from taking the frame to the last SPI transfer finishing
+	uint32_t convertCycles;	//CPU cycles spent converting pixels into the DMA buffers
+	uint32_t chunkCycles;	//the most of those spent on one MEM_PER_TRANS chunk
+	uint64_t totalBytes;
+} spi_lcd_stats_t;
+
+//Returns a framebuffer the engine can render the next frame into, waiting for the display task to release
+//one if needed.
+uint8_t *spi_lcd_get_fb();
+//Hands a framebuffer obtained from spi_lcd_get_fb to the display task, together with the palette it is drawn
+//in. The palette is copied, fb belongs to the display task until spi_lcd_get_fb returns it again. With
+//CONFIG_HW_LCD_RGB565 the framebuffer holds LCD-ready pixels and pal is ignored.
+void spi_lcd_send(uint8_t *fb, const int16_t *pal);
+
+//A rectangle of a frame, in pixels.
+typedef struct {
+	int16_t x, y, w, h;
+} spi_lcd_rect_t;
+
+#define SPI_LCD_MAX_RECTS 8
+
+//Like spi_lcd_send, for a frame in which only the rows above viewh are new: of the rest, only the n rects
+//changed since the frame before. The display takes the others as they are. Up to SPI_LCD_MAX_RECTS rects are
+//kept apart, more are merged into one.
+void spi_lcd_send_split(uint8_t *fb, const int16_t *pal, int viewh, const spi_lcd_rect_t *rects, int n);
 void spi_lcd_init();
+void spi_lcd_get_stats(spi_lcd_stats_t *stats);
@@ -18,13 +18,20 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_system.h"
 #include "driver/spi_master.h"
 #include "soc/gpio_struct.h"
 #include "driver/gpio.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "soc/soc_memory_layout.h"
+#include "xtensa/hal.h"
 
 #include "sdkconfig.h"
+#include "spi_lcd.h"
+#include "lcd_convert.h"
 
 // LCD physical dimensions and addressing offset, derived from controller type
 #if (CONFIG_HW_LCD_TYPE == 2)   /* ST7735 128x128 */
@@ -62,8 +69,22 @@
 #define PIN_NUM_BCKL CONFIG_HW_LCD_BL_GPIO
 #endif
 
-//You want this, especially at higher framerates. The 2nd buffer is allocated in iram anyway, so isn't really in the way.
-#define DOUBLE_BUFFER
+//Amount of framebuffers rotating between the engine and the display task. The engine renders into one while
+//the display task sends out another; a third one lets the engine start on the frame after that as well.
+#define NO_FB CONFIG_HW_LCD_FRAMEBUFFERS
+
+//Bytes per pixel in the framebuffers: palette indices, or RGB565 in LCD byte order that needs no conversion.
+#if CONFIG_HW_LCD_RGB565
+#define LCD_BPP 2
+#else
+#define LCD_BPP 1
+#endif
+//Pixels per 32-bit framebuffer word
+#define LCD_PPW (4/LCD_BPP)
+#define LCD_WORDS_PER_LINE (LCD_WIDTH*LCD_BPP/4)
+
+//Define this to print the damage tracking statistics every 256 frames.
+//#define LCD_STATS_LOG
 
 
 /*
@@ -297,14 +318,24 @@ void send_header_cleanup(spi_device_handle_t spi)
 }
 
 
-#ifndef DOUBLE_BUFFER
-volatile static uint16_t *currFbPtr=NULL;
-#else
-//Warning: This gets squeezed into IRAM.
-static uint32_t *currFbPtr=NULL;
-#endif
-xSemaphoreHandle dispSem = NULL;
-xSemaphoreHandle dispDoneSem = NULL;
+/*
+ A frame is a framebuffer plus the palette it was drawn with (unused with LCD_BPP 2). Frames are passed around by pointer:
+ freeQueue holds the ones the engine can render into, sendQueue the ones waiting for the display task. The
+ display task hands a frame back as soon as it has taken everything it needs out of it.
+ Rows from viewh down only changed in rects (x and w multiples of LCD_PPW); viewh is LCD_HEIGHT for a frame
+ that is new all over.
+*/
+typedef struct {
+	uint32_t *fb;
+	int16_t pal[256];
+	int viewh;
+	int nrects;
+	spi_lcd_rect_t rects[SPI_LCD_MAX_RECTS];
+} lcd_frame_t;
+
+static lcd_frame_t frames[NO_FB];
+static QueueHandle_t freeQueue = NULL;
+static QueueHandle_t sendQueue = NULL;
 
 #define NO_SIM_TRANS 5 //Amount of SPI transfers to queue in parallel
 #if (CONFIG_HW_LCD_TYPE == 2)
@@ -313,15 +344,204 @@ xSemaphoreHandle dispDoneSem = NULL;
 #define MEM_PER_TRANS (1024*3) //in 16-bit words
 #endif
 
-extern int16_t lcdpal[256];
+static uint16_t *dmamem[NO_SIM_TRANS];
+static spi_transaction_t trans[NO_SIM_TRANS];
+static int idx=0;
+static int inProgress=0;
+
+static spi_lcd_stats_t lcdStats;
+
+#if CONFIG_HW_LCD_PAIR_TABLE
+//Two pixels per lookup: a 256K table, rebuilt whenever the palette changes. Taken from internal RAM only if
+//that leaves PAIR_TABLE_SPARE for everything else, from PSRAM otherwise.
+#define PAIR_TABLE_SPARE (64*1024)
+static uint32_t *pairTable=NULL;
+static int16_t pairPal[256];
+static int pairValid=0;
+
+static void update_pairs(const int16_t *pal) {
+	if (!pairTable || (pairValid && memcmp(pairPal, pal, sizeof(pairPal))==0)) return;
+	memcpy(pairPal, pal, sizeof(pairPal));
+	lcd_build_pairs(pairTable, pal);
+	pairValid=1;
+}
+#endif
+
+#if CONFIG_HW_LCD_PARTIAL_UPDATE
+/*
+ Damage tracking. The display task keeps a shadow copy of what it last sent to the LCD, in the same
+ format the engine renders in. Every frame is compared to the shadow in bands of DIRTY_BAND_ROWS lines at
+ 32-bit word (LCD_PPW pixel) granularity; consecutive dirty bands are merged into one region and every region
+ gets its own CASET/RASET window. The shadow is updated while comparing, and pixels are converted from the
+ shadow, so what the LCD shows always matches it even if the engine writes the next frame meanwhile.
+*/
+#define DIRTY_BAND_ROWS 8
+#define NO_BANDS ((LCD_HEIGHT+DIRTY_BAND_ROWS-1)/DIRTY_BAND_ROWS)
+#define MAX_REGIONS NO_BANDS
+
+typedef struct {
+	int x, y, w, h;
+} lcd_region_t;
+
+static uint32_t *shadowFb=NULL;
+static int16_t shadowPal[256];
+static int shadowValid=0;
+static lcd_region_t regions[MAX_REGIONS];
+
+//Compares one band against the shadow and copies over changed words. Returns the dirty word range in
+//*wmin/*wmax, or 0 if the band is clean.
+static int IRAM_ATTR diff_band(const uint32_t *fb, int y, int h, int *wmin, int *wmax) {
+	int x, yy;
+	int mi=LCD_WORDS_PER_LINE, ma=-1;
+	for (yy=y; yy<y+h; yy++) {
+		const uint32_t *src=&fb[yy*LCD_WORDS_PER_LINE];
+		uint32_t *dst=&shadowFb[yy*LCD_WORDS_PER_LINE];
+		for (x=0; x<LCD_WORDS_PER_LINE; x++) {
+			if (src[x]!=dst[x]) {
+				dst[x]=src[x];
+				if (x<mi) mi=x;
+				if (x>ma) ma=x;
+			}
+		}
+	}
+	*wmin=mi;
+	*wmax=ma;
+	return (ma>=0);
+}
+
+//Builds the list of dirty regions in the first rows lines of this frame. Returns the number of regions.
+static int find_dirty_regions(const uint32_t *fb, int rows) {
+	int b, n=0;
+	int open=0;
+	int wmin, wmax;
+	for (b=0; b*DIRTY_BAND_ROWS<rows; b++) {
+		int y=b*DIRTY_BAND_ROWS;
+		int h=DIRTY_BAND_ROWS;
+		if (y+h>rows) h=rows-y;
+		if (diff_band(fb, y, h, &wmin, &wmax)) {
+			if (open) {
+				//Grow the current region down and sideways to cover this band as well.
+				int x1=regions[n-1].x, x2=regions[n-1].x+regions[n-1].w;
+				if (wmin*LCD_PPW<x1) x1=wmin*LCD_PPW;
+				if ((wmax+1)*LCD_PPW>x2) x2=(wmax+1)*LCD_PPW;
+				regions[n-1].x=x1;
+				regions[n-1].w=x2-x1;
+				regions[n-1].h+=h;
+			} else {
+				regions[n].x=wmin*LCD_PPW;
+				regions[n].y=y;
+				regions[n].w=(wmax-wmin+1)*LCD_PPW;
+				regions[n].h=h;
+				n++;
+				open=1;
+			}
+		} else {
+			open=0;
+		}
+	}
+	return n;
+}
+
+//Takes a rect the engine says has changed into the shadow as it is.
+static void IRAM_ATTR copy_rect(const uint32_t *fb, const spi_lcd_rect_t *r) {
+	int yy;
+	for (yy=r->y; yy<r->y+r->h; yy++) {
+		int o=(yy*LCD_WIDTH+r->x)/LCD_PPW;
+		memcpy(&shadowFb[o], &fb[o], r->w*LCD_BPP);
+	}
+}
+#else
+//The palette of the last frame sent, without a shadow to keep it in.
+static int16_t sentPal[256];
+static int sentValid=0;
+#endif
+
+//Waits until every queued pixel transfer is done.
+static void drain_trans() {
+	spi_transaction_t *rtrans;
+	esp_err_t ret;
+	while(inProgress) {
+		ret=spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
+		assert(ret==ESP_OK);
+		inProgress--;
+	}
+}
+
+//Queues the pixels in dmamem[idx] and moves on to the next buffer, waiting for the oldest transfer
+//if all of them are in flight.
+static void queue_chunk(int words) {
+	spi_transaction_t *rtrans;
+	esp_err_t ret;
+	trans[idx].length=words*16;
+	trans[idx].user=(void*)1;
+	trans[idx].tx_buffer=dmamem[idx];
+	ret=spi_device_queue_trans(spi, &trans[idx], portMAX_DELAY);
+	assert(ret==ESP_OK);
+
+	idx++;
+	if (idx>=NO_SIM_TRANS) idx=0;
+
+	if (inProgress==NO_SIM_TRANS-1) {
+		ret=spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
+		assert(ret==ESP_OK);
+	} else {
+		inProgress++;
+	}
+}
+
+//Sends the w*h rectangle at x,y of an LCD_WIDTH-pitched framebuffer. x and w need to be multiples of
+//LCD_PPW.
+static void IRAM_ATTR send_rect(const uint32_t *fb, const int16_t *pal, int x, int y, int w, int h) {
+	int i=0;
+	int yy;
+	uint32_t cycles=0, t;
+	//The header transactions are collected in order, so the bus needs to be idle before we can queue them.
+	drain_trans();
+	send_header_start(spi, LCD_XOFFSET+x, LCD_YOFFSET+y, w, h);
+	send_header_cleanup(spi);
+	for (yy=y; yy<y+h; yy++) {
+		const uint32_t *src=&fb[(yy*LCD_WIDTH+x)/LCD_PPW];
+		int words=w/LCD_PPW;
+		while (words) {
+			//As much of the line as still fits in this chunk
+			int n=(MEM_PER_TRANS-i)/LCD_PPW;
+			if (n>words) n=words;
+			t=xthal_get_ccount();
+#if LCD_BPP==2
+			//Already in LCD format; just get it into DMA-capable memory.
+			memcpy(&dmamem[idx][i], src, n*4);
+#elif CONFIG_HW_LCD_PAIR_TABLE
+			if (pairTable) {
+				lcd_convert_pairs((uint32_t*)&dmamem[idx][i], src, n, pairTable);
+			} else {
+				lcd_convert_words((uint32_t*)&dmamem[idx][i], src, n, pal);
+			}
+#else
+			lcd_convert_words((uint32_t*)&dmamem[idx][i], src, n, pal);
+#endif
+			cycles+=xthal_get_ccount()-t;
+			src+=n;
+			words-=n;
+			i+=n*LCD_PPW;
+			if (i==MEM_PER_TRANS) {
+				queue_chunk(i);
+				i=0;
+				lcdStats.convertCycles+=cycles;
+				if (cycles>lcdStats.chunkCycles) lcdStats.chunkCycles=cycles;
+				cycles=0;
+			}
+		}
+	}
+	if (i) queue_chunk(i);
+	lcdStats.convertCycles+=cycles;
+	if (cycles>lcdStats.chunkCycles) lcdStats.chunkCycles=cycles;
+	lcdStats.regions++;
+	lcdStats.dirtyBytes+=w*h*2;
+}
 
 void IRAM_ATTR displayTask(void *arg) {
 	int x, i;
-	int idx=0;
-	int inProgress=0;
-	static uint16_t *dmamem[NO_SIM_TRANS];
-	spi_transaction_t trans[NO_SIM_TRANS];
-	spi_transaction_t *rtrans;
+	lcd_frame_t *frame;
 
     esp_err_t ret;
     spi_bus_config_t buscfg={
@@ -360,86 +580,165 @@ void IRAM_ATTR displayTask(void *arg) {
 		trans[x].user=(void*)1;
 		trans[x].tx_buffer=&dmamem[x];
 	}
-	xSemaphoreGive(dispDoneSem);
+
+#if CONFIG_HW_LCD_PAIR_TABLE
+	if (heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL)>=LCD_PAIRS*4+PAIR_TABLE_SPARE) {
+		pairTable=heap_caps_malloc(LCD_PAIRS*4, MALLOC_CAP_INTERNAL|MALLOC_CAP_32BIT);
+	}
+	if (!pairTable) pairTable=heap_caps_malloc(LCD_PAIRS*4, MALLOC_CAP_SPIRAM|MALLOC_CAP_32BIT);
+	printf("*** Display task: pair table %s.\n", !pairTable?"not allocated":
+			(esp_ptr_internal(pairTable)?"in internal RAM":"in PSRAM"));
+#endif
 
 	while(1) {
-		xSemaphoreTake(dispSem, portMAX_DELAY);
+		xQueueReceive(sendQueue, &frame, portMAX_DELAY);
 //		printf("Display task: frame.\n");
-#ifndef DOUBLE_BUFFER
-		uint8_t *myData=(uint8_t*)currFbPtr;
+		int64_t start=esp_timer_get_time();
+		lcdStats.frames++;
+		lcdStats.regions=0;
+		lcdStats.dirtyBytes=0;
+		lcdStats.statusBytes=0;
+		lcdStats.convertCycles=0;
+		lcdStats.chunkCycles=0;
+#if CONFIG_HW_LCD_PAIR_TABLE
+		update_pairs(frame->pal);
 #endif
-
-		send_header_start(spi, LCD_XOFFSET, LCD_YOFFSET, LCD_WIDTH, LCD_HEIGHT);
-		send_header_cleanup(spi);
-		for (x=0; x<LCD_WIDTH*LCD_HEIGHT; x+=MEM_PER_TRANS) {
-#ifdef DOUBLE_BUFFER
-			for (i=0; i<MEM_PER_TRANS; i+=4) {
-				uint32_t d=currFbPtr[(x+i)/4];
-				dmamem[idx][i+0]=lcdpal[(d>>0)&0xff];
-				dmamem[idx][i+1]=lcdpal[(d>>8)&0xff];
-				dmamem[idx][i+2]=lcdpal[(d>>16)&0xff];
-				dmamem[idx][i+3]=lcdpal[(d>>24)&0xff];
+#if CONFIG_HW_LCD_PARTIAL_UPDATE
+		const uint32_t *fb=frame->fb;
+		//In RGB565 a palette change already shows up as changed pixels.
+		if (!shadowValid || (LCD_BPP==1 && memcmp(shadowPal, frame->pal, sizeof(shadowPal))!=0)) {
+			//First frame or palette change: every pixel on the panel changes colour.
+			memcpy(shadowPal, frame->pal, sizeof(shadowPal));
+			memcpy(shadowFb, fb, LCD_WIDTH*LCD_HEIGHT*LCD_BPP);
+			shadowValid=1;
+			//Everything we still need is in the shadow buffer now.
+			xQueueSend(freeQueue, &frame, portMAX_DELAY);
+			send_rect(shadowFb, shadowPal, 0, 0, LCD_WIDTH, LCD_HEIGHT);
+			lcdStats.fullFrames++;
+		} else {
+			//Only the rows above viewh get compared, below that the engine has told us what changed.
+			int n=find_dirty_regions(fb, frame->viewh);
+			int nrects=frame->nrects;
+			spi_lcd_rect_t rects[SPI_LCD_MAX_RECTS];
+			memcpy(rects, frame->rects, nrects*sizeof(rects[0]));
+			for (i=0; i<nrects; i++) copy_rect(fb, &rects[i]);
+			xQueueSend(freeQueue, &frame, portMAX_DELAY);
+			for (i=0; i<n; i++) {
+				send_rect(shadowFb, shadowPal, regions[i].x, regions[i].y, regions[i].w, regions[i].h);
 			}
-#else
-			for (i=0; i<MEM_PER_TRANS; i++) {
-				dmamem[idx][i]=lcdpal[myData[i]];
+			for (i=0; i<nrects; i++) {
+				send_rect(shadowFb, shadowPal, rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+				lcdStats.statusBytes+=rects[i].w*rects[i].h*2;
 			}
-			myData+=MEM_PER_TRANS;
-#endif
-			trans[idx].length=MEM_PER_TRANS*16;
-			trans[idx].user=(void*)1;
-			trans[idx].tx_buffer=dmamem[idx];
-			ret=spi_device_queue_trans(spi, &trans[idx], portMAX_DELAY);
-			assert(ret==ESP_OK);
-
-			idx++;
-			if (idx>=NO_SIM_TRANS) idx=0;
-
-			if (inProgress==NO_SIM_TRANS-1) {
-				ret=spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
-				assert(ret==ESP_OK);
-			} else {
-				inProgress++;
+		}
+#else
+		if (!sentValid || frame->viewh>=LCD_HEIGHT || (LCD_BPP==1 && memcmp(sentPal, frame->pal, sizeof(sentPal))!=0)) {
+			memcpy(sentPal, frame->pal, sizeof(sentPal));
+			sentValid=1;
+			send_rect(frame->fb, frame->pal, 0, 0, LCD_WIDTH, LCD_HEIGHT);
+			lcdStats.fullFrames++;
+		} else {
+			//The panel still shows the rows below viewh, apart from the rects.
+			send_rect(frame->fb, frame->pal, 0, 0, LCD_WIDTH, frame->viewh);
+			for (i=0; i<frame->nrects; i++) {
+				spi_lcd_rect_t *r=&frame->rects[i];
+				send_rect(frame->fb, frame->pal, r->x, r->y, r->w, r->h);
+				lcdStats.statusBytes+=r->w*r->h*2;
 			}
 		}
-#ifndef DOUBLE_BUFFER
-		xSemaphoreGive(dispDoneSem);
+		//The last chunks are queued from dmamem; the framebuffer itself is not needed anymore.
+		xQueueSend(freeQueue, &frame, portMAX_DELAY);
 #endif
-		while(inProgress) {
-			ret=spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
-			assert(ret==ESP_OK);
-			inProgress--;
+		lcdStats.totalBytes+=lcdStats.dirtyBytes;
+		drain_trans();
+		lcdStats.scanoutUs=esp_timer_get_time()-start;
+#ifdef LCD_STATS_LOG
+		if ((lcdStats.frames&255)==0) {
+			printf("LCD: %u frames, %u full, avg %u bytes/frame (full frame is %u)\n", lcdStats.frames,
+					lcdStats.fullFrames, (unsigned)(lcdStats.totalBytes/lcdStats.frames), LCD_WIDTH*LCD_HEIGHT*2);
+			//A chunk's DMA takes MEM_PER_TRANS*16 SPI clocks; converting the next one has to fit in there.
+			printf("LCD: converting took %u cycles, worst chunk %u of %u\n", lcdStats.convertCycles,
+					lcdStats.chunkCycles, MEM_PER_TRANS*16*CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ/26);
 		}
+#endif
 	}
 }
 
+void spi_lcd_get_stats(spi_lcd_stats_t *stats) {
+	*stats=lcdStats;
+}
+
 #include    <xtensa/config/core.h>
 #include    <xtensa/corebits.h>
 #include    <xtensa/config/system.h>
 //#include    <xtensa/simcall.h>
 
-void spi_lcd_wait_finish() {
-#ifndef DOUBLE_BUFFER
-	xSemaphoreTake(dispDoneSem, portMAX_DELAY);
-#endif
+uint8_t *spi_lcd_get_fb() {
+	lcd_frame_t *frame;
+	xQueueReceive(freeQueue, &frame, portMAX_DELAY);
+	return (uint8_t*)frame->fb;
 }
 
-void spi_lcd_send(uint16_t *scr) {
-#ifdef DOUBLE_BUFFER
-	memcpy(currFbPtr, scr, LCD_WIDTH*LCD_HEIGHT);
-	//Theoretically, also should double-buffer the lcdpal array... ahwell.
-#else
-	currFbPtr=scr;
-#endif
-	xSemaphoreGive(dispSem);
+void spi_lcd_send_split(uint8_t *fb, const int16_t *pal, int viewh, const spi_lcd_rect_t *rects, int n) {
+	lcd_frame_t *frame=NULL;
+	int i;
+	for (i=0; i<NO_FB; i++) {
+		if ((uint8_t*)frames[i].fb==fb) frame=&frames[i];
+	}
+	assert(frame);
+	if (pal) memcpy(frame->pal, pal, sizeof(frame->pal));
+	if (viewh<0) viewh=0;
+	if (viewh>LCD_HEIGHT) viewh=LCD_HEIGHT;
+	frame->viewh=viewh;
+	frame->nrects=0;
+	for (i=0; i<n; i++) {
+		//Clip to below the view and widen to whole framebuffer words.
+		int x1=rects[i].x&~(LCD_PPW-1), x2=(rects[i].x+rects[i].w+LCD_PPW-1)&~(LCD_PPW-1);
+		int y1=rects[i].y, y2=rects[i].y+rects[i].h;
+		spi_lcd_rect_t *r;
+		if (x1<0) x1=0;
+		if (x2>LCD_WIDTH) x2=LCD_WIDTH;
+		if (y1<viewh) y1=viewh;
+		if (y2>LCD_HEIGHT) y2=LCD_HEIGHT;
+		if (x1>=x2 || y1>=y2) continue;
+		if (frame->nrects==SPI_LCD_MAX_RECTS) {
+			//Out of room: grow the last one over this one too.
+			r=&frame->rects[SPI_LCD_MAX_RECTS-1];
+			if (r->x<x1) x1=r->x;
+			if (r->y<y1) y1=r->y;
+			if (r->x+r->w>x2) x2=r->x+r->w;
+			if (r->y+r->h>y2) y2=r->y+r->h;
+		} else {
+			r=&frame->rects[frame->nrects++];
+		}
+		r->x=x1;
+		r->y=y1;
+		r->w=x2-x1;
+		r->h=y2-y1;
+	}
+	xQueueSend(sendQueue, &frame, portMAX_DELAY);
+}
+
+void spi_lcd_send(uint8_t *fb, const int16_t *pal) {
+	spi_lcd_send_split(fb, pal, LCD_HEIGHT, NULL, 0);
 }
 
 void spi_lcd_init() {
 	printf("spi_lcd_init()\n");
-    dispSem=xSemaphoreCreateBinary();
-    dispDoneSem=xSemaphoreCreateBinary();
-#ifdef DOUBLE_BUFFER
-	currFbPtr=heap_caps_malloc(LCD_WIDTH*LCD_HEIGHT, MALLOC_CAP_32BIT);
+	freeQueue=xQueueCreate(NO_FB, sizeof(lcd_frame_t*));
+	sendQueue=xQueueCreate(NO_FB, sizeof(lcd_frame_t*));
+	for (int i=0; i<NO_FB; i++) {
+		lcd_frame_t *frame=&frames[i];
+		//57,600 bytes each (115,200 in RGB565); these don't fit in internal RAM.
+		frame->fb=heap_caps_malloc(LCD_WIDTH*LCD_HEIGHT*LCD_BPP, MALLOC_CAP_SPIRAM|MALLOC_CAP_32BIT);
+		assert(frame->fb);
+		memset(frame->fb, 0, LCD_WIDTH*LCD_HEIGHT*LCD_BPP);
+		xQueueSend(freeQueue, &frame, portMAX_DELAY);
+	}
+#if CONFIG_HW_LCD_PARTIAL_UPDATE
+	//Only the display task touches this; keep it out of the scarce internal RAM.
+	shadowFb=heap_caps_malloc(LCD_WIDTH*LCD_HEIGHT*LCD_BPP, MALLOC_CAP_SPIRAM|MALLOC_CAP_32BIT);
+	assert(shadowFb);
 #endif
 #if CONFIG_FREERTOS_UNICORE
 	xTaskCreatePinnedToCore(&displayTask, "display", 6000, NULL, 6, NULL, 0);
@@ -11,4 +11,4 @@ include $(IDF_PATH)/make/component_common.mk
 
 
 CFLAGS += -Wno-error=char-subscripts -Wno-error=unused-value -Wno-error=parentheses -Wno-error=int-to-pointer-cast -Wno-pointer-sign \
-		-Wno-error=unused-but-set-parameter -Wno-error=maybe-uninitialized
\ No newline at end of file
+		-Wno-error=unused-but-set-parameter -Wno-error=maybe-uninitialized
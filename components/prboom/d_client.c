@@ -67,6 +67,8 @@
 #include "i_main.h"
 #include "i_video.h"
 #include "m_argv.h"
+#include "m_bench.h"
+#include "d_pace.h"
 #include "r_fps.h"
 #include "lprintf.h"
 
@@ -471,14 +473,15 @@ void TryRunTics (void)
 #endif
     runtics = (server ? remotetic : maketic) - gametic;
     if (!runtics) {
-      if (!movement_smooth) {
+      boolean drawnow;
 #ifdef HAVE_NET
-        if (server)
+      if (server) {
+        if (!movement_smooth)
           I_WaitForPacket(ms_to_next_tick);
-        else
+        drawnow = movement_smooth;
+      } else
 #endif
-          I_uSleep(ms_to_next_tick*1000);
-      }
+        drawnow = D_PaceWait(); // sleeps till the next tic or frame
       if (I_GetTime() - entertime > 10) {
 #ifdef HAVE_NET
         if (server) {
@@ -492,6 +495,7 @@ void TryRunTics (void)
         M_Ticker(); return;
       }
       //if ((displaytime) < (tic_vars.next-SDL_GetTicks()))
+      if (drawnow)
       {
         WasRenderedInTryRunTics = true;
         if (V_GetMode() == VID_MODEGL ? 
@@ -514,7 +518,9 @@ void TryRunTics (void)
       D_DoAdvanceDemo ();
     M_Ticker ();
     I_GetTime_SaveMS();
+    M_BenchBegin(BENCH_TICKER);
     G_Ticker ();
+    M_BenchEnd(BENCH_TICKER);
     P_Checksum(gametic);
     gametic++;
 #ifdef HAVE_NET
@@ -1575,7 +1575,7 @@ static void deh_procBexCodePointers(DEHFILE *fpin, FILE* fpout, char *line)
           ++i;
           if (!stricmp(key,deh_bexptrs[i].lookup))
             {  // Ty 06/01/98  - add  to states[].action for new djgcc version
-              states[indexnum].action = deh_bexptrs[i].cptr; // assign
+              infoEditState(indexnum)->action = deh_bexptrs[i].cptr; // assign
               if (fpout) fprintf(fpout,
                                  " - applied %s from codeptr[%d] to states[%d]\n",
                                  deh_bexptrs[i].lookup,i,indexnum);
@@ -1649,7 +1649,7 @@ static uint_64_t getConvertedDEHBits(uint_64_t bits) {
 static void setMobjInfoValue(int mobjInfoIndex, int keyIndex, uint_64_t value) {
   mobjinfo_t *mi;
   if (mobjInfoIndex >= NUMMOBJTYPES || mobjInfoIndex < 0) return;
-  mi = &mobjinfo[mobjInfoIndex];
+  mi = infoEditMobjinfo(mobjInfoIndex);
   switch (keyIndex) {
     case 0: mi->doomednum = (int)value; return;
     case 1: mi->spawnstate = (int)value; return;
@@ -1760,7 +1760,7 @@ static void deh_procThing(DEHFILE *fpin, FILE* fpout, char *line)
           // No more desync on HACX demos.
           if (bGetData==1) { // proff
             value = getConvertedDEHBits(value);
-            mobjinfo[indexnum].flags = value;
+            infoEditMobjinfo(indexnum)->flags = value;
           }
           else {
             // figure out what the bits are
@@ -1797,7 +1797,7 @@ static void deh_procThing(DEHFILE *fpin, FILE* fpout, char *line)
                 (unsigned long)value & 0xffffffff
               );
             }
-            mobjinfo[indexnum].flags = value; // e6y
+            infoEditMobjinfo(indexnum)->flags = value; // e6y
           }
         }
         if (fpout) {
@@ -1848,25 +1848,25 @@ static void deh_procFrame(DEHFILE *fpin, FILE* fpout, char *line)
       if (!strcasecmp(key,deh_state[0]))  // Sprite number
         {
           if (fpout) fprintf(fpout," - sprite = %lld\n",value);
-          states[indexnum].sprite = (spritenum_t)value;
+          infoEditState(indexnum)->sprite = (spritenum_t)value;
         }
       else
         if (!strcasecmp(key,deh_state[1]))  // Sprite subnumber
           {
             if (fpout) fprintf(fpout," - frame = %lld\n",value);
-            states[indexnum].frame = (long)value; // long
+            infoEditState(indexnum)->frame = (long)value; // long
           }
         else
           if (!strcasecmp(key,deh_state[2]))  // Duration
             {
               if (fpout) fprintf(fpout," - tics = %lld\n",value);
-              states[indexnum].tics = (long)value; // long
+              infoEditState(indexnum)->tics = (long)value; // long
             }
           else
             if (!strcasecmp(key,deh_state[3]))  // Next frame
               {
                 if (fpout) fprintf(fpout," - nextstate = %lld\n",value);
-                states[indexnum].nextstate = (statenum_t)value;
+                infoEditState(indexnum)->nextstate = (statenum_t)value;
               }
             else
               if (!strcasecmp(key,deh_state[4]))  // Codep frame (not set in Frame deh block)
@@ -1878,13 +1878,13 @@ static void deh_procFrame(DEHFILE *fpin, FILE* fpout, char *line)
                 if (!strcasecmp(key,deh_state[5]))  // Unknown 1
                   {
                     if (fpout) fprintf(fpout," - misc1 = %lld\n",value);
-                    states[indexnum].misc1 = (long)value; // long
+                    infoEditState(indexnum)->misc1 = (long)value; // long
                   }
                 else
                   if (!strcasecmp(key,deh_state[6]))  // Unknown 2
                     {
                       if (fpout) fprintf(fpout," - misc2 = %lld\n",value);
-                      states[indexnum].misc2 = (long)value; // long
+                      infoEditState(indexnum)->misc2 = (long)value; // long
                     }
                   else
                     if (fpout) fprintf(fpout,"Invalid frame string index for '%s'\n",key);
@@ -1946,7 +1946,7 @@ static void deh_procPointer(DEHFILE *fpin, FILE* fpout, char *line) // done
 
       if (!strcasecmp(key,deh_state[4]))  // Codep frame (not set in Frame deh block)
         {
-          states[indexnum].action = deh_codeptr[value];
+          infoEditState(indexnum)->action = deh_codeptr[value];
           if (fpout) fprintf(fpout," - applied from codeptr[%lld] to states[%d]\n",
            value,indexnum);
           // Write BEX-oriented line to match:
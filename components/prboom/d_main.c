@@ -62,6 +62,8 @@
 #include "f_finale.h"
 #include "f_wipe.h"
 #include "m_argv.h"
+#include "m_bench.h"
+#include "m_census.h"
 #include "m_misc.h"
 #include "m_menu.h"
 #include "p_checksum.h"
@@ -77,9 +79,11 @@
 #include "p_setup.h"
 #include "r_draw.h"
 #include "r_main.h"
+#include "r_patch.h"
 #include "r_fps.h"
 #include "d_main.h"
 #include "d_deh.h"  // Ty 04/08/98 - Externalizations
+#include "d_pace.h"
 #include "lprintf.h"  // jff 08/03/98 - declaration of lprintf
 #include "am_map.h"
 
@@ -210,6 +214,7 @@ void D_Display (void)
   static gamestate_t oldgamestate = -1;
   boolean wipe;
   boolean viewactive = false, isborder = false;
+  unsigned long starttime = I_GetTimeUS();
 
   if (nodrawers)                    // for comparative timing / profiling
     return;
@@ -275,12 +280,14 @@ void D_Display (void)
     // Now do the drawing
     if (viewactive)
       R_RenderPlayerView (&players[displayplayer]);
+    M_BenchBegin(BENCH_HUD);
     if (automapmode & am_active)
       AM_Drawer();
     ST_Drawer((viewheight != SCREENHEIGHT) || ((automapmode & am_active) && !(automapmode & am_overlay)), redrawborderstuff);
     if (V_GetMode() != VID_MODEGL)
       R_DrawViewBorder();
     HU_Drawer();
+    M_BenchEnd(BENCH_HUD);
   }
 
   inhelpscreensstate = inhelpscreens;
@@ -296,6 +303,8 @@ void D_Display (void)
 
   // menus go directly to the screen
   M_Drawer();          // menu is drawn even on top of everything
+  if (menuactive)
+    ST_Overdrawn();
 #ifdef HAVE_NET
   NetUpdate();         // send out any new accumulation
 #else
@@ -303,12 +312,17 @@ void D_Display (void)
 #endif
 
   // normal update
-  if (!wipe || (V_GetMode() == VID_MODEGL))
+  if (!wipe || (V_GetMode() == VID_MODEGL)) {
+    M_BenchBegin(BENCH_PALETTE);
     I_FinishUpdate ();              // page flip or blit buffer
-  else {
+    M_BenchEnd(BENCH_PALETTE);
+    D_PacePresent(starttime);
+  } else {
     // wipe update
+    ST_Overdrawn();
     wipe_EndScreen();
     D_Wipe();
+    D_PaceReset();
   }
 
   I_EndDisplay();
@@ -339,6 +353,7 @@ static void D_DoomLoop(void)
 {
   for (;;)
     {
+      M_BenchBegin(BENCH_FRAME);
       WasRenderedInTryRunTics = false;
       // frame syncronous IO operations
       I_StartFrame ();
@@ -353,7 +368,9 @@ static void D_DoomLoop(void)
           if (advancedemo)
             D_DoAdvanceDemo ();
           M_Ticker ();
+          M_BenchBegin(BENCH_TICKER);
           G_Ticker ();
+          M_BenchEnd(BENCH_TICKER);
           P_Checksum(gametic);
           gametic++;
           maketic++;
@@ -365,14 +382,17 @@ static void D_DoomLoop(void)
       if (players[displayplayer].mo) // cph 2002/08/10
 	S_UpdateSounds(players[displayplayer].mo);// move positional sounds
 
-      if (V_GetMode() == VID_MODEGL ? 
+      if ((V_GetMode() == VID_MODEGL ?
         !movement_smooth || !WasRenderedInTryRunTics :
         !movement_smooth || !WasRenderedInTryRunTics || gamestate != wipegamestate
-      )
+      ) && !D_PaceSkip())
         {
         // Update display, next frame, with current state.
         D_Display();
       }
+      M_BenchEnd(BENCH_FRAME);
+      M_BenchFrame();
+      M_CensusFrame();
 
       // CPhipps - auto screenshot
       if (auto_shot_fname && !--auto_shot_count) {
@@ -624,6 +644,8 @@ static void CheckIWAD(const char *iwadname,GameMode_t *gmode,boolean *hassec)
 	int fd;
 	{
 	fd=I_Open(iwadname, 0);
+	if (fd<0)
+		I_Error("CheckIWAD: Can't open IWAD %s", iwadname);
 	I_Read(fd, &header, sizeof(header));
       // read IWAD header
       if (!strncmp(header.identification, "IWAD", 4))
@@ -1557,6 +1579,13 @@ static void D_DoomMainSetup(void)
   lprintf(LO_INFO,"R_Init: Init DOOM refresh daemon - ");
   R_Init();
 
+  if ((p = M_CheckParm("-bakepatches")) && ++p < myargc)
+  {
+    lprintf(LO_INFO, "\n");
+    R_BakePatches(myargv[p], p+1 < myargc ? atoi(myargv[p+1]) * 1024 : 0);
+    I_SafeExit(0);
+  }
+
   //jff 9/3/98 use logical output routine
   lprintf(LO_INFO,"\nP_Init: Init Playloop state.\n");
   P_Init();
@@ -1564,6 +1593,7 @@ static void D_DoomMainSetup(void)
   //jff 9/3/98 use logical output routine
   lprintf(LO_INFO,"I_Init: Setting up machine state.\n");
   I_Init();
+  D_PaceInit();
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_INFO,"S_Init: Setting up sound.\n");
@@ -1608,6 +1638,12 @@ static void D_DoomMainSetup(void)
     {
       P_RecordChecksum (myargv[p]);
     }
+  else if ((p = M_CheckParm ("-verifychecksum")) && ++p < myargc)
+    {
+      P_VerifyChecksum (myargv[p]);
+    }
+
+  censuslog = M_CheckParm("-census") != 0;  // memory census per level
 
   if ((p = M_CheckParm ("-fastdemo")) && ++p < myargc)
     {                                 // killough
@@ -1624,6 +1660,17 @@ static void D_DoomMainSetup(void)
   G_DeferedPlayDemo(myargv[p]);
   singledemo = true;            // quit after one demo
       }
+    else
+    if ((p = M_CheckParm("-benchmark")) && ++p < myargc)
+      { // -timedemo with a per-phase timing report, -benchmark demo [file]
+  singletics = true;
+  timingdemo = true;
+  nodrawers = false;            // the drawing is what we want to time
+  G_DeferedPlayDemo(myargv[p]);
+  singledemo = true;
+  ++p;                          // "-" alone is stdout, not the next option
+  M_BenchStart(p < myargc && (*myargv[p] != '-' || !myargv[p][1]) ? myargv[p] : "benchmark.csv");
+      }
     else
       if ((p = M_CheckParm("-playdemo")) && ++p < myargc)
   {
@@ -1655,7 +1702,10 @@ static void D_DoomMainSetup(void)
 
 void D_DoomMain(void)
 {
+  unsigned long setuptime = I_GetTimeUS();
+
   D_DoomMainSetup(); // CPhipps - setup out of main execution stack
+  lprintf(LO_INFO,"D_DoomMain: setup took %lu ms\n", (I_GetTimeUS()-setuptime)/1000);
 
   D_DoomLoop ();  // never returns
 }
@@ -0,0 +1,165 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Frame pacing.
+ *
+ *  Frames are scheduled in slots of 1/fps seconds, stretched to the
+ *  display's scanout time when that is longer, so the engine doesn't
+ *  render a frame only to wait for a free framebuffer. While no tic is
+ *  due the loop either draws an interpolated frame (uncapped framerate),
+ *  if its slot has come and it is done before the next tic, or sleeps
+ *  until the next slot or tic. A tic is never delayed for a frame.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+
+#include "doomstat.h"
+#include "d_pace.h"
+#include "m_argv.h"
+#include "r_fps.h"
+#include "i_main.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "lprintf.h"
+
+#define PACE_LOG_US 10000000  // -devparm: stats every 10 seconds
+#define TIC_US (1000000/TICRATE)
+
+static boolean pacing;
+static int targetfps = TICRATE;
+static long period;           // us per frame at the target rate
+static long slot;             // us per frame slot, see D_PacePresent
+static unsigned long nextframe;  // when the next slot starts
+static long rendertime;       // running averages, us
+static long scanouttime;
+static unsigned long lastlog;
+static pacestats_t stats;
+
+void D_PaceInit(void)
+{
+  int p;
+
+  if ((p = M_CheckParm("-fps")) && p < myargc-1)
+    targetfps = atoi(myargv[p+1]);
+
+  // Nothing to pace against in -timedemo, with a scaled clock or without a real one
+  pacing = targetfps > 0 && I_GetTime == I_GetTime_RealTime && I_GetTime_NextTicUS();
+  slot = period = pacing ? 1000000 / targetfps : 0;
+  nextframe = lastlog = I_GetTimeUS();
+}
+
+boolean D_PaceWait(void)
+{
+  long totic, toframe;
+
+  if (!pacing)
+    return movement_smooth;
+
+  // Start the frame early enough to present it when its slot begins
+  totic = I_GetTime_NextTicUS();
+  toframe = (long)(nextframe - I_GetTimeUS()) - rendertime;
+
+  if (movement_smooth && gamestate == wipegamestate)
+  {
+    if (toframe <= 0)
+    {
+      if (totic > rendertime)
+        return true;
+      // Not done before the tic, the frame after the tic is drawn instead
+      stats.skipped++;
+    }
+    else if (toframe + rendertime < totic)
+      totic = toframe;
+  }
+
+  I_uSleep(totic);
+  return false;
+}
+
+boolean D_PaceSkip(void)
+{
+  long toframe;
+
+  if (!pacing || gamestate != wipegamestate)
+    return false;
+
+  // With interpolation the frame is drawn when its slot comes, otherwise
+  // after whichever tic is closest to it
+  toframe = (long)(nextframe - I_GetTimeUS()) - rendertime;
+  return toframe > (movement_smooth ? 0 : TIC_US/2);
+}
+
+void D_PaceReset(void)
+{
+  nextframe = I_GetTimeUS() + slot;
+}
+
+void D_PacePresent(unsigned long start)
+{
+  unsigned long now = I_GetTimeUS();
+  long late;
+
+  if (!pacing)
+    return;
+
+  rendertime += ((long)(now - start) - rendertime) / 8;
+  scanouttime += ((long)I_GetScanoutUS() - scanouttime) / 8;
+
+  // No faster than the display takes frames, and without interpolation
+  // only whole tics apart
+  slot = scanouttime > period ? scanouttime : period;
+  if (!movement_smooth)
+    slot = slot < TIC_US ? TIC_US : (slot + TIC_US/2) / TIC_US * TIC_US;
+
+  stats.frames++;
+  late = (long)(now - nextframe);
+  if (late >= slot)
+    stats.dropped += late / slot;
+  else if (late > slot/8)
+    stats.late++;
+
+  // A late frame starts the slots over from now rather than catching up
+  nextframe = late > 0 ? now + slot : nextframe + slot;
+  if ((long)(nextframe - now) > slot)
+    nextframe = now + slot;
+
+  if (devparm && (long)(now - lastlog) >= PACE_LOG_US)
+  {
+    lastlog = now;
+    lprintf(LO_INFO, "D_Pace: %d fps target, %u frames, %u dropped, %u late, "
+            "%u skipped, render %ld us, scanout %ld us\n", targetfps, stats.frames,
+            stats.dropped, stats.late, stats.skipped, rendertime, scanouttime);
+  }
+}
+
+void D_GetPaceStats(pacestats_t *out)
+{
+  *out = stats;
+}
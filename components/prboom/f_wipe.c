@@ -137,6 +137,34 @@ static int wipe_doMelt(int ticks)
   return done;
 }
 
+// With page flipping the buffer we draw into changes every frame, so
+// the whole melt has to be redrawn instead of just the columns that moved.
+static void wipe_redrawMelt(void)
+{
+  int i, j, k;
+  const int depth = V_GetPixelDepth();
+
+  for (i=0;i<SCREENWIDTH;i++) {
+    int y = y_lookup[i] < 0 ? 0 : y_lookup[i];
+    byte *s = wipe_scr_end.data + i*depth;
+    byte *d = wipe_scr.data     + i*depth;
+
+    for (j=y;j;j--) {
+      for (k=0; k<depth; k++)
+        d[k] = s[k];
+      d += wipe_scr.byte_pitch;
+      s += wipe_scr_end.byte_pitch;
+    }
+    s = wipe_scr_start.data + i*depth;
+    for (j=SCREENHEIGHT-y;j;j--) {
+      for (k=0; k<depth; k++)
+        d[k] = s[k];
+      d += wipe_scr.byte_pitch;
+      s += wipe_scr_start.byte_pitch;
+    }
+  }
+}
+
 // CPhipps - modified to allocate and deallocate screens[2 to 3] as needed, saving memory
 
 static int wipe_exitMelt(int ticks)
@@ -163,7 +191,7 @@ int wipe_StartScreen(void)
   wipe_scr_start.not_on_heap = false;
   V_AllocScreen(&wipe_scr_start);
   screens[SRC_SCR] = wipe_scr_start;
-  V_CopyRect(0, 0, 0,       SCREENWIDTH, SCREENHEIGHT, 0, 0, SRC_SCR, VPT_NONE ); // Copy start screen to buffer
+  I_ReadScreen(&wipe_scr_start); // Copy start screen to buffer
   return 0;
 }
 
@@ -186,14 +214,20 @@ int wipe_EndScreen(void)
 int wipe_ScreenWipe(int ticks)
 {
   static boolean go;                               // when zero, stop the wipe
+  boolean done;
   if (!go)                                         // initial stuff
     {
       go = 1;
       wipe_scr = screens[0];
       wipe_initMelt(ticks);
     }
+  if (use_pageflip)
+    wipe_scr = screens[0];
   // do a piece of wipe-in
-  if (wipe_doMelt(ticks))     // final stuff
+  done = wipe_doMelt(ticks);
+  if (use_pageflip)
+    wipe_redrawMelt();
+  if (done)     // final stuff
     {
       wipe_exitMelt(ticks);
       go = 0;
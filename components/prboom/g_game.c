@@ -56,6 +56,8 @@
 #include "d_net.h"
 #include "f_finale.h"
 #include "m_argv.h"
+#include "m_bench.h"
+#include "m_census.h"
 #include "m_misc.h"
 #include "m_menu.h"
 #include "m_random.h"
@@ -2052,23 +2054,28 @@ void G_SetFastParms(int fast_pending)
   static int fast = 0;            // remembers fast state
   int i;
   if (fast != fast_pending) {     /* only change if necessary */
+    const state_t *oldstates = states;
+    const mobjinfo_t *oldmobjinfo = mobjinfo;
+
     if ((fast = fast_pending))
       {
         for (i=S_SARG_RUN1; i<=S_SARG_PAIN2; i++)
           if (states[i].tics != 1 || demo_compatibility) // killough 4/10/98
-            states[i].tics >>= 1;  // don't change 1->0 since it causes cycles
-        mobjinfo[MT_BRUISERSHOT].speed = 20*FRACUNIT;
-        mobjinfo[MT_HEADSHOT].speed = 20*FRACUNIT;
-        mobjinfo[MT_TROOPSHOT].speed = 20*FRACUNIT;
+            infoEditState(i)->tics >>= 1;  // don't change 1->0 since it causes cycles
+        infoEditMobjinfo(MT_BRUISERSHOT)->speed = 20*FRACUNIT;
+        infoEditMobjinfo(MT_HEADSHOT)->speed = 20*FRACUNIT;
+        infoEditMobjinfo(MT_TROOPSHOT)->speed = 20*FRACUNIT;
       }
     else
       {
         for (i=S_SARG_RUN1; i<=S_SARG_PAIN2; i++)
-          states[i].tics <<= 1;
-        mobjinfo[MT_BRUISERSHOT].speed = 15*FRACUNIT;
-        mobjinfo[MT_HEADSHOT].speed = 10*FRACUNIT;
-        mobjinfo[MT_TROOPSHOT].speed = 10*FRACUNIT;
+          infoEditState(i)->tics <<= 1;
+        infoEditMobjinfo(MT_BRUISERSHOT)->speed = 15*FRACUNIT;
+        infoEditMobjinfo(MT_HEADSHOT)->speed = 10*FRACUNIT;
+        infoEditMobjinfo(MT_TROOPSHOT)->speed = 10*FRACUNIT;
       }
+    // the fast cheat gets here in the middle of a level
+    P_RelocateInfo(oldstates, oldmobjinfo);
   }
 }
 
@@ -2877,6 +2884,13 @@ boolean G_CheckDemoStatus (void)
       int endtime = I_GetTime_RealTime ();
       // killough -- added fps information and made it work for longer demos:
       unsigned realtics = endtime-starttime;
+      M_CensusLevel();            // the last level's high water marks
+      if (benchmark)
+        { // a finished benchmark is not an error
+          M_BenchReport();
+          lprintf(LO_INFO, "Timed %u gametics\n", (unsigned) gametic);
+          I_SafeExit(0);
+        }
       I_Error ("Timed %u gametics in %u realtics = %-.1f frames per second",
                (unsigned) gametic,realtics,
                (unsigned) gametic * (double) TICRATE / realtics);
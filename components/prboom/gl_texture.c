@@ -219,7 +219,7 @@ static void gld_AddPatchToTexture_UnTranslated(GLTexture *gltexture, unsigned ch
 #endif
     column = &patch->columns[x];
     for (i=0; i<column->numPosts; i++) {
-      const rpost_t *post = &column->posts[i];
+      const rpost_t *post = &R_ColumnPosts(column)[i];
       y=(post->topdelta+originy);
       js=0;
       je=post->length;
@@ -231,7 +231,7 @@ static void gld_AddPatchToTexture_UnTranslated(GLTexture *gltexture, unsigned ch
         js=-y;
       if ((je+y)>gltexture->realtexheight)
         je+=(gltexture->realtexheight-(je+y));
-      source = column->pixels + post->topdelta;
+      source = R_ColumnPixels(column) + post->topdelta;
       if (paletted) {
         pos=(((js+y)*gltexture->buffer_width)+x+originx);
         for (j=js;j<je;j++,pos+=(gltexture->buffer_width))
@@ -313,7 +313,7 @@ void gld_AddPatchToTexture(GLTexture *gltexture, unsigned char *buffer, const rp
 #endif
     column = &patch->columns[x];
     for (i=0; i<column->numPosts; i++) {
-      const rpost_t *post = &column->posts[i];
+      const rpost_t *post = &R_ColumnPosts(column)[i];
       y=(post->topdelta+originy);
       js=0;
       je=post->length;
@@ -325,7 +325,7 @@ void gld_AddPatchToTexture(GLTexture *gltexture, unsigned char *buffer, const rp
         js=-y;
       if ((je+y)>gltexture->realtexheight)
         je+=(gltexture->realtexheight-(je+y));
-      source = column->pixels + post->topdelta;
+      source = R_ColumnPixels(column) + post->topdelta;
       if (paletted) {
         pos=(((js+y)*gltexture->buffer_width)+x+originx);
         for (j=js;j<je;j++,pos+=(gltexture->buffer_width))
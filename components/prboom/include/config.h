@@ -12,7 +12,10 @@
 //#define DOGS 0
 
 
+/* newlib provides strlwr; glibc on the native build does not */
+#ifdef ESP_PLATFORM
 #define HAVE_STRLWR 1
+#endif
 
 /* Define to be the path where Doom WADs are stored */
 #define DOOMWADDIR ""
@@ -0,0 +1,65 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Frame pacing: when to draw, skip or sleep.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __D_PACE__
+#define __D_PACE__
+
+#include "doomtype.h"
+
+typedef struct {
+  unsigned frames;   /* presented */
+  unsigned dropped;  /* slots that passed without a frame */
+  unsigned late;     /* presented more than 1/8 slot after the slot began */
+  unsigned skipped;  /* interpolated frames not drawn so as not to hold up a tic */
+} pacestats_t;
+
+/* Reads -fps (default TICRATE, 0 turns pacing off). Call after I_Init. */
+void D_PaceInit(void);
+
+/* Called while waiting for the next tic. Sleeps until the next tic or
+ * frame slot, or returns true when an interpolated frame is due now. */
+boolean D_PaceWait(void);
+
+/* True when the frame after a tic is too early for its slot */
+boolean D_PaceSkip(void);
+
+/* Starts the slots over from now, after a wipe or anything else that
+ * holds up the loop on purpose */
+void D_PaceReset(void);
+
+/* A frame begun at start (I_GetTimeUS) has been handed to the display */
+void D_PacePresent(unsigned long start);
+
+void D_GetPaceStats(pacestats_t *stats);
+
+#endif
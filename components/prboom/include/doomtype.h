@@ -82,10 +82,12 @@ typedef unsigned __int64 uint_64_t;
 #define CONSTFUNC __attribute__((const))
 #define PUREFUNC __attribute__((pure))
 #define NORETURN __attribute__ ((noreturn))
+#define THREADLOCAL __thread
 #else
 #define CONSTFUNC
 #define PUREFUNC
 #define NORETURN
+#define THREADLOCAL
 #endif
 
 //esp32
@@ -49,6 +49,13 @@ fixed_t I_GetTimeFrac (void);
 #endif
 void I_GetTime_SaveMS(void);
 
+/* Microseconds from an arbitrary start, for timing intervals; wraps */
+unsigned long I_GetTimeUS(void);
+
+/* Microseconds until I_GetTime_RealTime next advances, 0 if it doesn't
+ * follow a real clock */
+unsigned long I_GetTime_NextTicUS(void);
+
 unsigned long I_GetRandomTimeSeed(void); /* cphipps */
 
 void I_uSleep(unsigned long usecs);
@@ -75,6 +82,19 @@ int I_Filelength(int handle);
 
 void I_SetAffinityMask(void);
 
+/* Split-frame rendering, see R_RenderPlayerView.
+ * I_RenderThreads gives the platform's default number of render threads.
+ * I_RunRenderThreads calls func(0) .. func(count-1) concurrently, slice 0 on
+ * the calling thread, and returns once they have all finished. A slice other
+ * than 0 always runs on the same thread, so it can keep per-thread state.
+ * While they run, I_LockShared/I_UnlockShared serialise access to the zone
+ * heap and the lump and patch caches; the rest of the time they do nothing. */
+#define MAXRENDERTHREADS 8
+int I_RenderThreads(void);
+void I_RunRenderThreads(int count, void (*func)(int slice));
+void I_LockShared(void);
+void I_UnlockShared(void);
+
 
 int doom_main(int argc, char const * const * argv);
 
@@ -84,13 +104,36 @@ void I_Close(int fd);
 
 
 //HACK mmap support, w_mmap.c
+#ifndef MAP_FAILED
 #define PROT_READ 1
 #define MAP_SHARED 2
 #define MAP_FAILED (void*)-1
+#endif
 
 void *I_Mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
 int I_Munmap(void *addr, size_t length);
 
+//Flash mapping cache counters. Pages are MMU pages currently mapped.
+typedef struct {
+  unsigned hits, misses, evictions, mappings, pages;
+} mmapstats_t;
+
+void I_GetMmapStats(mmapstats_t *stats);
+
+//Memory for the zone's level arenas. fast asks for internal RAM, NULL if
+//there is none to spare; otherwise NULL means we're out of memory.
+void *I_ZoneArenaAlloc(size_t size, int fast);
+
+//Heap use per kind of RAM, for the memory census. All zero where the
+//platform can't tell internal from external RAM.
+typedef struct {
+  size_t size, free, minfree, largest;
+} heapstats_t;
+
+void I_GetHeapStats(heapstats_t *internal, heapstats_t *external);
+//Non zero if p lies in fast internal RAM
+int I_IsFastMemory(const void *p);
+
 int isValidPtr(void *ptr);
 
 #endif
@@ -54,8 +54,17 @@ void I_SetPalette(int pal); /* CPhipps - pass down palette number */
 void I_UpdateNoBlit (void);
 void I_FinishUpdate (void);
 
+/* Copies the frame that was last passed to I_FinishUpdate into dest.
+ * Needed for wipes when use_pageflip is set, since screens[0] then
+ * holds whatever the buffer last contained rather than the current frame. */
+void I_ReadScreen (screeninfo_t *dest);
+
 int I_ScreenShot (const char *fname);
 
+/* How long the display took to take the last frame out to the panel, in
+ * microseconds; 0 if presenting doesn't take time of its own. */
+unsigned long I_GetScanoutUS(void);
+
 /* I_StartTic
  * Called by D_DoomLoop,
  * called before processing each tic in a frame.
@@ -76,6 +85,7 @@ void I_StartTic (void);
 void I_StartFrame (void);
 
 extern int use_doublebuffer;  /* proff 2001-7-4 - controls wether to use doublebuffering*/
+extern int use_pageflip;  /* screens[0].data changes on every I_FinishUpdate, its contents don't persist */
 extern int use_fullscreen;  /* proff 21/05/2000 */
 extern int desired_fullscreen; //e6y
 
@@ -1495,6 +1495,13 @@ typedef struct
 /* See p_mobj_h for addition more technical info */
 extern mobjinfo_t *mobjinfo;
 
+/* states and mobjinfo point at the const tables until something changes
+ * them (DeHackEd, -fast). The first change to either copies that table
+ * to RAM, so go through these for the entry to write. A copy moves the
+ * table: pointers into the old one have to be relocated (P_RelocateInfo)
+ * if there are any. */
 void infoInit();
+state_t *infoEditState(int i);
+mobjinfo_t *infoEditMobjinfo(int i);
 
 #endif
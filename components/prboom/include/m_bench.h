@@ -0,0 +1,69 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  -benchmark: per-phase frame timing over a demo.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __M_BENCH__
+#define __M_BENCH__
+
+#include "doomtype.h"
+
+typedef enum {
+  BENCH_BSP,      /* R_RenderBSPNode, walls included */
+  BENCH_PLANES,   /* R_DrawPlanes */
+  BENCH_MASKED,   /* R_DrawMasked: sprites, masked mids, weapon */
+  BENCH_HUD,      /* automap, status bar, HUD */
+  BENCH_PALETTE,  /* I_FinishUpdate: palette conversion / display handoff */
+  BENCH_TICKER,   /* G_Ticker */
+  BENCH_FRAME,    /* the whole frame, tic and display */
+  NUMBENCHPHASES
+} benchphase_t;
+
+extern boolean benchmark;
+
+/* Sets up timing, the report goes to file when the demo ends ("-" for stdout) */
+void M_BenchStart(const char *file);
+
+/* Time a phase of the current frame. Phases may be entered more than once a
+ * frame, the times add up. Only the main thread is timed. */
+void M_BenchBegin(benchphase_t phase);
+void M_BenchEnd(benchphase_t phase);
+
+/* Closes the current frame */
+void M_BenchFrame(void);
+
+/* A level is set up: adds the -benchsprites crowd to it */
+void M_BenchLevel(void);
+
+/* Writes min/avg/p50/p95/p99 per phase, CSV or JSON by file extension */
+void M_BenchReport(void);
+
+#endif
@@ -0,0 +1,53 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Memory census: where the memory goes, by zone tag, kind of RAM and
+ *  subsystem, with high water marks per level.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __M_CENSUS__
+#define __M_CENSUS__
+
+#include "doomtype.h"
+
+extern boolean censusoverlay;   /* idmem: the census in place of idrate's */
+extern boolean censuslog;       /* -census: dumped at the end of each level */
+
+/* Samples the census every TICRATE tics while it's shown or logged */
+void M_CensusFrame(void);
+
+/* A level is done with and freed: logs its high water marks with -census
+ * and starts new ones for the next */
+void M_CensusLevel(void);
+
+/* The whole census and the locked lumps, through lprintf */
+void M_CensusDump(void);
+
+#endif
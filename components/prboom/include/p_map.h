@@ -52,6 +52,19 @@ boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean dropoff);
 boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y,boolean boss);
 void    P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+
+/* P_CheckSight remembers BSP walk results until sector heights change */
+typedef struct {
+  unsigned calls;     /* P_CheckSight calls */
+  unsigned rejects;   /* answered by REJECT */
+  unsigned pvs;       /* answered by the PVS */
+  unsigned pvsmisses; /* -pvsverify: PVS said hidden, the walk saw it */
+  unsigned hits;      /* answered by the cache, BSP walks saved */
+  unsigned walks;     /* BSP walks done */
+} sightstats_t;
+
+void P_InvalidateSightCache(void);
+void P_GetSightStats(sightstats_t *stats);
 void    P_UseLines(player_t *player);
 
 // killough 8/2/98: add 'mask' argument to prevent friends autoaiming at others
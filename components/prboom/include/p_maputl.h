@@ -65,6 +65,19 @@ typedef struct {
 
 typedef boolean (*traverser_t)(intercept_t *in);
 
+/* Things in the blockmap each own a slot, for as long as they live. The
+ * block lists are chained through the slots, and the slots keep a copy of
+ * the position and radius so P_CheckPosition and P_TeleportMove can scan
+ * them without touching the mobj_t of things they can't hit. */
+typedef struct {
+  fixed_t     x, y, radius;   /* as of the last P_SetThingPosition or
+                               * P_SyncBlockThing */
+  int         next;           /* next slot in the same block, 0 ends */
+} blockthing_t;
+
+extern blockthing_t *blockthings;
+extern mobj_t **blockmobjs;
+
 fixed_t CONSTFUNC P_AproxDistance (fixed_t dx, fixed_t dy);
 int     PUREFUNC  P_PointOnLineSide (fixed_t x, fixed_t y, const line_t *line);
 int     PUREFUNC  P_BoxOnLineSide (const fixed_t *tmbox, const line_t *ld);
@@ -77,6 +90,10 @@ void    P_UnsetThingPosition(mobj_t *thing);
 void    P_SetThingPosition(mobj_t *thing);
 boolean P_BlockLinesIterator (int x, int y, boolean func(line_t *));
 boolean P_BlockThingsIterator(int x, int y, boolean func(mobj_t *));
+void    P_ClearBlockThings(void);
+void    P_SyncBlockThing(mobj_t *thing);
+void    P_FreeBlockThing(mobj_t *thing);
+void    P_FlushBlockThings(void);
 boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
                        int flags, boolean trav(intercept_t *));
 
@@ -265,9 +265,9 @@ typedef struct mobj_s
     int                 frame;  // might be ORed with FF_FULLBRIGHT
 
     // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s*      bnext;
-    struct mobj_s**     bprev; // killough 8/11/98: change to ptr-to-ptr
+    // Links in blocks (if needed), see blockthings in p_maputl.h.
+    int                 blockslot; // 0 until first linked
+    int                 blockprev; // slot before, -1-block if first, 0 unlinked
 
     struct subsector_s* subsector;
 
@@ -388,6 +388,7 @@ extern int iquetail;
 void    P_RespawnSpecials(void);
 mobj_t  *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type);
 void    P_RemoveMobj(mobj_t *th);
+void    P_RelocateInfo(const state_t *oldstates, const mobjinfo_t *oldmobjinfo);
 boolean P_SetMobjState(mobj_t *mobj, statenum_t state);
 void    P_MobjThinker(mobj_t *mobj);
 void    P_SpawnPuff(fixed_t x, fixed_t y, fixed_t z);
@@ -0,0 +1,61 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Subsector potentially visible sets.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __P_PVS__
+#define __P_PVS__
+
+#include "doomtype.h"
+#include "m_fixed.h"
+
+/* -pvs: build a PVS in P_SetupLevel, -pvsverify checks sight against it */
+extern boolean pvsenabled, pvsverify;
+
+/* One row of pvsrowwords per subsector, bit b of row a set when any point
+ * of subsector b may be seen from subsector a. NULL when there is none. */
+extern const unsigned *pvsmatrix;
+extern int pvsrowwords;
+
+#define P_PVSVisible(a, b) \
+  (pvsmatrix[(a)*pvsrowwords + ((b)>>5)] & (1u << ((b)&31)))
+
+/* Called by P_SetupLevel once the map is loaded */
+void P_BuildPVS(void);
+
+/* The PVS is built for the subsector's area inside its segs, positions
+ * outside it (things stuck in the void, noclip) must not use it */
+boolean P_PVSInside(int ss, fixed_t x, fixed_t y);
+
+/* How long the last and the slowest P_BuildPVS took, in microseconds */
+void P_GetPVSBuildTime(unsigned long *last, unsigned long *longest);
+
+#endif
@@ -52,6 +52,6 @@ extern int      bmapwidth;
 extern int      bmapheight;      /* in mapblocks */
 extern fixed_t  bmaporgx;
 extern fixed_t  bmaporgy;        /* origin of block map */
-extern mobj_t   **blocklinks;    /* for thing chains */
+extern int      *blocklinks;     /* first thing's slot in each block */
 
 #endif
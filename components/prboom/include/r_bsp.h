@@ -38,22 +38,24 @@
 #pragma interface
 #endif
 
-extern seg_t    *curline;
-extern side_t   *sidedef;
-extern line_t   *linedef;
-extern sector_t *frontsector;
-extern sector_t *backsector;
+/* Per render thread, see R_RenderPlayerView */
+extern THREADLOCAL seg_t    *curline;
+extern THREADLOCAL side_t   *sidedef;
+extern THREADLOCAL line_t   *linedef;
+extern THREADLOCAL sector_t *frontsector;
+extern THREADLOCAL sector_t *backsector;
 
 /* old code -- killough:
  * extern drawseg_t drawsegs[MAXDRAWSEGS];
  * new code -- killough: */
-extern drawseg_t *drawsegs;
-extern unsigned maxdrawsegs;
+extern THREADLOCAL drawseg_t *drawsegs;
+extern THREADLOCAL unsigned maxdrawsegs;
 
-extern byte solidcol[MAX_SCREENWIDTH];
+extern THREADLOCAL byte *solidcol; /* MAX_SCREENWIDTH entries */
 
-extern drawseg_t *ds_p;
+extern THREADLOCAL drawseg_t *ds_p;
 
+void R_InitBspThreadState(void);
 void R_ClearClipSegs(void);
 void R_ClearDrawSegs(void);
 void R_RenderBSPNode(int bspnum);
@@ -144,6 +144,20 @@ R_DrawSpan_f R_GetDrawSpanFunc(enum draw_filter_type_e filter,
                                enum draw_filter_type_e filterz);
 void R_DrawSpan(draw_span_vars_t *dsvars);
 
+// A visible, clipped piece of a sprite post: count pixels down from row yl,
+// source[frac>>FRACBITS] stepping frac by the column's fracstep
+typedef struct {
+  int yl, count;
+  fixed_t frac;
+  const byte *source;
+} spriterun_t;
+
+// The runs of one 8 bit sprite column, straight to the screen. translation
+// and tranmap are NULL unless the sprite is translated or translucent.
+void R_DrawSpriteRuns8(int x, const spriterun_t *runs, int numruns,
+                       fixed_t fracstep, const lighttable_t *colormap,
+                       const byte *translation, const byte *tranmap);
+
 void R_InitBuffer(int width, int height);
 
 // Initialize color translation tables, for player rendering etc.
@@ -160,4 +174,7 @@ void R_DrawViewBorder(void);
 // column drawing.
 void R_ResetColumnBuffer(void);
 
+// Gives a split-frame render thread its own column buffer.
+void R_InitDrawThreadState(void);
+
 #endif
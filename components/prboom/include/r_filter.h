@@ -101,11 +101,11 @@ byte *filter_getScale2xQuadColors(byte e, byte b, byte f, byte h, byte d);
 // accuracy for discerning viewers, but the alternative requires converting
 // from 32 bit, which is slow and requires both the intPalette and the 
 // shortPalette to be in memory at the same time.
-#define filter_getFilteredForColumn16(depthmap, texV, nextRowTexV) ( \
-  VID_PAL16( depthmap(nextsource[(nextRowTexV)>>FRACBITS]),   (filter_fracu*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS) ) + \
-  VID_PAL16( depthmap(source[(nextRowTexV)>>FRACBITS]),       ((0xffff-filter_fracu)*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS) ) + \
-  VID_PAL16( depthmap(source[(texV)>>FRACBITS]),              ((0xffff-filter_fracu)*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS) ) + \
-  VID_PAL16( depthmap(nextsource[(texV)>>FRACBITS]),          (filter_fracu*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS) ))
+#define filter_getFilteredForColumn16(depthmap, texV, nextRowTexV) VID_SWAP16( \
+  VID_SWAP16(VID_PAL16( depthmap(nextsource[(nextRowTexV)>>FRACBITS]),   (filter_fracu*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS) )) + \
+  VID_SWAP16(VID_PAL16( depthmap(source[(nextRowTexV)>>FRACBITS]),       ((0xffff-filter_fracu)*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS) )) + \
+  VID_SWAP16(VID_PAL16( depthmap(source[(texV)>>FRACBITS]),              ((0xffff-filter_fracu)*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS) )) + \
+  VID_SWAP16(VID_PAL16( depthmap(nextsource[(texV)>>FRACBITS]),          (filter_fracu*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS) )))
 
 #define filter_getFilteredForColumn15(depthmap, texV, nextRowTexV) ( \
   VID_PAL15( depthmap(nextsource[(nextRowTexV)>>FRACBITS]),   (filter_fracu*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS) ) + \
@@ -122,11 +122,11 @@ byte *filter_getScale2xQuadColors(byte e, byte b, byte f, byte h, byte d);
 
 // Use 16 bit addition here since it's a little faster and the defects from
 // such low-accuracy blending are less visible on spans
-#define filter_getFilteredForSpan16(depthmap, texU, texV) ( \
-  VID_PAL16( depthmap(source[ ((((texU)+FRACUNIT)>>16)&0x3f) | ((((texV)+FRACUNIT)>>10)&0xfc0)]),  (unsigned int)(((texU)&0xffff)*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS)) + \
-  VID_PAL16( depthmap(source[ (((texU)>>16)&0x3f) | ((((texV)+FRACUNIT)>>10)&0xfc0)]),             (unsigned int)((0xffff-((texU)&0xffff))*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS)) + \
-  VID_PAL16( depthmap(source[ (((texU)>>16)&0x3f) | (((texV)>>10)&0xfc0)]),                        (unsigned int)((0xffff-((texU)&0xffff))*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS)) + \
-  VID_PAL16( depthmap(source[ ((((texU)+FRACUNIT)>>16)&0x3f) | (((texV)>>10)&0xfc0)]),             (unsigned int)(((texU)&0xffff)*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS)))
+#define filter_getFilteredForSpan16(depthmap, texU, texV) VID_SWAP16( \
+  VID_SWAP16(VID_PAL16( depthmap(source[ ((((texU)+FRACUNIT)>>16)&0x3f) | ((((texV)+FRACUNIT)>>10)&0xfc0)]),  (unsigned int)(((texU)&0xffff)*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS))) + \
+  VID_SWAP16(VID_PAL16( depthmap(source[ (((texU)>>16)&0x3f) | ((((texV)+FRACUNIT)>>10)&0xfc0)]),             (unsigned int)((0xffff-((texU)&0xffff))*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS))) + \
+  VID_SWAP16(VID_PAL16( depthmap(source[ (((texU)>>16)&0x3f) | (((texV)>>10)&0xfc0)]),                        (unsigned int)((0xffff-((texU)&0xffff))*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS))) + \
+  VID_SWAP16(VID_PAL16( depthmap(source[ ((((texU)+FRACUNIT)>>16)&0x3f) | (((texV)>>10)&0xfc0)]),             (unsigned int)(((texU)&0xffff)*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS))))
 
 #define filter_getFilteredForSpan15(depthmap, texU, texV) ( \
   VID_PAL15( depthmap(source[ ((((texU)+FRACUNIT)>>16)&0x3f) | ((((texV)+FRACUNIT)>>10)&0xfc0)]),  (unsigned int)(((texU)&0xffff)*((texV)&0xffff))>>(32-VID_COLORWEIGHTBITS)) + \
@@ -135,14 +135,18 @@ byte *filter_getScale2xQuadColors(byte e, byte b, byte f, byte h, byte d);
   VID_PAL15( depthmap(source[ ((((texU)+FRACUNIT)>>16)&0x3f) | (((texV)>>10)&0xfc0)]),             (unsigned int)(((texU)&0xffff)*(0xffff-((texV)&0xffff)))>>(32-VID_COLORWEIGHTBITS)))
 
 // do red and blue at once for slight speedup
+// The 16 bit ones work on native order, GETBLENDED16_* take and return
+// VID_BIGENDIAN16 pixels
 
 #define GETBLENDED15_5050(col1, col2) \
   ((((col1&0x7c1f)+(col2&0x7c1f))>>1)&0x7c1f) | \
   ((((col1&0x03e0)+(col2&0x03e0))>>1)&0x03e0)
 
-#define GETBLENDED16_5050(col1, col2) \
+#define GETBLENDED16N_5050(col1, col2) \
   ((((col1&0xf81f)+(col2&0xf81f))>>1)&0xf81f) | \
   ((((col1&0x07e0)+(col2&0x07e0))>>1)&0x07e0)
+#define GETBLENDED16_5050(col1, col2) \
+  VID_SWAP16(GETBLENDED16N_5050(VID_SWAP16(col1), VID_SWAP16(col2)))
 
 #define GETBLENDED32_5050(col1, col2) \
   ((((col1&0xff00ff)+(col2&0xff00ff))>>1)&0xff00ff) | \
@@ -152,9 +156,11 @@ byte *filter_getScale2xQuadColors(byte e, byte b, byte f, byte h, byte d);
   ((((col1&0x7c1f)*5+(col2&0x7c1f)*11)>>4)&0x7c1f) | \
   ((((col1&0x03e0)*5+(col2&0x03e0)*11)>>4)&0x03e0)
 
-#define GETBLENDED16_3268(col1, col2) \
+#define GETBLENDED16N_3268(col1, col2) \
   ((((col1&0xf81f)*5+(col2&0xf81f)*11)>>4)&0xf81f) | \
   ((((col1&0x07e0)*5+(col2&0x07e0)*11)>>4)&0x07e0)
+#define GETBLENDED16_3268(col1, col2) \
+  VID_SWAP16(GETBLENDED16N_3268(VID_SWAP16(col1), VID_SWAP16(col2)))
 
 #define GETBLENDED32_3268(col1, col2) \
   ((((col1&0xff00ff)*5+(col2&0xff00ff)*11)>>4)&0xff00ff) | \
@@ -164,9 +170,11 @@ byte *filter_getScale2xQuadColors(byte e, byte b, byte f, byte h, byte d);
   ((((col1&0x7c1f)*15+(col2&0x7c1f))>>4)&0x7c1f) | \
   ((((col1&0x03e0)*15+(col2&0x03e0))>>4)&0x03e0)
 
-#define GETBLENDED16_9406(col1, col2) \
+#define GETBLENDED16N_9406(col1, col2) \
   ((((col1&0xf81f)*15+(col2&0xf81f))>>4)&0xf81f) | \
   ((((col1&0x07e0)*15+(col2&0x07e0))>>4)&0x07e0)
+#define GETBLENDED16_9406(col1, col2) \
+  VID_SWAP16(GETBLENDED16N_9406(VID_SWAP16(col1), VID_SWAP16(col2)))
 
 #define GETBLENDED32_9406(col1, col2) \
   ((((col1&0xff00ff)*15+(col2&0xff00ff))>>4)&0xff00ff) | \
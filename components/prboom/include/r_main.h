@@ -65,9 +65,33 @@ extern int      validcount;
 // Rendering stats
 //
 
-extern int rendered_visplanes, rendered_segs, rendered_vissprites;
+extern THREADLOCAL int rendered_visplanes, rendered_segs, rendered_vissprites;
+extern THREADLOCAL int rendered_nodes;
+
+/* BSP nodes the main thread walked, and frames, for -benchmark */
+void R_GetBspStats(unsigned long *nodes, unsigned long *frames);
+/* Masked pixels the main thread drew, and how many on the sprite run path */
+void R_GetMaskedStats(unsigned long *pixels, unsigned long *runs);
+
+/* The main thread's vissprite sorts: places the insertion pass moved
+ * sprites, and sorts it left to msort */
+typedef struct {
+  unsigned long frames, sprites, moves, fullsorts, us;
+} sortstats_t;
+
+void R_GetSortStats(sortstats_t *stats);
 extern boolean rendering_stats;
 
+//
+// Split-frame rendering
+//
+
+extern int r_numthreads;        // render threads, -rthreads
+extern boolean r_verifysplit;   // check against a single-threaded render, -rverify
+// Screen columns the calling thread may draw; the whole width outside
+// R_RenderPlayerView
+extern THREADLOCAL int r_stripx1, r_stripx2;
+
 //
 // Lighting LUT.
 // Used for z-depth cuing per column/row,
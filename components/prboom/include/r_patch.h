@@ -32,6 +32,8 @@
 #ifndef R_PATCH_H
 #define R_PATCH_H
 
+#include "z_zone.h"
+
 // Used to specify the sloping of the top and bottom of a column post
 typedef enum {
   RDRAW_EDGESLOPE_TOP_UP   = (1<<0),
@@ -48,12 +50,19 @@ typedef struct {
   edgeslope_t slope;
 } rpost_t;
 
+// A column finds its posts and pixels at offsets from itself, so that
+// patch data works wherever it lies, including pre-baked in flash.
 typedef struct {
   int numPosts;
-  rpost_t *posts;
-  unsigned char *pixels;
+  int postsOffset;
+  int pixelsOffset;
 } rcolumn_t;
 
+#define R_ColumnPosts(column) \
+  ((rpost_t *)((unsigned char *)(column) + (column)->postsOffset))
+#define R_ColumnPixels(column) \
+  ((unsigned char *)(column) + (column)->pixelsOffset)
+
 typedef struct {
   int width;
   int height;
@@ -108,4 +117,18 @@ const rcolumn_t *R_GetPatchColumn(const rpatch_t *patch, int columnIndex);
 void R_InitPatches();
 void R_FlushAllPatches();
 
+// Converted patches and composites in the zone, and how many of either
+// are locked, of which pre-baked ones mapped from flash
+typedef struct {
+  census_t patches;
+  census_t composites;
+  unsigned locked, locks, mapped;
+} patchcensus_t;
+
+void R_GetPatchCensus(patchcensus_t *census);
+
+// Converts every patch and composite texture up front, for later runs to
+// use from rpatch.bin instead. maxsize, if not 0, limits the file size.
+void R_BakePatches(const char *file, int maxsize);
+
 #endif
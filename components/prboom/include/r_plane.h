@@ -43,14 +43,19 @@
 /* killough 10/98: special mask indicates sky flat comes from sidedef */
 #define PL_SKYFLAT (0x80000000)
 
-/* Visplane related. */
-extern int *lastopening; // dropoff overflow
+/* Visplane related, per render thread. */
+extern THREADLOCAL int *openings, *lastopening; // dropoff overflow
+extern THREADLOCAL size_t maxopenings;
 
-extern int floorclip[], ceilingclip[]; // dropoff overflow
+extern THREADLOCAL int *floorclip, *ceilingclip; // dropoff overflow
 extern fixed_t yslope[], distscale[];
 
 void R_InitPlanes(void);
+void R_InitPlaneThreadState(void);
 void R_ClearPlanes(void);
+
+/* Visplanes allocated by all render threads, with their hash indexes */
+void R_GetPlaneCensus(census_t *census);
 void R_DrawPlanes (void);
 
 visplane_t *R_FindPlane(
@@ -104,13 +104,13 @@ extern player_t         *viewplayer;
 extern angle_t          clipangle;
 extern int              viewangletox[FINEANGLES/2];
 extern angle_t          xtoviewangle[MAX_SCREENWIDTH+1];  // killough 2/8/98
-extern fixed_t          rw_distance;
-extern angle_t          rw_normalangle;
+extern THREADLOCAL fixed_t rw_distance;
+extern THREADLOCAL angle_t rw_normalangle;
 
 // angle to line origin
-extern int              rw_angle1;
+extern THREADLOCAL int  rw_angle1;
 
-extern visplane_t       *floorplane;
-extern visplane_t       *ceilingplane;
+extern THREADLOCAL visplane_t *floorplane;
+extern THREADLOCAL visplane_t *ceilingplane;
 
 #endif
@@ -45,12 +45,17 @@
 extern int negonearray[MAX_SCREENWIDTH];       /* killough 2/8/98: */ // dropoff overflow
 extern int screenheightarray[MAX_SCREENWIDTH]; /* change to MAX_*  */ // dropoff overflow
 
-/* Vars for R_DrawMaskedColumn */
+/* Vars for R_DrawMaskedColumn, per render thread */
 
-extern int     *mfloorclip;    // dropoff overflow
-extern int     *mceilingclip;  // dropoff overflow
-extern fixed_t spryscale;
-extern fixed_t sprtopscreen;
+extern THREADLOCAL int     *mfloorclip;    // dropoff overflow
+extern THREADLOCAL int     *mceilingclip;  // dropoff overflow
+extern THREADLOCAL fixed_t spryscale;
+extern THREADLOCAL fixed_t sprtopscreen;
+extern THREADLOCAL int rendered_maskedpixels, rendered_runpixels;
+extern boolean r_spriteruns;
+extern THREADLOCAL int rendered_sortsprites, rendered_sortmoves, rendered_fullsorts;
+extern THREADLOCAL unsigned rendered_sortus;
+extern boolean r_spriteorder;
 extern fixed_t pspritescale;
 extern fixed_t pspriteiscale;
 /* proff 11/06/98: Added for high-res */
@@ -67,6 +72,9 @@ void R_AddSprites(subsector_t* subsec, int lightlevel);
 void R_DrawPlayerSprites(void);
 void R_InitSprites(const char * const * namelist);
 void R_ClearSprites(void);
+
+/* Vissprites allocated by all render threads, with their sort pointers */
+void R_GetSpriteCensus(census_t *census);
 void R_DrawMasked(void);
 
 #endif
@@ -42,7 +42,7 @@
 // Background and foreground screen numbers
 //
 #define BG 4
-#define FG 0
+#define FG 5    // the status bar's own composite, see ST_Drawer
 
 //
 // Typedefs of widgets
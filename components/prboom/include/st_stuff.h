@@ -69,6 +69,35 @@ void ST_Start(void);
 // Called by startup code.
 void ST_Init(void);
 
+// The parts of the status bar redrawn since the last frame went out, in
+// screen pixels, for displays that keep what they showed before.
+#define ST_MAXDIRTY 8
+
+typedef struct
+{
+  int x, y, w, h;
+} stdirty_t;
+
+typedef struct
+{
+  unsigned long frames;     // frames the status bar was in
+  unsigned long fullframes; // of those, the ones it had to go out whole
+  unsigned long rects, pixels;
+} stdamagestats_t;
+
+// Called by st_lib.c, in 320x200 status bar coordinates.
+void ST_MarkDirty(int x, int y, int w, int h);
+
+// Something other than the status bar was drawn over its rows.
+void ST_Overdrawn(void);
+
+// Called by the video code once a frame. Returns how many rects the status
+// bar rows need to be updated in, or -1 if this frame doesn't leave them
+// to the status bar and they have to go out with the rest of it.
+int ST_GetDirtyRects(stdirty_t *rects);
+
+void ST_GetDamageStats(stdamagestats_t *stats);
+
 // States for status bar code.
 typedef enum
 {
@@ -83,6 +83,9 @@ typedef struct {
   int byte_pitch;      // tha actual width of one line, used when mallocing
   int short_pitch;     // tha actual width of one line, used when mallocing
   int int_pitch;       // tha actual width of one line, used when mallocing
+  int top;             // the frame row of the first line, for a screen that
+                       // only holds the bottom of the frame; drawing takes
+                       // frame coordinates and clips above it
 } screeninfo_t;
 
 #define NUM_SCREENS 6
@@ -108,6 +111,16 @@ extern unsigned int *V_Palette32;
 
 #define VID_PAL15(color, weight) V_Palette15[ (color)*VID_NUMCOLORWEIGHTS + (weight) ]
 #define VID_PAL16(color, weight) V_Palette16[ (color)*VID_NUMCOLORWEIGHTS + (weight) ]
+
+// 16 bit pixels are RGB565 stored big-endian, the byte order the LCD takes,
+// so a VID_MODE16 frame goes out without any conversion. Anything doing
+// arithmetic on them swaps to native order and back.
+#define VID_BIGENDIAN16
+#ifdef VID_BIGENDIAN16
+#define VID_SWAP16(c) ((unsigned short)(((c)>>8)|((c)<<8)))
+#else
+#define VID_SWAP16(c) ((unsigned short)(c))
+#endif
 #define VID_PAL32(color, weight) V_Palette32[ (color)*VID_NUMCOLORWEIGHTS + (weight) ]
 
 // The available bit-depth modes
@@ -35,6 +35,8 @@
 #ifndef __W_WAD__
 #define __W_WAD__
 
+#include "z_zone.h"
+
 #ifdef __GNUG__
 #pragma interface
 #endif
@@ -131,6 +133,11 @@ const void* W_CacheLumpNum (int lump);
 const void* W_LockLumpNum(int lump);
 void    W_UnlockLumpNum(int lump);
 
+// Lumps copied to the zone by W_LockLumpNum, and how many are locked
+void    W_GetLockCensus(census_t *copies, unsigned *locked, unsigned *locks);
+// Lists the locked lumps
+void    W_ReportLocks(void);
+
 // CPhipps - convenience macros
 //#define W_CacheLumpNum(num) (W_CacheLumpNum)((num),1)
 #define W_CacheLumpName(name) W_CacheLumpNum (W_GetNumForName(name))
@@ -32,17 +32,21 @@
  *-----------------------------------------------------------------------------*/
 
 struct block_memory_alloc_s {
-  void  *firstpool;
+  void  *firstpool;   /* pools with a free block */
   size_t size;
-  size_t perpool;
+  size_t perpool;     /* at least this many blocks per pool */
   int    tag;
   const char *desc;
+  size_t span;        /* pool size and alignment, 0 until first used */
+  size_t blocks;      /* blocks per pool */
+  size_t header;      /* offset of the first block */
+  int    slabpools;   /* pools in the next allocation */
 };
 
 #define DECLARE_BLOCK_MEMORY_ALLOC_ZONE(name) extern struct block_memory_alloc_s name
 #define IMPLEMENT_BLOCK_MEMORY_ALLOC_ZONE(name, size, tag, num, desc) \
-struct block_memory_alloc_s name = { NULL, size, num, tag, desc}
-#define NULL_BLOCK_MEMORY_ALLOC_ZONE(name) name.firstpool = NULL
+struct block_memory_alloc_s name = { NULL, size, num, tag, desc, 0, 0, 0, 0}
+#define NULL_BLOCK_MEMORY_ALLOC_ZONE(name) (name.firstpool = NULL, name.slabpools = 0)
 
 void* Z_BMalloc(struct block_memory_alloc_s *pzone);
 
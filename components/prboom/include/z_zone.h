@@ -82,6 +82,35 @@ char *(Z_Strdup)(const char *s, int tag, void **user DA(const char *, int));
 void (Z_CheckHeap)(DAC(const char *,int));   // killough 3/22/98: add file/line info
 void Z_DumpHistory(char *);
 
+/* Level arena usage, in bytes with block headers */
+typedef struct {
+  size_t reserved;      /* chunks taken from the platform */
+  size_t used;          /* bump allocated since the last reset */
+  size_t live;          /* of which not freed yet */
+  size_t peak;          /* highest used */
+  unsigned resets;      /* levels freed */
+  unsigned pinned;      /* resets skipped for blocks outliving the level */
+} zonearenastats_t;
+
+void Z_GetArenaStats(zonearenastats_t *fast, zonearenastats_t *slow);
+
+/* Memory census: live blocks and bytes, block headers included, and the
+ * most bytes live since the peaks were last reset */
+typedef struct {
+  unsigned count;
+  size_t bytes;
+  size_t peak;
+} census_t;
+
+/* Zone blocks per tag, [tag][0] in slow RAM and [tag][1] in fast internal
+ * RAM. [PU_FREE] holds the totals. Kept up to date by every allocation. */
+void Z_GetCensus(census_t census[PU_MAX][2]);
+void Z_ResetCensusPeaks(void);
+
+/* Adds up the blocks whose owner pointer lies in [lo, hi), for the census
+ * of a subsystem keeping its blocks' owners in an array. Walks the zone. */
+void Z_CensusOwners(const void *lo, const void *hi, census_t *census);
+
 #ifdef INSTRUMENTED
 /* cph - save space if not debugging, don't require file 
  * and line to memory calls */
@@ -44,6 +44,7 @@
 #include "p_enemy.h"
 #include "p_pspr.h"
 #include "w_wad.h"
+#include "lprintf.h"
 
 #ifdef __GNUG__
 #pragma implementation "info.h"
@@ -4903,9 +4904,28 @@ const mobjinfo_t romobjinfo[NUMMOBJTYPES] = {
 };
 
 
+//Both tables are read straight from flash until they are patched, which most games never do
 void infoInit() {
-	states=malloc(sizeof(rostates));
-	memcpy(states, rostates, sizeof(rostates));
-	mobjinfo=malloc(sizeof(romobjinfo));
-	memcpy(mobjinfo, romobjinfo, sizeof(romobjinfo));
+	states=(state_t *)rostates;
+	mobjinfo=(mobjinfo_t *)romobjinfo;
+}
+
+state_t *infoEditState(int i) {
+	if (states==rostates) {
+		state_t *copy=malloc(sizeof(rostates));
+		if (!copy) I_Error("infoEditState: no memory for the states table");
+		memcpy(copy, rostates, sizeof(rostates));
+		states=copy;
+	}
+	return &states[i];
+}
+
+mobjinfo_t *infoEditMobjinfo(int i) {
+	if (mobjinfo==romobjinfo) {
+		mobjinfo_t *copy=malloc(sizeof(romobjinfo));
+		if (!copy) I_Error("infoEditMobjinfo: no memory for the mobjinfo table");
+		memcpy(copy, romobjinfo, sizeof(romobjinfo));
+		mobjinfo=copy;
+	}
+	return &mobjinfo[i];
 }
\ No newline at end of file
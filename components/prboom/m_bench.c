@@ -0,0 +1,310 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  -benchmark: per-phase frame timing over a demo.
+ *
+ *  Every pass through the main loop (one tic and one display in
+ *  -benchmark, which runs like -timedemo) is a frame. The time spent in
+ *  each phase is recorded per frame in microseconds and summarised when
+ *  the demo ends.
+ *
+ *  -benchsprites n adds a crowd for the masked phase: n monsters kept in
+ *  rows in front of the player. They don't think, block, get hit or touch
+ *  the RNG, so the demo plays as it would without them.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "doomstat.h"
+#include "m_bench.h"
+#include "m_argv.h"
+#include "m_random.h"
+#include "i_system.h"
+#include "p_map.h"
+#include "p_maputl.h"
+#include "p_mobj.h"
+#include "p_pvs.h"
+#include "r_main.h"
+#include "st_stuff.h"
+#include "lprintf.h"
+
+boolean benchmark;
+
+static const char *const phasenames[NUMBENCHPHASES] = {
+  "bsp", "planes", "masked", "hud", "palette", "ticker", "frame"
+};
+
+static const char *reportfile;
+static unsigned long phasestart[NUMBENCHPHASES];
+static unsigned curframe[NUMBENCHPHASES];
+static unsigned (*frames)[NUMBENCHPHASES];
+static int numframes, maxframes;
+
+static int scenesize;          // -benchsprites
+static mobj_t **scene;
+
+#define SCENEROW 10            // monsters to a row
+
+static const mobjtype_t scenetypes[] = {
+  MT_POSSESSED, MT_SHOTGUY, MT_TROOP, MT_SERGEANT
+};
+
+void M_BenchStart(const char *file)
+{
+  int p;
+
+  benchmark = true;
+  reportfile = file;
+  if ((p = M_CheckParm("-benchsprites")) && p < myargc-1)
+  {
+    scenesize = atoi(myargv[p+1]);
+    if (scenesize <= 0)
+      I_Error("M_BenchStart: -benchsprites needs a number of monsters, not %s",
+              myargv[p+1]);
+    if (!(scene = malloc(scenesize * sizeof(*scene))))
+      I_Error("M_BenchStart: no memory for %d -benchsprites monsters", scenesize);
+  }
+}
+
+// Rows 48 units apart from 96 units in front of the player, each as wide
+// as it is far away
+static void M_BenchPlaceScene(void)
+{
+  const mobj_t *pmo = players[displayplayer].mo;
+  int an, i;
+
+  if (!pmo)
+    return;
+  an = pmo->angle >> ANGLETOFINESHIFT;
+  for (i = 0; i < scenesize; i++)
+  {
+    mobj_t *mo = scene[i];
+    fixed_t dist = (96 + 48 * (i / SCENEROW)) * FRACUNIT;
+    fixed_t side = dist / (2*SCENEROW) * (2 * (i % SCENEROW) - (SCENEROW-1));
+
+    P_UnsetThingPosition(mo);
+    mo->x = pmo->x + FixedMul(dist, finecosine[an]) - FixedMul(side, finesine[an]);
+    mo->y = pmo->y + FixedMul(dist, finesine[an]) + FixedMul(side, finecosine[an]);
+    P_SetThingPosition(mo);
+    mo->z = mo->floorz = mo->subsector->sector->floorheight;
+    mo->ceilingz = mo->subsector->sector->ceilingheight;
+    mo->angle = pmo->angle + ANG180 + (angle_t) i * (ANG45/2);
+  }
+}
+
+void M_BenchLevel(void)
+{
+  rng_t saved = rng;
+  int i;
+
+  if (!benchmark || scenesize <= 0)
+    return;
+
+  for (i = 0; i < scenesize; i++)
+  {
+    mobj_t *mo = P_SpawnMobj(0, 0, ONFLOORZ,
+                             scenetypes[i % (sizeof(scenetypes)/sizeof(*scenetypes))]);
+
+    P_UnsetThingPosition(mo);
+    mo->flags = (mo->flags & ~(MF_SOLID | MF_SHOOTABLE | MF_COUNTKILL)) |
+      MF_NOBLOCKMAP | MF_NOCLIP | MF_NOGRAVITY;
+    mo->tics = -1;               // stays in its spawn state, no thinking
+    P_SetThingPosition(mo);
+    scene[i] = mo;
+  }
+  rng = saved;                   // P_SpawnMobj takes a random number
+  M_BenchPlaceScene();
+}
+
+void M_BenchBegin(benchphase_t phase)
+{
+  if (benchmark)
+    phasestart[phase] = I_GetTimeUS();
+}
+
+void M_BenchEnd(benchphase_t phase)
+{
+  if (benchmark)
+    curframe[phase] += I_GetTimeUS() - phasestart[phase];
+}
+
+void M_BenchFrame(void)
+{
+  if (!benchmark)
+    return;
+
+  if (numframes == maxframes)
+  {
+    frames = realloc(frames, (maxframes = maxframes ? maxframes*2 : 1024) * sizeof(*frames));
+    if (!frames)
+      I_Error("M_BenchFrame: no memory for %d frames", maxframes);
+  }
+
+  memcpy(frames[numframes++], curframe, sizeof(curframe));
+  memset(curframe, 0, sizeof(curframe));
+
+  // the player has moved, take the crowd along for the next frame
+  if (scenesize > 0 && gamestate == GS_LEVEL)
+    M_BenchPlaceScene();
+}
+
+static int M_BenchCompare(const void *a, const void *b)
+{
+  unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+  return x < y ? -1 : x > y;
+}
+
+// nearest-rank percentile of a sorted sample
+static unsigned M_BenchPercentile(const unsigned *sorted, int n, int pct)
+{
+  int rank = (pct * n + 99) / 100;
+  return sorted[rank > 0 ? rank-1 : 0];
+}
+
+void M_BenchReport(void)
+{
+  FILE *f;
+  unsigned *sorted;
+  mmapstats_t mmap;
+  zonearenastats_t fast, slow;
+  sightstats_t sight;
+  sortstats_t sort;
+  stdamagestats_t stdamage;
+  unsigned long bspnodes, bspframes, maskedpixels, runpixels, pvsus, pvsmaxus;
+  double maskedtime = 0;
+  boolean json;
+  int i, phase;
+
+  if (!benchmark || !numframes)
+    return;
+
+  json = strlen(reportfile) > 5 && !strcasecmp(reportfile + strlen(reportfile) - 5, ".json");
+  if (!strcmp(reportfile, "-"))
+    f = stdout;
+  else if (!(f = fopen(reportfile, "w")))
+  {
+    lprintf(LO_ERROR, "M_BenchReport: can't write %s: %s\n", reportfile, strerror(errno));
+    return;
+  }
+
+  if (json)
+    fprintf(f, "{\n  \"frames\": %d,\n  \"unit\": \"us\",\n  \"phases\": {\n", numframes);
+  else
+    fprintf(f, "phase,frames,min_us,avg_us,p50_us,p95_us,p99_us,max_us\n");
+
+  if (!(sorted = malloc(numframes * sizeof(*sorted))))
+    I_Error("M_BenchReport: no memory to sort %d frames", numframes);
+  for (phase = 0; phase < NUMBENCHPHASES; phase++)
+  {
+    double total = 0;
+
+    for (i = 0; i < numframes; i++)
+      total += sorted[i] = frames[i][phase];
+    qsort(sorted, numframes, sizeof(*sorted), M_BenchCompare);
+    if (phase == BENCH_MASKED)
+      maskedtime = total;
+
+    if (json)
+      fprintf(f, "    \"%s\": { \"min\": %u, \"avg\": %.1f, \"p50\": %u, "
+              "\"p95\": %u, \"p99\": %u, \"max\": %u }%s\n", phasenames[phase],
+              sorted[0], total / numframes, M_BenchPercentile(sorted, numframes, 50),
+              M_BenchPercentile(sorted, numframes, 95),
+              M_BenchPercentile(sorted, numframes, 99), sorted[numframes-1],
+              phase < NUMBENCHPHASES-1 ? "," : "");
+    else
+      fprintf(f, "%s,%d,%u,%.1f,%u,%u,%u,%u\n", phasenames[phase], numframes,
+              sorted[0], total / numframes, M_BenchPercentile(sorted, numframes, 50),
+              M_BenchPercentile(sorted, numframes, 95),
+              M_BenchPercentile(sorted, numframes, 99), sorted[numframes-1]);
+  }
+  free(sorted);
+
+  if (json)
+    fprintf(f, "  }\n}\n");
+  if (f != stdout)
+    fclose(f);
+  lprintf(LO_INFO, "M_BenchReport: %d frames written to %s\n", numframes, reportfile);
+
+  I_GetMmapStats(&mmap);
+  lprintf(LO_INFO, "M_BenchReport: mmap %u hits, %u misses, %u evictions, "
+          "%u mappings over %u pages\n", mmap.hits, mmap.misses, mmap.evictions,
+          mmap.mappings, mmap.pages);
+
+  Z_GetArenaStats(&fast, &slow);
+  lprintf(LO_INFO, "M_BenchReport: level arenas peak %luK fast, %luK slow, "
+          "%luK of %luK used still live\n", (unsigned long) fast.peak >> 10,
+          (unsigned long) slow.peak >> 10, (unsigned long) (fast.live + slow.live) >> 10,
+          (unsigned long) (fast.used + slow.used) >> 10);
+
+  P_GetSightStats(&sight);
+  lprintf(LO_INFO, "M_BenchReport: sight %u checks, %u rejected, %u by PVS, "
+          "%u cached, %u BSP walks\n", sight.calls, sight.rejects, sight.pvs,
+          sight.hits, sight.walks);
+  if (sight.pvsmisses)
+    lprintf(LO_WARN, "M_BenchReport: %u sight checks the PVS got wrong\n",
+            sight.pvsmisses);
+  if (pvsenabled)
+  {
+    P_GetPVSBuildTime(&pvsus, &pvsmaxus);
+    lprintf(LO_INFO, "M_BenchReport: PVS build %lu ms, %lu ms at most\n",
+            pvsus / 1000, pvsmaxus / 1000);
+  }
+
+  R_GetBspStats(&bspnodes, &bspframes);
+  if (bspframes)
+    lprintf(LO_INFO, "M_BenchReport: %.1f BSP nodes visited per frame\n",
+            (double) bspnodes / bspframes);
+
+  R_GetMaskedStats(&maskedpixels, &runpixels);
+  if (maskedpixels && maskedtime)
+    lprintf(LO_INFO, "M_BenchReport: %.0f masked pixels per frame, %.0f%% of them "
+            "on the sprite run path, %.1f per us in the masked phase\n",
+            (double) maskedpixels / numframes, runpixels * 100.0 / maskedpixels,
+            maskedpixels / maskedtime);
+
+  R_GetSortStats(&sort);
+  if (sort.frames)
+    lprintf(LO_INFO, "M_BenchReport: %.1f vissprites sorted per frame in %.2f us, "
+            "%.1f insertion moves, %lu of %lu frames left to msort\n",
+            (double) sort.sprites / sort.frames, (double) sort.us / sort.frames,
+            (double) sort.moves / sort.frames, sort.fullsorts, sort.frames);
+
+  ST_GetDamageStats(&stdamage);
+  if (stdamage.frames > stdamage.fullframes)
+    lprintf(LO_INFO, "M_BenchReport: status bar in %lu frames, %lu sent whole, "
+            "otherwise %.2f rects and %.0f of %d pixels per frame\n",
+            stdamage.frames, stdamage.fullframes,
+            (double) stdamage.rects / (stdamage.frames - stdamage.fullframes),
+            (double) stdamage.pixels / (stdamage.frames - stdamage.fullframes),
+            SCREENWIDTH * ST_SCALED_HEIGHT);
+}
@@ -0,0 +1,203 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Memory census.
+ *
+ *  The zone counts its blocks and bytes per tag and kind of RAM on every
+ *  allocation, the renderer its visplanes and vissprites as it grows
+ *  them. Patches, composite textures and locked lumps, whose blocks'
+ *  owners are in arrays, are added up from the zone when the census is
+ *  taken; their high water marks are the highest the census has seen,
+ *  looking every second of game time while it's shown (idmem) or logged
+ *  (-census).
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include "doomstat.h"
+#include "m_census.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "r_patch.h"
+#include "r_plane.h"
+#include "r_things.h"
+#include "w_wad.h"
+#include "lprintf.h"
+
+boolean censusoverlay;
+boolean censuslog;
+
+typedef struct {
+  census_t zone[PU_MAX][2];
+  heapstats_t internal, external;
+  patchcensus_t patches;
+  census_t planes, sprites;
+  census_t lumps;
+  unsigned lumpslocked, lumplocks;
+} memcensus_t;
+
+static const char *const tagnames[PU_MAX] = {
+  "free", "static", "sound", "music", "level", "levspec", "cache"
+};
+
+// High water marks of what's only seen by taking the census
+static size_t patchpeak, compositepeak, lumppeak;
+static size_t internallow, externallow;
+
+static char levelname[9];
+
+static void M_CensusPeak(census_t *census, size_t *peak)
+{
+  if (census->bytes > *peak)
+    *peak = census->bytes;
+  census->peak = *peak;
+}
+
+static size_t M_CensusLow(size_t free, size_t *low)
+{
+  if (free < *low || !*low)
+    *low = free;
+  return *low;
+}
+
+static void M_CensusTake(memcensus_t *census)
+{
+  Z_GetCensus(census->zone);
+  I_GetHeapStats(&census->internal, &census->external);
+  R_GetPatchCensus(&census->patches);
+  R_GetPlaneCensus(&census->planes);
+  R_GetSpriteCensus(&census->sprites);
+  W_GetLockCensus(&census->lumps, &census->lumpslocked, &census->lumplocks);
+
+  M_CensusPeak(&census->patches.patches, &patchpeak);
+  M_CensusPeak(&census->patches.composites, &compositepeak);
+  M_CensusPeak(&census->lumps, &lumppeak);
+  M_CensusLow(census->internal.free, &internallow);
+  M_CensusLow(census->external.free, &externallow);
+}
+
+#define K(bytes) ((unsigned long) ((bytes) + 1023) >> 10)
+
+void M_CensusFrame(void)
+{
+  static int lasttic;
+  memcensus_t census;
+  const census_t *total;
+
+  if (!censusoverlay && !censuslog)
+    return;
+  if ((unsigned) (gametic - lasttic) < TICRATE)
+    return;
+  lasttic = gametic;
+
+  M_CensusTake(&census);
+  if (!censusoverlay || gamestate != GS_LEVEL)
+    return;
+
+  total = census.zone[PU_FREE];
+  doom_printf("Zone %luK, %luK fast, peak %luK\n"
+              "Level %luK, cache %luK, patches %luK\n"
+              "Heap free %luK int, %luK ext",
+              K(total[0].bytes + total[1].bytes), K(total[1].bytes),
+              K(total[0].peak + total[1].peak),
+              K(census.zone[PU_LEVEL][0].bytes + census.zone[PU_LEVEL][1].bytes +
+                census.zone[PU_LEVSPEC][0].bytes + census.zone[PU_LEVSPEC][1].bytes),
+              K(census.zone[PU_CACHE][0].bytes + census.zone[PU_CACHE][1].bytes),
+              K(census.patches.patches.bytes + census.patches.composites.bytes),
+              K(census.internal.free), K(census.external.free));
+}
+
+static void M_CensusHeap(const char *name, const heapstats_t *heap, size_t low)
+{
+  if (!heap->size)
+    lprintf(LO_INFO, "  %s heap: n/a\n", name);
+  else
+    lprintf(LO_INFO, "  %s heap: %luK free of %luK, %luK lowest this level, %luK "
+            "lowest ever, largest block %luK\n", name, K(heap->free), K(heap->size),
+            K(low), K(heap->minfree), K(heap->largest));
+}
+
+static void M_CensusTag(const char *name, const census_t census[2])
+{
+  lprintf(LO_INFO, "  %-10s %5u %7luK %7luK %5u %7luK %7luK\n", name,
+          census[0].count, K(census[0].bytes), K(census[0].peak),
+          census[1].count, K(census[1].bytes), K(census[1].peak));
+}
+
+static void M_CensusLine(const char *name, const census_t *census)
+{
+  lprintf(LO_INFO, "  %-10s %5u %7luK %7luK\n", name, census->count,
+          K(census->bytes), K(census->peak));
+}
+
+void M_CensusDump(void)
+{
+  memcensus_t census;
+  int tag;
+
+  M_CensusTake(&census);
+
+  lprintf(LO_INFO, "M_CensusDump: zone blocks live and highest%s%s\n"
+          "  %-10s %5s %8s %8s %5s %8s %8s\n", *levelname ? " in " : "", levelname,
+          "tag", "slow", "K", "peak", "fast", "K", "peak");
+  for (tag = PU_FREE+1; tag < PU_MAX; tag++)
+    M_CensusTag(tagnames[tag], census.zone[tag]);
+  M_CensusTag("total", census.zone[PU_FREE]);
+
+  M_CensusHeap("internal", &census.internal, internallow);
+  M_CensusHeap("external", &census.external, externallow);
+
+  lprintf(LO_INFO, "M_CensusDump: subsystems\n"
+          "  %-10s %5s %8s %8s\n", "", "count", "K", "peak");
+  M_CensusLine("patches", &census.patches.patches);
+  M_CensusLine("composites", &census.patches.composites);
+  M_CensusLine("visplanes", &census.planes);
+  M_CensusLine("vissprites", &census.sprites);
+  M_CensusLine("lumps", &census.lumps);
+  lprintf(LO_INFO, "M_CensusDump: %u patches locked %u times, %u of them mapped "
+          "from flash; %u lumps locked %u times\n", census.patches.locked,
+          census.patches.locks, census.patches.mapped, census.lumpslocked,
+          census.lumplocks);
+  if (census.lumpslocked)
+    W_ReportLocks();
+}
+
+void M_CensusLevel(void)
+{
+  if (censuslog && *levelname)
+    M_CensusDump();
+
+  Z_ResetCensusPeaks();
+  patchpeak = compositepeak = lumppeak = 0;
+  internallow = externallow = 0;
+
+  if (gamemode == commercial)
+    snprintf(levelname, sizeof(levelname), "MAP%02d", gamemap);
+  else
+    snprintf(levelname, sizeof(levelname), "E%dM%d", gameepisode, gamemap);
+}
@@ -43,6 +43,7 @@
 #include "dstrings.h"
 #include "r_main.h"
 #include "p_map.h"
+#include "m_census.h"
 #include "d_deh.h"  // Ty 03/27/98 - externalized strings
 /* cph 2006/07/23 - needs direct access to thinkercap */
 #include "p_tick.h"
@@ -67,6 +68,7 @@ static void cheat_behold();
 static void cheat_clev();
 static void cheat_mypos();
 static void cheat_rate();
+static void cheat_mem();
 static void cheat_comp();
 static void cheat_friction();
 static void cheat_pushers();
@@ -171,6 +173,9 @@ struct cheat_s cheat[] = {
   {"idrate",     "Frame rate",        0,
    cheat_rate     },
 
+  {"idmem",      "Memory census",     0,
+   cheat_mem      },
+
   {"tntcomp",    NULL,                not_net | not_demo,
    cheat_comp     },     // phares
 
@@ -467,6 +472,13 @@ static void cheat_rate()
   rendering_stats ^= 1;
 }
 
+// memory census, shown and dumped to the console
+static void cheat_mem()
+{
+  censusoverlay ^= 1;
+  M_CensusDump();
+}
+
 // compatibility cheat
 
 static void cheat_comp()
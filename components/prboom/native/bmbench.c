@@ -0,0 +1,192 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Z_BMalloc/Z_BFree throughput against the byte map allocator they
+ *  replaced, which scanned every pool with memchr to allocate and with
+ *  iselem to free.
+ *
+ *  The pattern is the secnode one: a working set of live blocks, each
+ *  step freeing a random one and allocating another.
+ *
+ *    make bmbench && ./bmbench [live blocks] [steps]
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "../z_bmalloc.c"
+
+/* Just enough of the zone for the allocators */
+
+void *(Z_Malloc)(size_t size, int tag, void **user)
+{
+  return (malloc)(size);
+}
+
+void *(Z_Calloc)(size_t n1, size_t n2, int tag, void **user)
+{
+  return (calloc)(n1, n2);
+}
+
+void I_Error(const char *error, ...)
+{
+  va_list argptr;
+  va_start(argptr, error);
+  vfprintf(stderr, error, argptr);
+  va_end(argptr);
+  fputc('\n', stderr);
+  exit(1);
+}
+
+/* The old allocator, as it was */
+
+typedef struct oldpool_s {
+  struct oldpool_s *nextpool;
+  size_t            blocks;
+  byte              used[0];
+} oldpool_t;
+
+inline static void* old_getelem(oldpool_t *p, size_t size, size_t n)
+{
+  return (((byte*)p) + sizeof(oldpool_t) + sizeof(byte)*(p->blocks) + size*n);
+}
+
+inline static int old_iselem(const oldpool_t *pool, size_t size, const void* p)
+{
+  int dif = (const char*)p - (const char*)pool;
+
+  dif -= sizeof(oldpool_t);
+  dif -= pool->blocks;
+  if (dif<0) return -1;
+  dif /= size;
+  return (((size_t)dif >= pool->blocks) ? -1 : dif);
+}
+
+static void* Old_BMalloc(struct block_memory_alloc_s *pzone)
+{
+  oldpool_t **pool = (oldpool_t **)&(pzone->firstpool);
+  while (*pool != NULL) {
+    byte *p = memchr((*pool)->used, 0, (*pool)->blocks);
+    if (p) {
+      int n = p - (*pool)->used;
+      (*pool)->used[n] = 1;
+      return old_getelem(*pool, pzone->size, n);
+    } else
+      pool = &((*pool)->nextpool);
+  }
+  {
+    oldpool_t *newpool;
+
+    *pool = newpool = Z_Calloc(sizeof(*newpool) + (sizeof(byte) + pzone->size)*(pzone->perpool),
+             1,  pzone->tag, NULL);
+    newpool->nextpool = NULL;
+    newpool->used[0] = 1;
+    newpool->blocks = pzone->perpool;
+    return old_getelem(newpool, pzone->size, 0);
+  }
+}
+
+static void Old_BFree(struct block_memory_alloc_s *pzone, void* p)
+{
+  oldpool_t **pool = (oldpool_t**)&(pzone->firstpool);
+
+  while (*pool != NULL) {
+    int n = old_iselem(*pool, pzone->size, p);
+    if (n >= 0) {
+      (*pool)->used[n] = 0;
+      if (memchr(((*pool)->used), 1, (*pool)->blocks) == NULL) {
+        oldpool_t *oldpool = *pool;
+        *pool = (*pool)->nextpool;
+        (free)(oldpool);
+      }
+      return;
+    } else pool = &((*pool)->nextpool);
+  }
+  I_Error("Old_BFree: Free not in zone %s", pzone->desc);
+}
+
+/* secnode sized, 32 per pool like p_map.c's zone */
+#define NODESIZE (4*sizeof(void *) + 3*sizeof(int))
+
+static double Bench(const char *name, void *(*alloc)(struct block_memory_alloc_s *),
+                    void (*release)(struct block_memory_alloc_s *, void *),
+                    int live, long steps)
+{
+  struct block_memory_alloc_s zone = { NULL, NODESIZE, 32, 0, name, 0, 0, 0, 0 };
+  void **blocks = (malloc)(live * sizeof(*blocks));
+  struct timespec t0, t1;
+  unsigned seed = 1;
+  double ns;
+  long i;
+
+  for (i = 0; i < live; i++)
+    blocks[i] = alloc(&zone);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < steps; i++)
+  {
+    int n;
+
+    seed = seed * 1103515245 + 12345;
+    n = (seed >> 8) % live;
+    release(&zone, blocks[n]);
+    blocks[n] = alloc(&zone);
+    *(int *)blocks[n] = i;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / steps;
+  printf("%-6s %6d live  %7.1f ns per free+alloc\n", name, live, ns);
+  (free)(blocks);
+  return ns;
+}
+
+int main(int argc, char **argv)
+{
+  int live = argc > 1 ? atoi(argv[1]) : 0;
+  long steps = argc > 2 ? atol(argv[2]) : 2000000;
+  static const int sizes[] = { 64, 512, 4096 };
+  int i;
+
+  for (i = 0; i < 3; i++)
+  {
+    int n = live > 0 ? live : sizes[i];
+    double old = Bench("old", Old_BMalloc, Old_BFree, n, steps);
+    double new = Bench("bitmap", Z_BMalloc, Z_BFree, n, steps);
+
+    printf("%-6s %6d live  %7.1fx\n", "", n, old / new);
+    if (live > 0)
+      break;
+  }
+  return 0;
+}
@@ -195,12 +195,9 @@ void I_SafeExit(int rc)
 uid_t stored_euid = -1;
 #endif
 
-extern unsigned char *doom1waddata;
-
 //int main(int argc, const char * const * argv)
 int main(int argc, char const * const *argv)
 {
-	int f;
 #ifdef SECURE_UID
   /* First thing, revoke setuid status (if any) */
   stored_euid = geteuid();
@@ -210,16 +207,6 @@ int main(int argc, char const * const *argv)
     else
       fprintf(stderr, "Revoked uid %d\n",stored_euid);
 #endif
-	doom1waddata=malloc(4*1024*1024);
-	f=open("../../../doom1-cut.wad", O_RDONLY);
-	if (f<=0) {
-		printf("Cant open wad\n");
-		exit(1);
-	}
-	read(f, doom1waddata, 4*1024*1024);
-	close(f);
-
-
   myargc = argc;
   myargv = argv;
 
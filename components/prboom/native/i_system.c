@@ -57,7 +57,11 @@
 #include <sched.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "m_argv.h"
 #include "lprintf.h"
@@ -94,6 +98,12 @@ int I_GetTime_RealTime (void)
   return realtime++;
 }
 
+// Every call is a new tic, not a real clock
+unsigned long I_GetTime_NextTicUS(void)
+{
+  return 0;
+}
+
 fixed_t I_GetTimeFrac (void)
 {
   return 0;
@@ -103,6 +113,13 @@ void I_GetTime_SaveMS(void)
 {
 }
 
+unsigned long I_GetTimeUS(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000UL+ts.tv_nsec/1000;
+}
+
 unsigned long I_GetRandomTimeSeed(void)
 {
 	return 4;
@@ -119,7 +136,12 @@ const char* I_SigString(char* buf, size_t sz, int signum)
   return buf;
 }
 
-unsigned char *doom1waddata;
+//
+// WAD access. The ESP32 maps the WAD flash partition; here the file is
+// mmapped whole so I_Mmap hands out pointers into it the same way.
+// The IWAD is -iwad, else $DOOMWAD, else the WAD the flash image is
+// built from.
+//
 
 typedef struct {
 	unsigned char *mem;
@@ -132,16 +154,33 @@ static FileDesc fds[64];
 
 
 int I_Open(const char *wad, int flags) {
-	int x=3;
+	struct stat st;
+	int x=3, f, p;
 	while (fds[x].mem!=NULL) x++;
 	if (strcmp(wad, "DOOM1.WAD")==0) {
-		fds[x].mem=doom1waddata;
-		fds[x].offset=0;
-		fds[x].size=3370127; //ToDo: de-hardcode - JD
-	} else {
-		lprintf(LO_INFO, "I_Open: open %s failed\n", wad);
+		if ((p=M_CheckParm("-iwad")) && ++p<myargc) wad=myargv[p];
+		else if (getenv("DOOMWAD")) wad=getenv("DOOMWAD");
+		else wad="../../../doom1-cut.wad";
+	} else if (strcmp(wad, "rpatch.bin")==0) {
+		//Pre-baked patches, next to the WAD like on the device
+		if ((p=M_CheckParm("-rpatches")) && ++p<myargc) wad=myargv[p];
+		else wad="../../../rpatch.bin";
+	}
+	f=open(wad, O_RDONLY);
+	if (f<0 || fstat(f, &st)<0) {
+		lprintf(LO_INFO, "I_Open: open %s failed: %s\n", wad, strerror(errno));
+		if (f>=0) close(f);
+		return -1;
+	}
+	fds[x].mem=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, f, 0);
+	close(f);
+	if (fds[x].mem==MAP_FAILED) {
+		fds[x].mem=NULL;
+		lprintf(LO_INFO, "I_Open: mmap %s failed: %s\n", wad, strerror(errno));
 		return -1;
 	}
+	fds[x].offset=0;
+	fds[x].size=st.st_size;
 	return x;
 }
 
@@ -151,7 +190,7 @@ int I_Lseek(int ifd, off_t offset, int whence) {
 	} else if (whence==SEEK_CUR) {
 		fds[ifd].offset+=offset;
 	} else if (whence==SEEK_END) {
-		lprintf(LO_INFO, "I_Lseek: SEEK_END unimplemented\n");
+		fds[ifd].offset=fds[ifd].size+offset;
 	}
 	return fds[ifd].offset;
 }
@@ -171,9 +210,16 @@ int I_Filelength(int ifd)
 	return fds[ifd].size;
 }
 
+void I_Close(int fd) {
+	munmap(fds[fd].mem, fds[fd].size);
+	fds[fd].mem=NULL;
+}
+
+
+static mmapstats_t mmapStats;
 
 void *I_Mmap(void *addr, size_t length, int prot, int flags, int ifd, off_t offset) {
-	lprintf(LO_INFO, "I_Mmap: mmapped offset %d\n", (int)offset);
+	mmapStats.hits++;
 	return fds[ifd].mem+offset;
 }
 
@@ -182,6 +228,36 @@ int I_Munmap(void *addr, size_t length) {
 	return 0;
 }
 
+//The whole file is mapped, every I_Mmap is a hit.
+void I_GetMmapStats(mmapstats_t *stats)
+{
+	*stats=mmapStats;
+}
+
+//Same internal RAM budget as the default on the device, so the fallback gets exercised
+static size_t zoneFastUsed;
+
+void *I_ZoneArenaAlloc(size_t size, int fast)
+{
+	if (fast) {
+		if (zoneFastUsed+size > 32*1024) return NULL;
+		zoneFastUsed+=size;
+	}
+	return (malloc)(size);
+}
+
+//One kind of RAM here, nothing to tell apart
+void I_GetHeapStats(heapstats_t *internal, heapstats_t *external)
+{
+	memset(internal, 0, sizeof(*internal));
+	memset(external, 0, sizeof(*external));
+}
+
+int I_IsFastMemory(const void *p)
+{
+	return 0;
+}
+
 
 const char *I_DoomExeDir(void)
 {
@@ -202,6 +278,86 @@ void I_SetAffinityMask(void)
 {
 }
 
+//
+// Split-frame rendering: a pool of pthreads, slice 0 runs on the caller.
+// Threads are started on first use and slice n always runs on thread n, so
+// each keeps its own renderer state.
+//
+
+static pthread_t renderThread[MAXRENDERTHREADS];
+static pthread_mutex_t renderMux=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t renderStart=PTHREAD_COND_INITIALIZER;
+static pthread_cond_t renderDone=PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t sharedMux;
+static int renderThreads=1, renderGeneration, renderPending, renderCount;
+static void (*renderFunc)(int slice);
+static volatile int sharedActive;
+
+static void *renderThreadMain(void *arg) {
+	int slice=(intptr_t)arg;
+	int generation=0;
+	while(1) {
+		pthread_mutex_lock(&renderMux);
+		while (renderGeneration==generation) pthread_cond_wait(&renderStart, &renderMux);
+		generation=renderGeneration;
+		pthread_mutex_unlock(&renderMux);
+
+		if (slice<renderCount) renderFunc(slice);
+
+		pthread_mutex_lock(&renderMux);
+		if (--renderPending==0) pthread_cond_signal(&renderDone);
+		pthread_mutex_unlock(&renderMux);
+	}
+	return NULL;
+}
+
+int I_RenderThreads(void)
+{
+	return 1;
+}
+
+void I_RunRenderThreads(int count, void (*func)(int slice))
+{
+	int i;
+	if (renderThreads==1) {
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(&sharedMux, &attr);
+	}
+	while (renderThreads<count) {
+		if (pthread_create(&renderThread[renderThreads], NULL, renderThreadMain, (void*)(intptr_t)renderThreads))
+			I_Error("I_RunRenderThreads: can't start render thread");
+		renderThreads++;
+	}
+
+	sharedActive=1;
+	pthread_mutex_lock(&renderMux);
+	renderFunc=func;
+	renderCount=count;
+	renderPending=renderThreads-1;
+	renderGeneration++;
+	pthread_cond_broadcast(&renderStart);
+	pthread_mutex_unlock(&renderMux);
+
+	func(0);
+
+	pthread_mutex_lock(&renderMux);
+	while (renderPending) pthread_cond_wait(&renderDone, &renderMux);
+	pthread_mutex_unlock(&renderMux);
+	sharedActive=0;
+}
+
+void I_LockShared(void)
+{
+	if (sharedActive) pthread_mutex_lock(&sharedMux);
+}
+
+void I_UnlockShared(void)
+{
+	if (sharedActive) pthread_mutex_unlock(&sharedMux);
+}
+
 
 int access(const char *path, int atype) {
     return 1;
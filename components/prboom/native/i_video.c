@@ -27,13 +27,16 @@
  *  02111-1307, USA.
  *
  * DESCRIPTION:
- *  DOOM graphics stuff for SDL
+ *  DOOM graphics stuff for the native headless build
  *
  *-----------------------------------------------------------------------------
  */
 
 #include "config.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <unistd.h>
 #include "m_argv.h"
 #include "doomstat.h"
@@ -51,11 +54,40 @@
 #include "w_wad.h"
 #include "st_stuff.h"
 #include "lprintf.h"
+#include "m_bench.h"
 #include <stdint.h>
 #include "rom/ets_sys.h"
+#include "../../prboom-esp32-compat/include/lcd_convert.h"
 
 int use_fullscreen=0;
 int use_doublebuffer=0;
+int use_pageflip=0;
+
+//
+// Frame sinks. -framesink picks where finished frames go:
+//  ascii       rough rendition on the terminal (default)
+//  null        nowhere, for timing (default with -benchmark); the frame is
+//              still converted, so the palette phase times that
+//  raw [file]  the frames as rendered appended to file (frames.raw): 8-bit
+//              indices, or big-endian RGB565 with -vidmode 16
+//  ppm [fmt]   one PPM per frame, fmt is a printf pattern (frame%05d.ppm)
+//  crc [file]  CRC-32 of every RGB565 frame, one per line (- for stdout)
+// Everything but null and raw goes through the same RGB565 conversion as
+// the LCD, so crc logs catch palette changes too. 8 and 16 bit frames only
+// differ where 16 bit blends instead of using TRANMAP and the fuzz
+// colormap, and at a few edge pixels of HUD patches.
+//
+typedef enum { SINK_ASCII, SINK_NULL, SINK_RAW, SINK_PPM, SINK_CRC } framesink_t;
+
+static framesink_t framesink=SINK_ASCII;
+static const char *sinkpath;
+static FILE *sinkfile;
+static int sinkframe;
+static boolean stverify;   // -stverify, see I_VerifyStatusBar
+
+static byte rgbpal[256*3];
+static uint16_t lcdpal[256];
+static uint16_t lcdfb[SCREENWIDTH*SCREENHEIGHT];
 
 
 void I_StartTic (void)
@@ -121,6 +153,8 @@ static void I_UploadNewPalette(int pal)
 
 void I_ShutdownGraphics(void)
 {
+	if (sinkfile && sinkfile!=stdout) fclose(sinkfile);
+	sinkfile=NULL;
 }
 
 //
@@ -130,58 +164,196 @@ void I_UpdateNoBlit (void)
 {
 }
 
+
+static uint32_t crctab[256];
+
+static uint32_t I_Crc32(const void *buf, size_t len)
+{
+	const byte *p=buf;
+	uint32_t crc=0xffffffff;
+	int i, j;
+	if (!crctab[1]) {
+		for (i=0; i<256; i++) {
+			uint32_t c=i;
+			for (j=0; j<8; j++) c=(c&1)?(c>>1)^0xedb88320:c>>1;
+			crctab[i]=c;
+		}
+	}
+	while (len--) crc=crctab[(crc^*p++)&0xff]^(crc>>8);
+	return crc^0xffffffff;
+}
+
+static void I_InitFrameSink(void)
+{
+	static const char *const names[]={"ascii", "null", "raw", "ppm", "crc"};
+	static const char *const paths[]={NULL, NULL, "frames.raw", "frame%05d.ppm", "-"};
+	int p, i;
+
+	//benchmark isn't set yet, graphics come up first
+	if (M_CheckParm("-benchmark")) framesink=SINK_NULL;
+	if ((p=M_CheckParm("-framesink")) && ++p<myargc) {
+		for (i=0; i<5 && strcasecmp(myargv[p], names[i]); i++);
+		if (i==5) I_Error("I_InitFrameSink: unknown frame sink %s", myargv[p]);
+		framesink=i;
+		sinkpath=paths[i];
+		if (++p<myargc && (*myargv[p]!='-' || !myargv[p][1])) sinkpath=myargv[p];
+	}
+
+	if (framesink==SINK_RAW || framesink==SINK_CRC) {
+		if (!strcmp(sinkpath, "-")) sinkfile=stdout;
+		else if (!(sinkfile=fopen(sinkpath, framesink==SINK_RAW?"wb":"w")))
+			I_Error("I_InitFrameSink: can't write %s", sinkpath);
+	}
+	if (framesink!=SINK_ASCII)
+		lprintf(LO_INFO, "I_InitFrameSink: %s %s\n", names[framesink], sinkpath?sinkpath:"");
+	stverify=M_CheckParm("-stverify")!=0;
+}
+
 //
-// I_FinishUpdate
+// -stverify plays the LCD with the status bar's dirty rects: a simulated
+// panel gets the rows above the status bar and the rects of each frame, or
+// the whole frame when the status bar gives none or the palette changed,
+// and has to end up showing the frame.
 //
-static int newpal = 0;
+static byte *stpanel;
+static uint16_t stpanelpal[256];
 
+static void I_VerifyStatusBar(void)
+{
+	static int frames, badframes;
+	stdirty_t rects[ST_MAXDIRTY];
+	int n=ST_GetDirtyRects(rects);
+	int bpp=V_GetPixelDepth(), pitch=screens[0].byte_pitch, rowbytes=SCREENWIDTH*bpp;
+	int i, y, rows, diffs=0, firsty=0;
+
+	if (!stverify || V_GetMode()==VID_MODEGL) return;
+	if (!stpanel) stpanel=malloc(MAX_SCREENWIDTH*MAX_SCREENHEIGHT*4);
+
+	if (V_GetMode()==VID_MODE8 && memcmp(stpanelpal, lcdpal, sizeof(lcdpal))) n=-1;
+	memcpy(stpanelpal, lcdpal, sizeof(lcdpal));
+
+	rows=n<0 ? SCREENHEIGHT : ST_SCALED_Y;
+	for (y=0; y<rows; y++)
+		memcpy(stpanel+y*rowbytes, screens[0].data+y*pitch, rowbytes);
+	for (i=0; i<n; i++)
+		for (y=rects[i].y; y<rects[i].y+rects[i].h; y++)
+			memcpy(stpanel+y*rowbytes+rects[i].x*bpp, screens[0].data+y*pitch+rects[i].x*bpp, rects[i].w*bpp);
+
+	for (y=ST_SCALED_Y; y<SCREENHEIGHT; y++)
+		if (memcmp(stpanel+y*rowbytes, screens[0].data+y*pitch, rowbytes) && !diffs++)
+			firsty=y;
+
+	frames++;
+	if (diffs) {
+		badframes++;
+		lprintf(LO_WARN, "I_VerifyStatusBar: %d status bar rows from %d missed by the "
+				"dirty rects (%d of %d frames)\n", diffs, firsty, badframes, frames);
+	} else if (!(frames%350)) {
+		lprintf(LO_INFO, "I_VerifyStatusBar: %d of %d frames differed\n", badframes, frames);
+	}
+}
+
+//
+// I_FinishUpdate
+//
 void I_FinishUpdate (void)
 {
 	int x, y;
 	char *chrs=" '.~+mM@";
-	uint16_t *scr=(uint16_t*)screens[0].data;
-#if 0
-  if (SDL_MUSTLOCK(screen)) {
-      int h;
-      byte *src;
-      byte *dest;
-
-      if (SDL_LockSurface(screen) < 0) {
-        lprintf(LO_INFO,"I_FinishUpdate: %s\n", SDL_GetError());
-        return;
-      }
-      dest=screen->pixels;
-      src=screens[0].data;
-      h=screen->h;
-      for (; h>0; h--)
-      {
-        memcpy(dest,src,SCREENWIDTH*V_GetPixelDepth());
-        dest+=screen->pitch;
-        src+=screens[0].byte_pitch;
-      }
-      SDL_UnlockSurface(screen);
-  }
-  /* Update the display buffer (flipping video pages if supported)
-   * If we need to change palette, that implicitely does a flip */
-  if (newpal != NO_PALETTE_CHANGE) {
-    I_UploadNewPalette(newpal);
-    newpal = NO_PALETTE_CHANGE;
-  }
-  SDL_Flip(screen);
-#endif
+	const byte *src=screens[0].data;
+	char name[PATH_MAX];
+	FILE *f;
+
+	I_VerifyStatusBar();
+
+	switch (framesink) {
+	case SINK_RAW:
+		for (y=0; y<SCREENHEIGHT; y++)
+			fwrite(src+y*screens[0].byte_pitch, V_GetPixelDepth(), SCREENWIDTH, sinkfile);
+		return;
+	case SINK_PPM:
+		if (V_GetMode()!=VID_MODE8) break;
+		snprintf(name, sizeof(name), sinkpath, sinkframe++);
+		if (!(f=fopen(name, "wb")))
+			I_Error("I_FinishUpdate: can't write %s", name);
+		fprintf(f, "P6\n%d %d\n255\n", SCREENWIDTH, SCREENHEIGHT);
+		for (y=0; y<SCREENHEIGHT; y++)
+			for (x=0; x<SCREENWIDTH; x++)
+				fwrite(&rgbpal[src[x+y*screens[0].byte_pitch]*3], 1, 3, f);
+		fclose(f);
+		return;
+	default:
+		break;
+	}
+
+	if (V_GetMode()==VID_MODE16) {
+		const uint16_t *src16=(const uint16_t *)src;
+		for (y=0; y<SCREENHEIGHT; y++)
+			for (x=0; x<SCREENWIDTH; x++)
+				lcdfb[x+y*SCREENWIDTH]=VID_SWAP16(src16[x+y*screens[0].short_pitch]);
+	} else {
+		//The LCD's kernel, so that crc logs check it on real frames
+		for (y=0; y<SCREENHEIGHT; y++)
+			lcd_convert_words((uint32_t *)&lcdfb[y*SCREENWIDTH],
+					(const uint32_t *)(src+y*screens[0].byte_pitch), SCREENWIDTH/4, (const int16_t *)lcdpal);
+	}
+
+	if (framesink==SINK_NULL)
+		return;
+	if (framesink==SINK_CRC) {
+		fprintf(sinkfile, "%d %08x\n", sinkframe++, I_Crc32(lcdfb, sizeof(lcdfb)));
+		return;
+	}
+	if (framesink==SINK_PPM) {
+		snprintf(name, sizeof(name), sinkpath, sinkframe++);
+		if (!(f=fopen(name, "wb")))
+			I_Error("I_FinishUpdate: can't write %s", name);
+		fprintf(f, "P6\n%d %d\n255\n", SCREENWIDTH, SCREENHEIGHT);
+		for (x=0; x<SCREENWIDTH*SCREENHEIGHT; x++) {
+			fputc((lcdfb[x]>>11)<<3, f);
+			fputc(((lcdfb[x]>>5)&0x3f)<<2, f);
+			fputc((lcdfb[x]&0x1f)<<3, f);
+		}
+		fclose(f);
+		return;
+	}
+
 	ets_printf("\033[1;1H");
-	for (y=0; y<240; y+=4) {
-		for (x=0; x<320; x+=2) {
-			ets_printf("%c", chrs[(scr[x+y*320])>>13]);
+	for (y=0; y<SCREENHEIGHT; y+=4) {
+		for (x=0; x<SCREENWIDTH; x+=2) {
+			ets_printf("%c", chrs[lcdfb[x+y*SCREENWIDTH]>>13]);
 		}
 		ets_printf("\n");
 	}
+}
+
+void I_ReadScreen (screeninfo_t *dest)
+{
+  int y;
 
+  for (y=0; y<SCREENHEIGHT; y++)
+    memcpy(dest->data+y*dest->byte_pitch, screens[0].data+y*screens[0].byte_pitch,
+           SCREENWIDTH*V_GetPixelDepth());
+}
+
+//Frame sinks write synchronously, there is nothing left to wait for.
+unsigned long I_GetScanoutUS(void)
+{
+	return 0;
 }
 
 void I_SetPalette (int pal)
 {
-  newpal = pal;
+	int i;
+	int pplump = W_GetNumForName("PLAYPAL");
+	const byte * palette = W_CacheLumpNum(pplump);
+	palette+=pal*(3*256);
+	memcpy(rgbpal, palette, sizeof(rgbpal));
+	for (i=0; i<256 ; i++) {
+		lcdpal[i]=((palette[0]>>3)<<11)+((palette[1]>>2)<<5)+(palette[2]>>3);
+		palette += 3;
+	}
+	W_UnlockLumpNum(pplump);
 }
 
 void I_PreInitGraphics(void)
@@ -194,7 +366,7 @@ void I_PreInitGraphics(void)
 // Sets the screen resolution
 void I_SetRes(void)
 {
-  int i;
+  int i, pitch = SCREENPITCH*V_GetPixelDepth();
 
 //  I_CalculateRes(SCREENWIDTH, SCREENHEIGHT);
 
@@ -202,17 +374,17 @@ void I_SetRes(void)
   for (i=0; i<3; i++) {
     screens[i].width = SCREENWIDTH;
     screens[i].height = SCREENHEIGHT;
-    screens[i].byte_pitch = SCREENPITCH;
-    screens[i].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
-    screens[i].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+    screens[i].byte_pitch = pitch;
+    screens[i].short_pitch = pitch / V_GetModePixelDepth(VID_MODE16);
+    screens[i].int_pitch = pitch / V_GetModePixelDepth(VID_MODE32);
   }
 
   // statusbar
   screens[4].width = SCREENWIDTH;
   screens[4].height = (ST_SCALED_HEIGHT+1);
-  screens[4].byte_pitch = SCREENPITCH;
-  screens[4].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
-  screens[4].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+  screens[4].byte_pitch = pitch;
+  screens[4].short_pitch = pitch / V_GetModePixelDepth(VID_MODE16);
+  screens[4].int_pitch = pitch / V_GetModePixelDepth(VID_MODE32);
 
   lprintf(LO_INFO,"I_SetRes: Using resolution %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
 }
@@ -234,10 +406,21 @@ void I_InitGraphics(void)
 
     /* Initialize the input system */
     I_InitInputs();
+
+    I_InitFrameSink();
   }
 }
 
 
+// 8 (palette lookup when sending, like the LCD task) or 16 (big-endian
+// RGB565 straight from the renderer); nothing else is wired up
+static video_mode_t I_GetModeFromString(const char *modestr)
+{
+  if (modestr && !strcmp(modestr, "16"))
+    return VID_MODE16;
+  return VID_MODE8;
+}
+
 void I_UpdateVideoMode(void)
 {
   int init_flags;
@@ -246,8 +429,9 @@ void I_UpdateVideoMode(void)
 
   lprintf(LO_INFO, "I_UpdateVideoMode: %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
 
-    mode = VID_MODE16;
-//    mode = VID_MODE8;
+  mode = I_GetModeFromString(default_videomode);
+  if ((i = M_CheckParm("-vidmode")) && ++i < myargc)
+    mode = I_GetModeFromString(myargv[i]);
 
   V_InitMode(mode);
   V_DestroyUnusedTrueColorPalettes();
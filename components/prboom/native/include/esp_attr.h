@@ -0,0 +1,2 @@
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,142 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  The LCD's palette conversion kernels (lcd_convert.h) on the host:
+ *  checks the word and pair table versions against the plain one, then
+ *  times each over an SPI chunk's worth of pixels (MEM_PER_TRANS in
+ *  spi_lcd.c, 3072 on the Oxocard's ST7789). Cycles are the host's time
+ *  stamp counter where there is one; the display task's own cycle counts
+ *  come with LCD_STATS_LOG.
+ *
+ *    make lcdbench && ./lcdbench [rounds]
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0
+#endif
+
+#include "../../prboom-esp32-compat/include/lcd_convert.h"
+
+#define CHUNK 3072              /* pixels */
+#define WORDS (CHUNK/4)
+
+static int16_t pal[256];
+static uint32_t src[WORDS];
+static uint16_t ref[CHUNK];
+static uint32_t dst[CHUNK/2];
+static uint32_t *pairs;
+
+static unsigned seed = 1;
+
+static unsigned Random(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static int Check(void)
+{
+  int words, bad = 0;
+
+  for (words = 0; words <= WORDS; words += words < 64 ? 1 : WORDS/4)
+  {
+    memset(ref, 0, sizeof(ref));
+    lcd_convert_ref(ref, src, words, pal);
+
+    memset(dst, 0, sizeof(dst));
+    lcd_convert_words(dst, src, words, pal);
+    if (memcmp(dst, ref, sizeof(ref)))
+    {
+      printf("words: %d source words differ\n", words);
+      bad = 1;
+    }
+
+    memset(dst, 0, sizeof(dst));
+    lcd_convert_pairs(dst, src, words, pairs);
+    if (memcmp(dst, ref, sizeof(ref)))
+    {
+      printf("pairs: %d source words differ\n", words);
+      bad = 1;
+    }
+  }
+  return bad;
+}
+
+static double Seconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned sink;
+
+#define BENCH(name, call) do { \
+    double t0 = Seconds(); \
+    unsigned long long c0 = CYCLES(); \
+    for (i = 0; i < rounds; i++) { call; sink += dst[i % (CHUNK/2)]; } \
+    printf("%-6s %8.1f ns per chunk  %5.2f cycles per pixel\n", name, \
+           (Seconds() - t0) * 1e9 / rounds, \
+           (double) (CYCLES() - c0) / rounds / CHUNK); \
+  } while (0)
+
+int main(int argc, char **argv)
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+  double t0;
+  int i;
+
+  for (i = 0; i < 256; i++)
+    pal[i] = Random();
+  for (i = 0; i < WORDS; i++)
+    src[i] = Random() ^ (Random() << 16);
+  pairs = malloc(LCD_PAIRS * sizeof(*pairs));
+
+  t0 = Seconds();
+  lcd_build_pairs(pairs, pal);
+  printf("pair table built in %.1f us\n", (Seconds() - t0) * 1e6);
+
+  if (Check())
+    return 1;
+  printf("word and pair kernels match the plain one\n");
+
+  BENCH("plain", lcd_convert_ref((uint16_t *) dst, src, WORDS, pal));
+  BENCH("words", lcd_convert_words(dst, src, WORDS, pal));
+  BENCH("pairs", lcd_convert_pairs(dst, src, WORDS, pairs));
+  return sink == 1;   /* keep the results alive */
+}
@@ -4,28 +4,189 @@
 #include <stdlib.h> /* exit(), atexit() */
 
 #include "p_checksum.h"
-#include "md5.h"
 #include "doomstat.h" /* players{,ingame} */
+#include "m_random.h"
+#include "p_tick.h"
+#include "p_mobj.h"
+#include "r_state.h"
+#include "i_main.h"
+#include "i_system.h"
 #include "lprintf.h"
 
+/*
+ * Per-tic digests of the game state, to check that a change to the play
+ * simulation keeps demos in sync.
+ *
+ * -checksum file writes one record per tic, -verifychecksum file replays
+ * the same demo against a recorded file and stops at the first tic that
+ * differs, naming the parts of the state that do. The file is an 8 byte
+ * header followed by records of the tic and one hash per part, all 32 bit
+ * little endian.
+ */
+
+enum {
+    CK_PLAYERS,
+    CK_MOBJS,
+    CK_SECTORS,
+    CK_RNG,
+    NUMCHECKSUMS
+};
+
+static const char *const checksumnames[NUMCHECKSUMS] = {
+    "players", "mobjs", "sectors", "rng"
+};
+
+static const char checksummagic[8] = "PRBSUMv1";
+
+#define RECORDSIZE ((1+NUMCHECKSUMS)*4)
+
 /* forward decls */
 static void p_checksum_cleanup(void);
 void checksum_gamestate(int tic);
+void checksum_verify(int tic);
 
 /* vars */
 static void p_checksum_nop(int tic){} /* do nothing */
 void (*P_Checksum)(int) = p_checksum_nop;
 
+static FILE *outfile = NULL;
+static const char *checkfile;
+static unsigned char *records;   /* -verifychecksum: the whole file */
+static int numrecords, currecord;
+
+/*
+ * FNV-1a over 32 bit words: fast, and good enough to tell states apart
+ */
+#define HASH_INIT 2166136261u
+
+static unsigned hash_word(unsigned h, unsigned w) {
+    return (h ^ w) * 16777619u;
+}
+
+static unsigned hash_words(unsigned h, const int *w, int n) {
+    while (n--)
+        h = hash_word(h, *w++);
+    return h;
+}
+
+static void checksum_parts(unsigned sum[NUMCHECKSUMS]) {
+    const thinker_t *th;
+    int i;
+    unsigned h;
+
+    /* based on "ArchivePlayers" */
+    h = HASH_INIT;
+    for (i=0 ; i<MAXPLAYERS ; i++) {
+        const player_t *p = &players[i];
+        int j;
+
+        if (!playeringame[i]) continue;
+
+        h = hash_word(h, i);
+        h = hash_word(h, p->playerstate);
+        h = hash_word(h, p->viewz);
+        h = hash_word(h, p->viewheight);
+        h = hash_word(h, p->deltaviewheight);
+        h = hash_word(h, p->bob);
+        h = hash_word(h, p->health);
+        h = hash_word(h, p->armorpoints);
+        h = hash_word(h, p->armortype);
+        h = hash_words(h, p->powers, NUMPOWERS);
+        for (j=0; j<NUMCARDS; j++)
+            h = hash_word(h, p->cards[j]);
+        h = hash_word(h, p->backpack);
+        h = hash_word(h, p->readyweapon);
+        h = hash_word(h, p->pendingweapon);
+        for (j=0; j<NUMWEAPONS; j++)
+            h = hash_word(h, p->weaponowned[j]);
+        h = hash_words(h, p->ammo, NUMAMMO);
+        h = hash_words(h, p->maxammo, NUMAMMO);
+        h = hash_word(h, p->refire);
+        h = hash_word(h, p->killcount);
+        h = hash_word(h, p->itemcount);
+        h = hash_word(h, p->secretcount);
+        h = hash_word(h, p->damagecount);
+        h = hash_word(h, p->bonuscount);
+        h = hash_word(h, p->extralight);
+        for (j=0; j<NUMPSPRITES; j++) {
+            const pspdef_t *psp = &p->psprites[j];
+            h = hash_word(h, psp->state ? psp->state - states : -1);
+            h = hash_word(h, psp->tics);
+            h = hash_word(h, psp->sx);
+            h = hash_word(h, psp->sy);
+        }
+    }
+    sum[CK_PLAYERS] = h;
+
+    /* pointers are hashed as what they point at, to be the same every run */
+    h = HASH_INIT;
+    for (th = thinkercap.next; th != &thinkercap; th = th->next) {
+        const mobj_t *mo = (const mobj_t *) th;
+
+        if (th->function != P_MobjThinker) continue;
+
+        h = hash_word(h, mo->type);
+        h = hash_word(h, mo->x);
+        h = hash_word(h, mo->y);
+        h = hash_word(h, mo->z);
+        h = hash_word(h, mo->momx);
+        h = hash_word(h, mo->momy);
+        h = hash_word(h, mo->momz);
+        h = hash_word(h, mo->angle);
+        h = hash_word(h, mo->floorz);
+        h = hash_word(h, mo->ceilingz);
+        h = hash_word(h, mo->radius);
+        h = hash_word(h, mo->height);
+        h = hash_word(h, (unsigned) mo->flags);
+        h = hash_word(h, (unsigned) (mo->flags >> 32));
+        h = hash_word(h, mo->health);
+        h = hash_word(h, mo->tics);
+        h = hash_word(h, mo->state - states);
+        h = hash_word(h, mo->movedir);
+        h = hash_word(h, mo->movecount);
+        h = hash_word(h, mo->reactiontime);
+        h = hash_word(h, mo->threshold);
+        h = hash_word(h, mo->target ? mo->target->type : -1);
+        h = hash_word(h, mo->tracer ? mo->tracer->type : -1);
+    }
+    sum[CK_MOBJS] = h;
+
+    h = HASH_INIT;
+    for (i=0; i<numsectors; i++) {
+        const sector_t *sec = &sectors[i];
+
+        h = hash_word(h, sec->floorheight);
+        h = hash_word(h, sec->ceilingheight);
+        h = hash_word(h, sec->floorpic);
+        h = hash_word(h, sec->ceilingpic);
+        h = hash_word(h, sec->lightlevel);
+        h = hash_word(h, sec->special);
+        h = hash_word(h, sec->soundtraversed);
+    }
+    sum[CK_SECTORS] = h;
+
+    h = HASH_INIT;
+    for (i=0; i<NUMPRCLASS; i++)
+        h = hash_word(h, (unsigned) rng.seed[i]);
+    h = hash_word(h, rng.rndindex);
+    h = hash_word(h, rng.prndindex);
+    sum[CK_RNG] = h;
+}
+
+static void put_word(unsigned char *p, unsigned w) {
+    p[0] = w; p[1] = w >> 8; p[2] = w >> 16; p[3] = w >> 24;
+}
+
+static unsigned get_word(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned) p[3] << 24);
+}
+
 /*
  * P_RecordChecksum
  * sets up the file and function pointers to write out checksum data
  */
-static FILE *outfile = NULL;
-static struct MD5Context md5global;
-
 void P_RecordChecksum(const char *file) {
     size_t fnsize;
-	return;
     fnsize = strlen(file);
 
     /* special case: write to stdout */
@@ -39,25 +200,61 @@ void P_RecordChecksum(const char *file) {
         }
         atexit(p_checksum_cleanup);
     }
+    fwrite(checksummagic, 1, sizeof(checksummagic), outfile);
 
-    MD5Init(&md5global);
-
+    checkfile = file;
+    numrecords = 0;
     P_Checksum = checksum_gamestate;
 }
 
+/*
+ * P_VerifyChecksum
+ * loads a file written by P_RecordChecksum to compare each tic against
+ */
+void P_VerifyChecksum(const char *file) {
+    FILE *f = fopen(file, "rb");
+    long size;
+
+    if (!f)
+        I_Error("cannot open %s for reading checksum:\n%s\n",
+                file, strerror(errno));
+    fseek(f, 0, SEEK_END);
+    size = ftell(f) - sizeof(checksummagic);
+    fseek(f, 0, SEEK_SET);
+
+    records = malloc(size > 0 ? size : 1);
+    if (size < 0 || size % RECORDSIZE ||
+        fread(records, 1, sizeof(checksummagic), f) != sizeof(checksummagic) ||
+        memcmp(records, checksummagic, sizeof(checksummagic)) ||
+        fread(records, 1, size, f) != (size_t) size)
+        I_Error("P_VerifyChecksum: %s is not a checksum file", file);
+    fclose(f);
+
+    checkfile = file;
+    numrecords = size / RECORDSIZE;
+    currecord = 0;
+    P_Checksum = checksum_verify;
+}
+
 void P_ChecksumFinal(void) {
-    int i;
-    unsigned char digest[16];
+    if (outfile) {
+        fflush(outfile);
+        lprintf(LO_INFO, "P_ChecksumFinal: %d tics written to %s\n",
+                numrecords, checkfile);
+    }
 
-    if (!outfile)
-      return;
+    if (!records)
+        return;
 
-    MD5Final(digest, &md5global);
-    fprintf(outfile, "final: ");
-    for (i=0; i<16; i++)
-        fprintf(outfile,"%x", digest[i]);
-    fprintf(outfile, "\n");
-    MD5Init(&md5global);
+    /* a verified demo is done, whatever else was going to happen */
+    if (currecord < numrecords) {
+        lprintf(LO_ERROR, "P_VerifyChecksum: demo ended at tic %d, %s goes "
+                "on to tic %u\n", gametic,
+                checkfile, get_word(records + (numrecords-1)*RECORDSIZE));
+        I_SafeExit(1);
+    }
+    lprintf(LO_INFO, "P_VerifyChecksum: %d tics match %s\n", numrecords, checkfile);
+    I_SafeExit(0);
 }
 
 static void p_checksum_cleanup(void) {
@@ -69,35 +266,52 @@ static void p_checksum_cleanup(void) {
  * runs on each tic when recording checksums
  */
 void checksum_gamestate(int tic) {
+    unsigned sum[NUMCHECKSUMS];
+    unsigned char record[RECORDSIZE];
     int i;
-    struct MD5Context md5ctx;
-    unsigned char digest[16];
-    char buffer[2048];
 
     if (!outfile)
       return;
 
-    fprintf(outfile,"%6d, ", tic);
-
-    /* based on "ArchivePlayers" */
-    MD5Init(&md5ctx);
-    for (i=0 ; i<MAXPLAYERS ; i++) {
-        if (!playeringame[i]) continue;
+    checksum_parts(sum);
+    put_word(record, tic);
+    for (i=0; i<NUMCHECKSUMS; i++)
+        put_word(record + 4 + i*4, sum[i]);
+    fwrite(record, 1, RECORDSIZE, outfile);
+    numrecords++;
+}
 
-#ifdef HAVE_SNPRINTF
-        snprintf (buffer, sizeof(buffer), "%d", players[i].health);
-#else
-        sprintf (buffer, "%d", players[i].health);
-#endif
-        buffer[sizeof(buffer)-1] = 0;
+/*
+ * runs on each tic when verifying checksums
+ */
+void checksum_verify(int tic) {
+    unsigned sum[NUMCHECKSUMS];
+    const unsigned char *record;
+    char differ[64] = "";
+    int i;
 
-        MD5Update(&md5ctx, (md5byte const *)&buffer, strlen(buffer));
+    if (currecord == numrecords) {
+        lprintf(LO_ERROR, "P_VerifyChecksum: tic %d is past the end of %s\n",
+                tic, checkfile);
+        I_SafeExit(1);
     }
-    MD5Final(digest, &md5ctx);
-    for (i=0; i<16; i++) {
-        MD5Update(&md5global, (md5byte const *)&digest[i], sizeof(digest[i]));
-        fprintf(outfile,"%x", digest[i]);
+    record = records + currecord++ * RECORDSIZE;
+    if (get_word(record) != (unsigned) tic) {
+        lprintf(LO_ERROR, "P_VerifyChecksum: tic %d, %s has tic %u\n",
+                tic, checkfile, get_word(record));
+        I_SafeExit(1);
     }
 
-    fprintf(outfile,"\n");
+    checksum_parts(sum);
+    for (i=0; i<NUMCHECKSUMS; i++)
+        if (sum[i] != get_word(record + 4 + i*4)) {
+            if (*differ)
+                strcat(differ, ", ");
+            strcat(differ, checksumnames[i]);
+        }
+    if (*differ) {
+        lprintf(LO_ERROR, "P_VerifyChecksum: tic %d differs from %s in %s\n",
+                tic, checkfile, differ);
+        I_SafeExit(1);
+    }
 }
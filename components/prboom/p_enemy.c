@@ -352,6 +352,7 @@ static boolean P_Move(mobj_t *actor, boolean dropoff) /* killough 9/12/98 */
     {
       actor->x = origx;
       actor->y = origy;
+      P_SyncBlockThing(actor);
       movefactor *= FRACUNIT / ORIG_FRICTION_FACTOR / 4;
       actor->momx += FixedMul(deltax, movefactor);
       actor->momy += FixedMul(deltay, movefactor);
@@ -1450,6 +1451,7 @@ void A_SkelMissile(mobj_t *actor)
 
   mo->x += mo->momx;
   mo->y += mo->momy;
+  P_SyncBlockThing(mo);
   P_SetTarget(&mo->tracer, actor->target);
 }
 
@@ -1681,6 +1683,7 @@ void A_VileChase(mobj_t* actor)
                     {
                       corpsehit->height = info->height; // fix Ghost bug
                       corpsehit->radius = info->radius; // fix Ghost bug
+                      P_SyncBlockThing(corpsehit);
                     }                                               // phares
 
       /* killough 7/18/98:
@@ -1815,6 +1818,7 @@ void A_VileAttack(mobj_t *actor)
   // move the fire between the vile and the player
   fire->x = actor->target->x - FixedMul (24*FRACUNIT, finecosine[an]);
   fire->y = actor->target->y - FixedMul (24*FRACUNIT, finesine[an]);
+  P_SyncBlockThing(fire);
   P_RadiusAttack(fire, actor, 70);
 }
 
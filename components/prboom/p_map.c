@@ -94,6 +94,32 @@ msecnode_t* sector_list = NULL;                             // phares 3/16/98
 // TELEPORT MOVE
 //
 
+//
+// P_BlockThingsNearIterator
+//
+// P_BlockThingsIterator for PIT_StompThing and PIT_CheckThing, which ignore
+// things whose box does not overlap tmthing's at tmx,tmy. That test is done
+// first here on the blockmap copies, so only things close enough get looked
+// at. tmthing and tmx,tmy are read for every thing, as func may change them.
+//
+
+static boolean P_BlockThingsNearIterator(int x, int y, boolean func(mobj_t*))
+{
+  int slot;
+  if (!(x<0 || y<0 || x>=bmapwidth || y>=bmapheight))
+    for (slot = blocklinks[y*bmapwidth+x]; slot; slot = blockthings[slot].next)
+      {
+        const blockthing_t *bt = &blockthings[slot];
+        fixed_t blockdist = bt->radius + tmthing->radius;
+
+        if (D_abs(bt->x - tmx) >= blockdist || D_abs(bt->y - tmy) >= blockdist)
+          continue;
+        if (!func(blockmobjs[slot]))
+          return false;
+      }
+  return true;
+}
+
 //
 // PIT_StompThing
 //
@@ -303,7 +329,7 @@ boolean P_TeleportMove (mobj_t* thing,fixed_t x,fixed_t y, boolean boss)
 
   for (bx=xl ; bx<=xh ; bx++)
     for (by=yl ; by<=yh ; by++)
-      if (!P_BlockThingsIterator(bx,by,PIT_StompThing))
+      if (!P_BlockThingsNearIterator(bx,by,PIT_StompThing))
         return false;
 
   // the move is ok,
@@ -753,7 +779,7 @@ boolean P_CheckPosition (mobj_t* thing,fixed_t x,fixed_t y)
 
   for (bx=xl ; bx<=xh ; bx++)
     for (by=yl ; by<=yh ; by++)
-      if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+      if (!P_BlockThingsNearIterator(bx,by,PIT_CheckThing))
         return false;
 
   // check lines
@@ -1884,6 +1910,7 @@ boolean PIT_ChangeSector (mobj_t* thing)
     thing->flags &= ~MF_SOLID;
     thing->height = 0;
     thing->radius = 0;
+    P_SyncBlockThing(thing);
     return true; // keep checking
     }
 
@@ -1944,6 +1971,7 @@ boolean P_ChangeSector(sector_t* sector,boolean crunch)
 
   nofit = false;
   crushchange = crunch;
+  P_InvalidateSightCache();     // heights changed, remembered sight is stale
 
   // ARRGGHHH!!!!
   // This is horrendously slow!!!
@@ -1974,6 +2002,7 @@ boolean P_CheckSector(sector_t* sector,boolean crunch)
 
   nofit = false;
   crushchange = crunch;
+  P_InvalidateSightCache();
 
   // killough 4/4/98: scan list front-to-back until empty or exhausted,
   // restarting from beginning after each thing is processed. Avoids
@@ -2270,6 +2299,7 @@ void P_MapStart(void) {
 }
 void P_MapEnd(void) {
 	tmthing = NULL;
+	P_FlushBlockThings();
 }
 
 // e6y
@@ -40,6 +40,7 @@
 #include "p_maputl.h"
 #include "p_map.h"
 #include "p_setup.h"
+#include "lprintf.h"
 
 //
 // P_AproxDistance
@@ -267,9 +268,110 @@ void P_UnsetThingPosition (mobj_t *thing)
        * linking.
        */
 
-      mobj_t *bnext, **bprev = thing->bprev;
-      if (bprev && (*bprev = bnext = thing->bnext))  // unlink from block map
-        bnext->bprev = bprev;
+      int prev = thing->blockprev;
+      if (prev)                                      // unlink from block map
+        {
+          int next = blockthings[thing->blockslot].next;
+          if (prev < 0)
+            blocklinks[-1-prev] = next;
+          else
+            blockthings[prev].next = next;
+          if (next)
+            blockmobjs[next]->blockprev = prev;
+          thing->blockprev = 0;
+        }
+    }
+}
+
+//
+// Blockmap thing slots
+//
+// Slot 0 is never used, so 0 ends a block and marks things without a slot.
+// A thing keeps its slot while it moves between blocks. When it is removed
+// the slot is only reused after the tic, since an iterator may still be
+// standing on it and go on to its next.
+//
+
+blockthing_t *blockthings;
+mobj_t **blockmobjs;
+static int numblockthings, maxblockthings, freeblockthing;
+static int *deadblockthings, numdeadblockthings, maxdeadblockthings;
+
+void P_ClearBlockThings(void)
+{
+  numblockthings = 1;
+  freeblockthing = 0;
+  numdeadblockthings = 0;
+}
+
+static int P_NewBlockThing(mobj_t *thing)
+{
+  int slot = freeblockthing;
+
+  if (slot)
+    freeblockthing = blockthings[slot].next;
+  else
+    {
+      if (numblockthings >= maxblockthings)
+        {
+          int n = maxblockthings ? maxblockthings*2 : 256;
+          blockthing_t *bt = realloc(blockthings, n * sizeof(*bt));
+          mobj_t **mobjs;
+
+          if (bt)
+            blockthings = bt;
+          mobjs = bt ? realloc(blockmobjs, n * sizeof(*mobjs)) : NULL;
+          if (!mobjs)
+            I_Error("P_NewBlockThing: no memory for %d blockmap things", n);
+          blockmobjs = mobjs;
+          maxblockthings = n;
+        }
+      slot = numblockthings++;
+    }
+  blockmobjs[slot] = thing;
+  return thing->blockslot = slot;
+}
+
+// Called after moving or resizing a linked thing without relinking it
+void P_SyncBlockThing(mobj_t *thing)
+{
+  if (thing->blockslot)
+    {
+      blockthing_t *bt = &blockthings[thing->blockslot];
+      bt->x = thing->x;
+      bt->y = thing->y;
+      bt->radius = thing->radius;
+    }
+}
+
+// P_RemoveMobj, after unlinking
+void P_FreeBlockThing(mobj_t *thing)
+{
+  if (thing->blockslot)
+    {
+      if (numdeadblockthings == maxdeadblockthings)
+        {
+          int n = maxdeadblockthings ? maxdeadblockthings*2 : 64;
+          int *dead = realloc(deadblockthings, n * sizeof(*dead));
+
+          if (!dead)
+            I_Error("P_FreeBlockThing: no memory for %d dead blockmap things", n);
+          deadblockthings = dead;
+          maxdeadblockthings = n;
+        }
+      deadblockthings[numdeadblockthings++] = thing->blockslot;
+      thing->blockslot = 0;
+    }
+}
+
+// P_MapEnd, no iterator is running
+void P_FlushBlockThings(void)
+{
+  while (numdeadblockthings)
+    {
+      int slot = deadblockthings[--numdeadblockthings];
+      blockthings[slot].next = freeblockthing;
+      freeblockthing = slot;
     }
 }
 
@@ -326,16 +428,26 @@ void P_SetThingPosition(mobj_t *thing)
         {
         // killough 8/11/98: simpler scheme using pointer-to-pointer prev
         // pointers, allows head nodes to be treated like everything else
-
-        mobj_t **link = &blocklinks[blocky*bmapwidth+blockx];
-        mobj_t *bnext = *link;
-        if ((thing->bnext = bnext))
-          bnext->bprev = &thing->bnext;
-        thing->bprev = link;
-        *link = thing;
+        // (now slots, with -1-block standing for the head)
+
+        int *link = &blocklinks[blocky*bmapwidth+blockx];
+        int slot = thing->blockslot ? thing->blockslot : P_NewBlockThing(thing);
+        blockthing_t *bt = &blockthings[slot];
+
+        bt->x = thing->x;
+        bt->y = thing->y;
+        bt->radius = thing->radius;
+        if ((bt->next = *link))
+          blockmobjs[*link]->blockprev = slot;
+        thing->blockprev = -1 - (link - blocklinks);
+        *link = slot;
       }
       else        // thing is off the map
-        thing->bnext = NULL, thing->bprev = NULL;
+        {
+          if (thing->blockslot)
+            blockthings[thing->blockslot].next = 0;
+          thing->blockprev = 0;
+        }
     }
 }
 
@@ -394,10 +506,10 @@ boolean P_BlockLinesIterator(int x, int y, boolean func(line_t*))
 
 boolean P_BlockThingsIterator(int x, int y, boolean func(mobj_t*))
 {
-  mobj_t *mobj;
+  int slot;
   if (!(x<0 || y<0 || x>=bmapwidth || y>=bmapheight))
-    for (mobj = blocklinks[y*bmapwidth+x]; mobj; mobj = mobj->bnext)
-      if (!func(mobj))
+    for (slot = blocklinks[y*bmapwidth+x]; slot; slot = blockthings[slot].next)
+      if (!func(blockmobjs[slot]))
         return false;
   return true;
 }
@@ -888,6 +888,38 @@ int        iquehead;
 int        iquetail;
 
 
+//
+// P_RelocateInfo
+// The first change to states or mobjinfo moves the table to RAM (see
+// infoEditState). If that happens during a level, the things and the
+// weapon sprites still point into the old one.
+//
+void P_RelocateInfo(const state_t *oldstates, const mobjinfo_t *oldmobjinfo)
+{
+  thinker_t *th;
+  int i, j;
+
+  if (states == oldstates && mobjinfo == oldmobjinfo)
+    return;
+
+  if (thinkercap.next)  // not before the first level
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+      if (th->function == P_MobjThinker)
+      {
+        mobj_t *mo = (mobj_t *) th;
+        mo->state = states + (mo->state - oldstates);
+        mo->info = mobjinfo + (mo->info - oldmobjinfo);
+      }
+
+  for (i = 0; i < MAXPLAYERS; i++)
+    for (j = 0; j < NUMPSPRITES; j++)
+    {
+      pspdef_t *psp = &players[i].psprites[j];
+      if (psp->state)
+        psp->state = states + (psp->state - oldstates);
+    }
+}
+
 //
 // P_RemoveMobj
 //
@@ -912,6 +944,7 @@ void P_RemoveMobj (mobj_t* mobj)
   // unlink from sector and block lists
 
   P_UnsetThingPosition (mobj);
+  P_FreeBlockThing (mobj);
 
   // Delete all nodes on the current sector_list               phares 3/16/98
 
@@ -1425,6 +1458,7 @@ void P_CheckMissileSpawn (mobj_t* th)
   th->x += (th->momx>>1);
   th->y += (th->momy>>1);
   th->z += (th->momz>>1);
+  P_SyncBlockThing(th);
 
   // killough 8/12/98: for non-missile objects (e.g. grenades)
   if (!(th->flags & MF_MISSILE) && mbf_features)
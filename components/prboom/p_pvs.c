@@ -0,0 +1,780 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Subsector potentially visible sets (-pvs).
+ *
+ *  REJECT only knows sectors, and many PWADs ship it empty. The PVS is
+ *  built per subsector by portal flow, the way Quake's vis does it, cut
+ *  down to 2D:
+ *
+ *  - Every node's partition, clipped to the node's cell, is pushed down
+ *    both subtrees. The pieces that meet along it are the boundaries
+ *    between neighbouring leaf cells.
+ *  - A leaf cell also covers the void around the subsector. Each boundary
+ *    is cut to the part inside both subsectors' segs, so what is left is
+ *    open: a two-sided line or an implicit boundary. That is a portal.
+ *  - From each subsector, lines of sight are followed through chains of
+ *    portals. Each window is clipped by the separating lines of the source
+ *    and the portal it came through.
+ *
+ *  Sector heights are ignored, so closed doors and lifts count as open.
+ *  Windows are widened a little at their ends, because P_CheckSight's
+ *  fixed point can let a line slip past a corner. The result is made
+ *  symmetric. The PVS may say too much is visible, never too little.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "doomstat.h"
+#include "r_main.h"
+#include "p_pvs.h"
+#include "i_system.h"
+#include "lprintf.h"
+
+boolean pvsenabled, pvsverify;
+const unsigned *pvsmatrix;
+int pvsrowwords;
+
+// windows are widened by this at each end, in map units
+#define PVS_SLACK     4.0f
+// segs of a subsector that are further than this outside each other's
+// lines mean a non-convex subsector, its segs are not trusted
+#define PVS_CONVEX    1.0f
+#define PVS_EPSILON   (1.0f/16)
+// portal steps from one subsector before giving up and calling
+// everything visible from it
+#define PVS_MAXSTEPS  (1<<20)
+
+typedef struct {
+  float x, y, dx, dy;             // a point on the line, unit direction
+} pvsline_t;
+
+typedef struct {
+  float x1, y1, x2, y2;
+} pvsseg_t;
+
+typedef struct {
+  pvsseg_t seg;                    // the far side is on the left
+  int from, cell;                  // subsectors on the near and far side
+} pvsportal_t;
+
+typedef struct {
+  pvsseg_t src, pass;              // window source and last portal crossed
+  int cell, next;                  // cell entered, next portal of it to try
+  unsigned *might;                 // cells the portals crossed may still see
+} pvsflow_t;
+
+typedef struct {
+  int cell;
+  float t1, t2;
+} pvspiece_t;
+
+// level data, PU_LEVEL
+static int *nodeparent;              // parent node << 1 | side, -1 at the root
+static byte *convex;                 // segs bound the subsector
+static unsigned long buildus, longestbuildus;
+
+// build only
+static pvsline_t *nodelines;
+static pvsportal_t *portals;
+static int *cellportals;             // first portal of each cell, numsubsectors+1
+static unsigned *mightsee;           // per portal, pvsrowwords each; what
+                                     // it sees once its flow is done
+static int numportals, maxportals;
+static pvspiece_t *pieces[2];
+static int numpieces[2], maxpieces[2];
+static boolean outofmemory;          // a build allocation failed
+
+// signed distance from the line, negative on the right (node front) side
+static float P_PVSDist(const pvsline_t *l, float x, float y)
+{
+  return l->dx*(y - l->y) - l->dy*(x - l->x);
+}
+
+// P_PVSDist of a line that is not normalized is only good for its sign
+static void P_PVSRawLine(pvsline_t *l, float x1, float y1, float x2, float y2)
+{
+  l->x = x1; l->y = y1;
+  l->dx = x2-x1; l->dy = y2-y1;
+}
+
+static boolean P_PVSLine(pvsline_t *l, float x1, float y1, float x2, float y2)
+{
+  float len = sqrtf((x2-x1)*(x2-x1) + (y2-y1)*(y2-y1));
+
+  if (len < PVS_EPSILON)
+    return false;
+  l->x = x1; l->y = y1;
+  l->dx = (x2-x1) / len; l->dy = (y2-y1) / len;
+  return true;
+}
+
+static void P_PVSSegLine(pvsline_t *l, const seg_t *seg)
+{
+  if (!P_PVSLine(l, seg->v1->x / 65536.f, seg->v1->y / 65536.f,
+                 seg->v2->x / 65536.f, seg->v2->y / 65536.f))
+    l->dx = l->dy = 0;             // degenerate, P_PVSDist is 0 everywhere
+}
+
+// Keeps the part of s with sign*distance <= slack, false if none is left
+static boolean P_PVSClip(pvsseg_t *s, const pvsline_t *l, float sign, float slack)
+{
+  float d1 = sign*P_PVSDist(l, s->x1, s->y1) - slack;
+  float d2 = sign*P_PVSDist(l, s->x2, s->y2) - slack;
+  float t;
+
+  if (d1 > 0 && d2 > 0)
+    return false;
+  if (d1 > 0)
+  {
+    t = d1 / (d1 - d2);
+    s->x1 += t*(s->x2 - s->x1); s->y1 += t*(s->y2 - s->y1);
+  }
+  else if (d2 > 0)
+  {
+    t = d2 / (d2 - d1);
+    s->x2 += t*(s->x1 - s->x2); s->y2 += t*(s->y1 - s->y2);
+  }
+  return true;
+}
+
+static float P_PVSLength(const pvsseg_t *s)
+{
+  return sqrtf((s->x2-s->x1)*(s->x2-s->x1) + (s->y2-s->y1)*(s->y2-s->y1));
+}
+
+// Cuts s to the part inside the segs of subsector ss
+static boolean P_PVSClipToSubsector(pvsseg_t *s, int ss)
+{
+  const seg_t *seg = segs + subsectors[ss].firstline;
+  int i;
+
+  if (!convex[ss])
+    return true;
+  for (i = subsectors[ss].numlines; i--; seg++)
+  {
+    pvsline_t l;
+
+    P_PVSSegLine(&l, seg);
+    if (!P_PVSClip(s, &l, 1, PVS_SLACK))
+      return false;
+  }
+  return true;
+}
+
+//
+// Portals
+//
+
+// Once an array can't grow, the build is given up and nothing more is added
+static void P_PVSAddPiece(int side, int cell, float t1, float t2)
+{
+  if (numpieces[side] == maxpieces[side])
+  {
+    int n = maxpieces[side] ? maxpieces[side]*2 : 64;
+    pvspiece_t *p = outofmemory ? NULL : realloc(pieces[side], n * sizeof(*p));
+
+    if (!p)
+    {
+      outofmemory = true;
+      return;
+    }
+    pieces[side] = p;
+    maxpieces[side] = n;
+  }
+  pieces[side][numpieces[side]].cell = cell;
+  pieces[side][numpieces[side]].t1 = t1;
+  pieces[side][numpieces[side]++].t2 = t2;
+}
+
+// Splits the part [t1,t2] of line l, moved off it a little to one side,
+// down the subtree and collects the leaves it borders
+static void P_PVSSplit(int side, int bspnum, const pvsline_t *l, float t1, float t2)
+{
+  while (!(bspnum & NF_SUBSECTOR))
+  {
+    const pvsline_t *n = nodelines + bspnum;
+    const node_t *bsp = nodes + bspnum;
+    float f1 = P_PVSDist(n, l->x + t1*l->dx, l->y + t1*l->dy);
+    float f2 = P_PVSDist(n, l->x + t2*l->dx, l->y + t2*l->dy);
+    float t;
+
+    if (f1 <= 0 && f2 <= 0)
+      bspnum = bsp->children[0];
+    else if (f1 >= 0 && f2 >= 0)
+      bspnum = bsp->children[1];
+    else
+    {
+      t = t1 + (t2 - t1) * f1 / (f1 - f2);
+      if (f1 < 0)
+      {
+        P_PVSSplit(side, bsp->children[0], l, t1, t);
+        bspnum = bsp->children[1];
+      }
+      else
+      {
+        P_PVSSplit(side, bsp->children[1], l, t1, t);
+        bspnum = bsp->children[0];
+      }
+      t1 = t;
+    }
+  }
+  P_PVSAddPiece(side, bspnum & ~NF_SUBSECTOR, t1, t2);
+}
+
+static void P_PVSAddPortal(const pvsseg_t *s, int cell, int to)
+{
+  if (numportals == maxportals)
+  {
+    int n = maxportals ? maxportals*2 : 256;
+    pvsportal_t *p = outofmemory ? NULL : realloc(portals, n * sizeof(*p));
+
+    if (!p)
+    {
+      outofmemory = true;
+      return;
+    }
+    portals = p;
+    maxportals = n;
+  }
+  portals[numportals].seg = *s;
+  portals[numportals].from = cell;
+  portals[numportals++].cell = to;
+  cellportals[cell]++;
+}
+
+static void P_PVSNodePortals(int node, const float *box)
+{
+  const pvsline_t *l = nodelines + node;
+  pvsseg_t s;
+  pvsline_t moved;
+  float t1, t2, reach;
+  int i, j, p;
+
+  // the partition, long enough to cross the map, clipped to the node's cell
+  reach = (box[4] - box[0]) + (box[3] - box[1]);
+  s.x1 = l->x - reach*l->dx; s.y1 = l->y - reach*l->dy;
+  s.x2 = l->x + reach*l->dx; s.y2 = l->y + reach*l->dy;
+  for (i = 0; i < 4; i++)
+  {
+    pvsline_t edge;
+
+    if (!P_PVSLine(&edge, box[2*i], box[2*i+1], box[(2*i+2)&7], box[(2*i+3)&7]))
+      continue;
+    if (!P_PVSClip(&s, &edge, 1, 0))
+      return;
+  }
+  for (p = nodeparent[node]; p >= 0; p = nodeparent[p>>1])
+    if (!P_PVSClip(&s, nodelines + (p>>1), p&1 ? -1 : 1, PVS_EPSILON))
+      return;
+
+  // parameters along l of the clipped ends, l has unit length
+  t1 = (s.x1 - l->x)*l->dx + (s.y1 - l->y)*l->dy;
+  t2 = (s.x2 - l->x)*l->dx + (s.y2 - l->y)*l->dy;
+  if (t2 - t1 < PVS_EPSILON)
+    return;
+
+  // push it down both sides, moved a hair towards each
+  numpieces[0] = numpieces[1] = 0;
+  moved = *l;
+  moved.x += l->dy*PVS_EPSILON; moved.y -= l->dx*PVS_EPSILON;
+  P_PVSSplit(0, nodes[node].children[0], &moved, t1, t2);
+  moved = *l;
+  moved.x -= l->dy*PVS_EPSILON; moved.y += l->dx*PVS_EPSILON;
+  P_PVSSplit(1, nodes[node].children[1], &moved, t1, t2);
+
+  for (i = 0; i < numpieces[0]; i++)
+    for (j = 0; j < numpieces[1]; j++)
+    {
+      const pvspiece_t *front = pieces[0] + i, *back = pieces[1] + j;
+      float lo = MAX(front->t1, back->t1), hi = MIN(front->t2, back->t2);
+
+      if (hi - lo < PVS_EPSILON)
+        continue;
+      s.x1 = l->x + lo*l->dx; s.y1 = l->y + lo*l->dy;
+      s.x2 = l->x + hi*l->dx; s.y2 = l->y + hi*l->dy;
+      if (!P_PVSClipToSubsector(&s, front->cell) ||
+          !P_PVSClipToSubsector(&s, back->cell) ||
+          P_PVSLength(&s) < PVS_EPSILON)
+        continue;
+      P_PVSAddPortal(&s, front->cell, back->cell);
+      t1 = s.x1, s.x1 = s.x2, s.x2 = t1;
+      t1 = s.y1, s.y1 = s.y2, s.y2 = t1;
+      P_PVSAddPortal(&s, back->cell, front->cell);
+    }
+}
+
+// Sorts the portals by the cell they leave, cellportals[] becomes offsets
+static boolean P_PVSSortPortals(void)
+{
+  pvsportal_t *sorted = malloc(numportals * sizeof(*sorted) + 1);
+  int *next = malloc((numsubsectors+1) * sizeof(*next));
+  int i, from, total = 0;
+
+  if (!sorted || !next)
+  {
+    free(sorted);
+    free(next);
+    return false;
+  }
+
+  for (i = 0; i < numsubsectors; i++)
+  {
+    int count = cellportals[i];
+    next[i] = cellportals[i] = total;
+    total += count;
+  }
+  cellportals[numsubsectors] = total;
+
+  for (i = 0; i < numportals; i++)
+  {
+    from = portals[i].from;
+    sorted[next[from]++] = portals[i];
+  }
+  free(portals);
+  free(next);
+  portals = sorted;
+  return true;
+}
+
+//
+// Flow
+//
+
+// Cuts target to the part that some line through src and pass reaches.
+// src and pass are widened by PVS_SLACK first.
+static boolean P_PVSClipToSeparators(const pvsseg_t *src0, const pvsseg_t *pass0,
+                                     pvsseg_t *target)
+{
+  pvsseg_t src = *src0, pass = *pass0;
+  const pvsseg_t *ends[2] = { &src, &pass };
+  pvsline_t pl, sep;
+  float ds1, ds2, ds;
+  int i, a, b;
+
+  for (i = 0; i < 2; i++)
+  {
+    pvsseg_t *s = (pvsseg_t *)ends[i];
+    float len = P_PVSLength(s), ex, ey;
+
+    if (len < PVS_EPSILON)
+      continue;
+    ex = (s->x2 - s->x1) / len * PVS_SLACK;
+    ey = (s->y2 - s->y1) / len * PVS_SLACK;
+    s->x1 -= ex; s->y1 -= ey;
+    s->x2 += ex; s->y2 += ey;
+  }
+
+  // The widening already errs on the visible side, so the tests below
+  // are exact and need no normalized lines.
+
+  // only what is beyond pass, seen from src
+  P_PVSRawLine(&pl, pass.x1, pass.y1, pass.x2, pass.y2);
+  ds1 = P_PVSDist(&pl, src.x1, src.y1);
+  ds2 = P_PVSDist(&pl, src.x2, src.y2);
+  ds = fabsf(ds1) > fabsf(ds2) ? ds1 : ds2;
+  if (ds && !P_PVSClip(target, &pl, ds > 0 ? 1 : -1, 0))
+    return false;
+
+  // lines through an end of each with src and pass on opposite sides bound
+  // what can be seen, keep the side pass is on
+  for (a = 0; a < 2; a++)
+    for (b = 0; b < 2; b++)
+    {
+      float da, db;
+
+      P_PVSRawLine(&sep, a ? src.x2 : src.x1, a ? src.y2 : src.y1,
+                   b ? pass.x2 : pass.x1, b ? pass.y2 : pass.y1);
+      da = P_PVSDist(&sep, a ? src.x1 : src.x2, a ? src.y1 : src.y2);
+      db = P_PVSDist(&sep, b ? pass.x1 : pass.x2, b ? pass.y1 : pass.y2);
+      if ((da > 0 && db < 0) || (da < 0 && db > 0))
+        if (!P_PVSClip(target, &sep, db < 0 ? 1 : -1, 0))
+          return false;
+    }
+  return true;
+}
+
+// Does q have a point in front of p (on the far side), more or less?
+static boolean P_PVSInFront(const pvsseg_t *p, const pvsseg_t *q)
+{
+  pvsline_t l;
+
+  if (!P_PVSLine(&l, p->x1, p->y1, p->x2, p->y2))
+    return true;
+  return P_PVSDist(&l, q->x1, q->y1) > -PVS_SLACK ||
+         P_PVSDist(&l, q->x2, q->y2) > -PVS_SLACK;
+}
+
+// Cells a line through portal p might reach: flood through the portals q
+// that are in front of p and have p behind them. A line crossing p meets
+// no other kind of portal, so this holds everything p's flow can find.
+static void P_PVSMightSee(int p, unsigned *might, int *queue)
+{
+  const pvsseg_t *ps = &portals[p].seg;
+  int head = 0, tail = 0, i;
+
+  might[portals[p].cell>>5] |= 1u << (portals[p].cell&31);
+  queue[tail++] = portals[p].cell;
+  while (head < tail)
+  {
+    int cell = queue[head++];
+
+    for (i = cellportals[cell]; i < cellportals[cell+1]; i++)
+    {
+      const pvsportal_t *q = portals + i;
+      pvsseg_t back = { q->seg.x2, q->seg.y2, q->seg.x1, q->seg.y1 };
+
+      if (might[q->cell>>5] & (1u << (q->cell&31)) ||
+          !P_PVSInFront(ps, &q->seg) || !P_PVSInFront(&back, ps))
+        continue;
+      might[q->cell>>5] |= 1u << (q->cell&31);
+      queue[tail++] = q->cell;
+    }
+  }
+}
+
+// might = a & b, true if that leaves a cell not yet in row
+static boolean P_PVSMore(unsigned *might, const unsigned *a, const unsigned *b,
+                         const unsigned *row)
+{
+  unsigned more = 0;
+  int i;
+
+  for (i = 0; i < pvsrowwords; i++)
+    more |= (might[i] = a[i] & b[i]) & ~row[i];
+  return more != 0;
+}
+
+// Marks what portal sp sees in row, false if it took too long
+static boolean P_PVSFlow(int sp, unsigned *row, byte *onstack, pvsflow_t *stack)
+{
+  const pvsportal_t *source = portals + sp;
+  int j, depth, steps = 0;
+  boolean done = true;
+
+  row[source->cell>>5] |= 1u << (source->cell&31);
+  onstack[source->from] = onstack[source->cell] = 1;
+
+  // everything in the neighbour sees all of its portals
+  for (j = cellportals[source->cell]; j < cellportals[source->cell+1] && done; j++)
+  {
+    const pvsportal_t *q = portals + j;
+
+    if (onstack[q->cell])
+      continue;
+    row[q->cell>>5] |= 1u << (q->cell&31);
+    if (!P_PVSMore(stack[0].might, mightsee + sp*pvsrowwords,
+                   mightsee + j*pvsrowwords, row))
+      continue;
+    stack[0].src = source->seg;
+    stack[0].pass = q->seg;
+    stack[0].cell = q->cell;
+    stack[0].next = cellportals[q->cell];
+    onstack[q->cell] = 1;
+    depth = 1;
+
+    while (depth)
+    {
+      pvsflow_t *f = stack + depth-1;
+      const pvsportal_t *p;
+      pvsseg_t target, src;
+
+      if (f->next == cellportals[f->cell+1])
+      {
+        onstack[f->cell] = 0;
+        depth--;
+        continue;
+      }
+      p = portals + f->next++;
+      if (onstack[p->cell] || !(f->might[p->cell>>5] & (1u << (p->cell&31))))
+        continue;
+      target = p->seg;
+      if (!P_PVSClipToSeparators(&f->src, &f->pass, &target))
+        continue;
+      src = f->src;
+      if (!P_PVSClipToSeparators(&target, &f->pass, &src))
+        continue;
+
+      row[p->cell>>5] |= 1u << (p->cell&31);
+      if (!P_PVSMore(stack[depth].might, f->might,
+                     mightsee + (p - portals)*pvsrowwords, row))
+        continue;
+      if (++steps > PVS_MAXSTEPS)
+      {
+        while (depth)
+          onstack[stack[--depth].cell] = 0;
+        done = false;
+        break;
+      }
+      stack[depth].src = src;
+      stack[depth].pass = target;
+      stack[depth].cell = p->cell;
+      stack[depth].next = cellportals[p->cell];
+      onstack[p->cell] = 1;
+      depth++;
+    }
+  }
+  onstack[source->from] = onstack[source->cell] = 0;
+  return done;
+}
+
+static int P_PVSCount(const unsigned *row)
+{
+  int i, n = 0;
+
+  for (i = 0; i < pvsrowwords; i++)
+    n += __builtin_popcount(row[i]);
+  return n;
+}
+
+static int *mightcount;
+
+static int P_PVSCompare(const void *a, const void *b)
+{
+  return mightcount[*(const int *)a] - mightcount[*(const int *)b];
+}
+
+//
+// P_BuildPVS
+//
+
+static void P_PVSParents(int bspnum, int parent)
+{
+  while (!(bspnum & NF_SUBSECTOR))
+  {
+    nodeparent[bspnum] = parent;
+    P_PVSParents(nodes[bspnum].children[0], bspnum<<1);
+    parent = bspnum<<1 | 1;
+    bspnum = nodes[bspnum].children[1];
+  }
+}
+
+static boolean P_PVSConvex(int ss)
+{
+  const seg_t *first = segs + subsectors[ss].firstline;
+  int i, j, n = subsectors[ss].numlines;
+
+  for (i = 0; i < n; i++)
+  {
+    pvsline_t l;
+
+    P_PVSSegLine(&l, first + i);
+    for (j = 0; j < n; j++)
+      if (P_PVSDist(&l, first[j].v1->x / 65536.f, first[j].v1->y / 65536.f) > PVS_CONVEX ||
+          P_PVSDist(&l, first[j].v2->x / 65536.f, first[j].v2->y / 65536.f) > PVS_CONVEX)
+        return false;
+  }
+  return true;
+}
+
+// Frees what the build allocates with malloc, whether it is done or gave up
+static void P_PVSFreeBuild(void)
+{
+  free(pieces[0]); free(pieces[1]);
+  pieces[0] = pieces[1] = NULL;
+  numpieces[0] = numpieces[1] = maxpieces[0] = maxpieces[1] = 0;
+  free(mightcount);
+  free(mightsee);
+  free(cellportals);
+  free(portals);
+  free(nodelines);
+  mightcount = NULL;
+  mightsee = NULL;
+  cellportals = NULL;
+  portals = NULL;
+  nodelines = NULL;
+}
+
+void P_BuildPVS(void)
+{
+  unsigned long start = I_GetTimeUS();
+  unsigned *matrix, *row, *stackmight = NULL;
+  int *queue = NULL, *order = NULL, k;
+  byte *onstack = NULL;
+  pvsflow_t *stack = NULL;
+  float box[8], minx, miny, maxx, maxy;
+  int i, j, words, visible = 0, overflows = 0;
+
+  pvsmatrix = NULL;
+  if (!pvsenabled || !numnodes)
+    return;
+
+  // the map's bounding box with room around it
+  minx = maxx = vertexes[0].x / 65536.f;
+  miny = maxy = vertexes[0].y / 65536.f;
+  for (i = 1; i < numvertexes; i++)
+  {
+    minx = MIN(minx, vertexes[i].x / 65536.f); maxx = MAX(maxx, vertexes[i].x / 65536.f);
+    miny = MIN(miny, vertexes[i].y / 65536.f); maxy = MAX(maxy, vertexes[i].y / 65536.f);
+  }
+  // clockwise, so the inside is on the right of each edge
+  box[0] = minx-64; box[1] = miny-64;
+  box[2] = minx-64; box[3] = maxy+64;
+  box[4] = maxx+64; box[5] = maxy+64;
+  box[6] = maxx+64; box[7] = miny-64;
+
+  nodeparent = Z_Malloc(numnodes * sizeof(*nodeparent), PU_LEVEL, 0);
+  convex = Z_Malloc(numsubsectors, PU_LEVEL, 0);
+  P_PVSParents(numnodes-1, -1);
+  for (i = 0; i < numsubsectors; i++)
+    convex[i] = P_PVSConvex(i);
+
+  // From here on a failed allocation only costs the level its PVS
+  outofmemory = false;
+  nodelines = malloc(numnodes * sizeof(*nodelines));
+  cellportals = calloc(numsubsectors+1, sizeof(*cellportals));
+  if (!nodelines || !cellportals)
+    goto nomem;
+  for (i = 0; i < numnodes; i++)
+    P_PVSLine(nodelines + i, nodes[i].x / 65536.f, nodes[i].y / 65536.f,
+              nodes[i].x / 65536.f + nodes[i].dx / 65536.f,
+              nodes[i].y / 65536.f + nodes[i].dy / 65536.f);
+
+  numportals = maxportals = 0;
+  for (i = 0; i < numnodes && !outofmemory; i++)
+    P_PVSNodePortals(i, box);
+  if (outofmemory || !P_PVSSortPortals())
+    goto nomem;
+
+  // (+1 so that a map without portals doesn't look like a failure)
+  words = pvsrowwords = (numsubsectors + 31) >> 5;
+  mightsee = calloc(numportals * words + 1, sizeof(*mightsee));
+  queue = malloc(numsubsectors * sizeof(*queue));
+  if (!mightsee || !queue)
+    goto nomem;
+  for (i = 0; i < numportals; i++)
+    P_PVSMightSee(i, mightsee + i*words, queue);
+
+  // Portals that might see little go first. Once a portal's flow is done,
+  // what it sees replaces what it might see, and prunes the flows of the
+  // portals that look through it later.
+  order = malloc((numportals + 1) * sizeof(*order));
+  mightcount = malloc((numportals + 1) * sizeof(*mightcount));
+  onstack = calloc(numsubsectors, 1);
+  stack = malloc(numsubsectors * sizeof(*stack));
+  stackmight = malloc((numsubsectors * words + words) * sizeof(*stackmight));
+  if (!order || !mightcount || !onstack || !stack || !stackmight)
+    goto nomem;
+  for (i = 0; i < numportals; i++)
+  {
+    order[i] = i;
+    mightcount[i] = P_PVSCount(mightsee + i*words);
+  }
+  qsort(order, numportals, sizeof(*order), P_PVSCompare);
+
+  row = stackmight + numsubsectors * words;
+  for (i = 0; i < numsubsectors; i++)
+    stack[i].might = stackmight + i*words;
+  for (i = 0; i < numportals; i++)
+  {
+    memset(row, 0, words * sizeof(*row));
+    if (P_PVSFlow(order[i], row, onstack, stack))
+      memcpy(mightsee + order[i]*words, row, words * sizeof(*row));
+    else
+      overflows++;                 // keep what it might see
+  }
+
+  // a subsector sees itself and what its portals see
+  matrix = Z_Calloc(numsubsectors * words, sizeof(*matrix), PU_LEVEL, 0);
+  for (i = 0, row = matrix; i < numsubsectors; i++, row += words)
+  {
+    row[i>>5] |= 1u << (i&31);
+    for (j = cellportals[i]; j < cellportals[i+1]; j++)
+      for (k = 0; k < words; k++)
+        row[k] |= mightsee[j*words + k];
+  }
+
+  // sight goes both ways
+  for (i = 0; i < numsubsectors; i++)
+    for (j = 0; j < i; j++)
+    {
+      unsigned *ij = matrix + i*words + (j>>5), *ji = matrix + j*words + (i>>5);
+
+      if ((*ij & (1u << (j&31))) || (*ji & (1u << (i&31))))
+      {
+        *ij |= 1u << (j&31);
+        *ji |= 1u << (i&31);
+      }
+    }
+  for (i = 0; i < numsubsectors; i++)
+    for (j = 0; j < numsubsectors; j++)
+      visible += (matrix[i*words + (j>>5)] >> (j&31)) & 1;
+  pvsmatrix = matrix;
+
+  buildus = I_GetTimeUS() - start;
+  longestbuildus = MAX(longestbuildus, buildus);
+  lprintf(LO_INFO, "P_BuildPVS: %d subsectors, %d portals, %luK, %d%% visible, "
+          "%lu ms%s\n", numsubsectors, numportals / 2,
+          (unsigned long) (numsubsectors * words * sizeof(*matrix)) >> 10,
+          (int) (100.0 * visible / ((float) numsubsectors * numsubsectors)),
+          buildus / 1000, overflows ? " (some portals given up)" : "");
+  goto done;
+
+nomem:
+  lprintf(LO_WARN, "P_BuildPVS: out of memory, playing the level without a PVS\n");
+done:
+  free(stackmight);
+  free(stack);
+  free(onstack);
+  free(order);
+  free(queue);
+  P_PVSFreeBuild();
+}
+
+//
+// Lookups
+//
+
+boolean P_PVSInside(int ss, fixed_t x, fixed_t y)
+{
+  const seg_t *seg = segs + subsectors[ss].firstline;
+  int i;
+
+  if (!convex[ss])
+    return true;
+  for (i = subsectors[ss].numlines; i--; seg++)
+  {
+    pvsline_t l;
+
+    P_PVSRawLine(&l, seg->v1->x / 65536.f, seg->v1->y / 65536.f,
+                 seg->v2->x / 65536.f, seg->v2->y / 65536.f);
+    if (P_PVSDist(&l, x / 65536.f, y / 65536.f) > 0)
+      return false;
+  }
+  return true;
+}
+
+void P_GetPVSBuildTime(unsigned long *last, unsigned long *longest)
+{
+  *last = buildus;
+  *longest = longestbuildus;
+}
@@ -34,6 +34,7 @@
 #include "doomstat.h"
 #include "r_main.h"
 #include "p_maputl.h"
+#include "p_map.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_saveg.h"
@@ -194,6 +195,7 @@ void P_UnArchiveWorld (void)
   const short  *get;
 
   PADSAVEP();                // killough 3/22/98
+  P_InvalidateSightCache();  // sector heights come from the save
 
   get = (short *) save_p;
 
@@ -497,6 +499,7 @@ void P_UnArchiveThinkers (void)
       memcpy (&(mobj->lastenemy), save_p, sizeof(void*));
       save_p += 4*sizeof(void*);
       mobj->state = states + (int) mobj->state;
+      mobj->blockslot = mobj->blockprev = 0;
 
       if (mobj->player)
         (mobj->player = &players[(int) mobj->player - 1]) -> mo = mobj;
@@ -41,8 +41,10 @@
 #include "w_wad.h"
 #include "r_main.h"
 #include "r_things.h"
+#include "m_bench.h"
 #include "p_maputl.h"
 #include "p_map.h"
+#include "p_pvs.h"
 #include "p_setup.h"
 #include "p_spec.h"
 #include "p_tick.h"
@@ -53,6 +55,7 @@
 #include "r_demo.h"
 #include "r_fps.h"
 #include "i_system.h"
+#include "m_census.h"
 //
 // MAP related Lookup tables.
 // Store VERTEXES, LINEDEFS, SIDEDEFS, etc.
@@ -140,7 +143,7 @@ long      *blockmaplump;          // was short -- killough
 
 fixed_t   bmaporgx, bmaporgy;     // origin of block map
 
-mobj_t    **blocklinks;           // for thing chains
+int       *blocklinks;            // first thing's slot in each block
 
 //
 // REJECT
@@ -1225,6 +1228,7 @@ static void P_LoadBlockMap (int lump)
 
   // clear out mobj chains - CPhipps - use calloc
   blocklinks = Z_Calloc (bmapwidth*bmapheight,sizeof(*blocklinks),PU_LEVEL,0);
+  P_ClearBlockThings();
   blockmap = blockmaplump+4;
 }
 
@@ -1526,6 +1530,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
     W_UnlockLumpNum(rejectlump);
     rejectlump = -1;
   }
+  P_InvalidateSightCache();
+  M_CensusLevel();
 
 #ifdef GL_DOOM
 // proff 11/99: clean the memory from textures etc.
@@ -1618,6 +1624,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   if (compatibility_level>=lxdoom_1_compatibility || M_CheckParm("-force_remove_slime_trails") > 0)
     P_RemoveSlimeTrails();    // killough 10/98: remove slime trails from wad
 
+  P_BuildPVS();
+
   // Note: you don't need to clear player queue slots --
   // a much simpler fix is in g_game.c -- killough 10/98
 
@@ -1665,6 +1673,7 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   // preload graphics
   if (precache)
     R_PrecacheLevel();
+  M_BenchLevel();
 
 #ifdef GL_DOOM
   if (V_GetMode() == VID_MODEGL)
@@ -1685,4 +1694,7 @@ void P_Init (void)
   P_InitSwitchList();
   P_InitPicAnims();
   R_InitSprites(sprnames);
+
+  pvsverify = M_CheckParm("-pvsverify") != 0;
+  pvsenabled = pvsverify || M_CheckParm("-pvs");
 }
@@ -36,6 +36,7 @@
 #include "p_map.h"
 #include "p_maputl.h"
 #include "p_setup.h"
+#include "p_pvs.h"
 #include "m_bbox.h"
 #include "lprintf.h"
 
@@ -55,6 +56,46 @@ typedef struct {
 
 static los_t los; // cph - made static
 
+//
+// Sight cache
+//
+// Monsters look at the same target from the same spot for many tics in a
+// row (standing still, or chasing from behind a wall), and every look is a
+// full BSP walk. The result of a walk only depends on the two eye/target
+// positions and on sector heights, so it is remembered in a small direct
+// mapped table keyed on exactly those positions. Anything that moves a
+// floor or ceiling goes through P_ChangeSector/P_CheckSector, which bump
+// sightepoch and so drop every entry at once. The key is exact, so a hit
+// returns what the walk would have, and demos stay in sync.
+//
+
+#define SIGHTCACHE 256
+
+typedef struct {
+  fixed_t x1, y1, z1;              // looker position and eye z
+  fixed_t x2, y2, z2, h2;          // target position and height
+  unsigned epoch;
+  boolean visible;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHE];
+static unsigned sightepoch = 1;
+static sightstats_t sightstats;
+
+void P_InvalidateSightCache(void)
+{
+  if (!++sightepoch)               // wrapped, entries at 0 would look valid
+  {
+    memset(sightcache, 0, sizeof(sightcache));
+    sightepoch = 1;
+  }
+}
+
+void P_GetSightStats(sightstats_t *stats)
+{
+  *stats = sightstats;
+}
+
 //
 // P_DivlineSide
 // Returns side 0 (front), 1 (back), or 2 (on).
@@ -252,26 +293,17 @@ static boolean P_CrossBSPNode(int bspnum)
 }
 
 //
-// P_CheckSight
-// Returns true
-//  if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_CheckLineOfSight
+// Everything of P_CheckSight after the REJECT and PVS lookups.
 //
-// killough 4/20/98: cleaned up, made to use new LOS struct
 
-boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+static boolean P_CheckLineOfSight(mobj_t *t1, mobj_t *t2)
 {
   const sector_t *s1 = t1->subsector->sector;
   const sector_t *s2 = t2->subsector->sector;
-  int pnum = (s1-sectors)*numsectors + (s2-sectors);
-
-  // First check for trivial rejection.
-  // Determine subsector entries in REJECT table.
-  //
-  // Check in REJECT table.
-
-  if (rejectmatrix[pnum>>3] & (1 << (pnum&7)))   // can't possibly be connected
-    return false;
+  fixed_t sightzstart;
+  sightcache_t *sc;
+  unsigned key;
 
   // killough 4/19/98: make fake floors and ceilings block monster view
 
@@ -298,11 +330,27 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
   // An unobstructed LOS is possible.
   // Now look from eyes of t1 to any part of t2.
 
+  sightzstart = t1->z + t1->height - (t1->height>>2);
+
+  key = (t1->subsector - subsectors) * 0x9e3779b1u ^
+        (t2->subsector - subsectors) * 0x85ebca6bu ^
+        ((t1->x ^ t2->y) >> FRACBITS) * 0xc2b2ae35u ^
+        ((t2->x ^ t1->y ^ sightzstart ^ t2->z) >> FRACBITS);
+  sc = &sightcache[(key ^ key >> 16) & (SIGHTCACHE-1)];
+
+  if (sc->epoch == sightepoch &&
+      sc->x1 == t1->x && sc->y1 == t1->y && sc->z1 == sightzstart &&
+      sc->x2 == t2->x && sc->y2 == t2->y && sc->z2 == t2->z &&
+      sc->h2 == t2->height)
+  {
+    sightstats.hits++;
+    return sc->visible;
+  }
+
   validcount++;
 
   los.topslope = (los.bottomslope = t2->z - (los.sightzstart =
-                                             t1->z + t1->height -
-                                             (t1->height>>2))) + t2->height;
+                                             sightzstart)) + t2->height;
   los.strace.dx = (los.t2x = t2->x) - (los.strace.x = t1->x);
   los.strace.dy = (los.t2y = t2->y) - (los.strace.y = t1->y);
 
@@ -334,5 +382,59 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
   }
 
   // the head node is the last node output
-  return P_CrossBSPNode(numnodes-1);
+  sightstats.walks++;
+  sc->x1 = t1->x; sc->y1 = t1->y; sc->z1 = sightzstart;
+  sc->x2 = t2->x; sc->y2 = t2->y; sc->z2 = t2->z; sc->h2 = t2->height;
+  sc->epoch = sightepoch;
+  return sc->visible = P_CrossBSPNode(numnodes-1);
+}
+
+//
+// P_CheckSight
+// Returns true
+//  if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+// killough 4/20/98: cleaned up, made to use new LOS struct
+
+boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+{
+  const sector_t *s1 = t1->subsector->sector;
+  const sector_t *s2 = t2->subsector->sector;
+  int pnum = (s1-sectors)*numsectors + (s2-sectors);
+
+  sightstats.calls++;
+
+  // First check for trivial rejection.
+  // Determine subsector entries in REJECT table.
+  //
+  // Check in REJECT table.
+
+  if (rejectmatrix[pnum>>3] & (1 << (pnum&7)))   // can't possibly be connected
+  {
+    sightstats.rejects++;
+    return false;
+  }
+
+  // Then the same per subsector, as long as both are where the PVS knows
+  if (pvsmatrix)
+  {
+    int ss1 = t1->subsector - subsectors, ss2 = t2->subsector - subsectors;
+
+    if (!P_PVSVisible(ss1, ss2) &&
+        P_PVSInside(ss1, t1->x, t1->y) && P_PVSInside(ss2, t2->x, t2->y))
+    {
+      sightstats.pvs++;
+      if (pvsverify && P_CheckLineOfSight(t1, t2))
+      {
+        if (!sightstats.pvsmisses++)
+          lprintf(LO_WARN, "P_CheckSight: PVS hides subsector %d from %d, "
+                  "but there is a line of sight\n", ss2, ss1);
+        return true;
+      }
+      return false;
+    }
+  }
+
+  return P_CheckLineOfSight(t1, t2);
 }
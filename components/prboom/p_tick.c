@@ -37,10 +37,12 @@
 #include "p_tick.h"
 #include "p_map.h"
 #include "r_fps.h"
+#include "m_argv.h"
 
 int leveltime;
 
 static boolean newthinkerpresent;
+static boolean thinkbatch;    // -thinkbatch, see P_RunThinkers
 
 //
 // THINKERS
@@ -66,6 +68,8 @@ void P_InitThinkers(void)
     thinkerclasscap[i].cprev = thinkerclasscap[i].cnext = &thinkerclasscap[i];
 
   thinkercap.prev = thinkercap.next  = &thinkercap;
+
+  thinkbatch = M_CheckParm("-thinkbatch") != 0;
 }
 
 //
@@ -140,6 +144,7 @@ static thinker_t *currentthinker;
 // If this thinker has no more pointers referencing it indirectly,
 // remove it, and set currentthinker to one node preceeding it, so
 // that the next step in P_RunThinkers() will get its successor.
+// With -thinkbatch it is only called once the list has been walked.
 //
 
 void P_RemoveThinkerDelayed(thinker_t *thinker)
@@ -237,9 +242,51 @@ void P_SetTarget(mobj_t **mop, mobj_t *targ)
 // Rewritten to delete nodes implicitly, by making currentthinker
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
+// -thinkbatch walks the list without currentthinker, for timing on the
+// board, where an indirect call per thing may cost more than natively.
+// The list still runs in order (movers crush things, lights and things
+// share the random number stream), but runs of things, which spawn
+// together and make up most of it, call P_MobjThinker directly from a
+// loop of their own. Deleted nodes are skipped and freed from th_delete
+// once the whole list ran, so nothing is unlinked under the iterator.
+//
+
+static void P_RunThinkersBatched (void)
+{
+  thinker_t *th, *next;
+
+  for (th = thinkercap.next; th != &thinkercap; th = th->next)
+  {
+    if (newthinkerpresent)
+      R_ActivateThinkerInterpolations(th);
+
+    if (th->function == P_MobjThinker && !newthinkerpresent)
+    {
+      do
+        P_MobjThinker((mobj_t *) th);
+      while ((th = th->next)->function == P_MobjThinker && !newthinkerpresent);
+      th = th->prev;
+    }
+    else if (th->function && th->function != P_RemoveThinkerDelayed)
+      th->function(th);
+  }
+  newthinkerpresent = false;
+
+  for (th = thinkerclasscap[th_delete].cnext; th != &thinkerclasscap[th_delete]; th = next)
+  {
+    next = th->cnext;
+    P_RemoveThinkerDelayed(th);
+  }
+}
 
 static void P_RunThinkers (void)
 {
+  if (thinkbatch)
+  {
+    P_RunThinkersBatched();
+    return;
+  }
+
   for (currentthinker = thinkercap.next;
        currentthinker != &thinkercap;
        currentthinker = currentthinker->next)
@@ -41,19 +41,19 @@
 #include "v_video.h"
 #include "lprintf.h"
 
-seg_t     *curline;
-side_t    *sidedef;
-line_t    *linedef;
-sector_t  *frontsector;
-sector_t  *backsector;
-drawseg_t *ds_p;
+THREADLOCAL seg_t     *curline;
+THREADLOCAL side_t    *sidedef;
+THREADLOCAL line_t    *linedef;
+THREADLOCAL sector_t  *frontsector;
+THREADLOCAL sector_t  *backsector;
+THREADLOCAL drawseg_t *ds_p;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
 // cph - replaced by linedef rendering flags - int      doorclosed;
 
 // killough: New code which removes 2s linedef limit
-drawseg_t *drawsegs;
-unsigned  maxdrawsegs;
+THREADLOCAL drawseg_t *drawsegs;
+THREADLOCAL unsigned  maxdrawsegs;
 // drawseg_t drawsegs[MAXDRAWSEGS];       // old code -- killough
 
 //
@@ -69,7 +69,18 @@ void R_ClearDrawSegs(void)
 // Instead of clipsegs, let's try using an array with one entry for each column,
 // indicating whether it's blocked by a solid wall yet or not.
 
-byte solidcol[MAX_SCREENWIDTH];
+// The main thread uses the static array, other render threads get their
+// own from R_InitBspThreadState.
+
+static byte main_solidcol[MAX_SCREENWIDTH];
+THREADLOCAL byte *solidcol = main_solidcol;
+
+void R_InitBspThreadState(void)
+{
+  solidcol = malloc(MAX_SCREENWIDTH);
+  if (!solidcol)
+    I_Error("R_InitBspThreadState: no memory for the solid column array");
+}
 
 // CPhipps -
 // R_ClipWallSegment
@@ -111,10 +122,13 @@ void R_ClearClipSegs (void)
 //
 // cph - converted to R_RecalcLineFlags. This recalculates all the flags for
 // a line, including closure and texture tiling.
+//
+// The flags are returned rather than built up in linedef->r_flags, since
+// another render thread may be reading them at the same time.
 
-static void R_RecalcLineFlags(void)
+static int R_RecalcLineFlags(void)
 {
-  linedef->r_validcount = gametic;
+  int flags;
 
   /* First decide if the line is closed, normal, or invisible */
   if (!(linedef->flags & ML_TWOSIDED)
@@ -136,7 +150,7 @@ static void R_RecalcLineFlags(void)
         frontsector->ceilingpic!=skyflatnum)
     )
       )
-    linedef->r_flags = RF_CLOSED;
+    flags = RF_CLOSED;
   else {
     // Reject empty lines used for triggers
     //  and special events.
@@ -153,13 +167,13 @@ static void R_RecalcLineFlags(void)
       sizeof(frontsector->ceilingpic) + sizeof(frontsector->floorpic) +
       sizeof(frontsector->lightlevel) + sizeof(frontsector->floorlightsec) +
       sizeof(frontsector->ceilinglightsec))) {
-      linedef->r_flags = 0; return;
+      return 0;
     } else
-      linedef->r_flags = RF_IGNORE;
+      flags = RF_IGNORE;
   }
 
   /* cph - I'm too lazy to try and work with offsets in this */
-  if (curline->sidedef->rowoffset) return;
+  if (curline->sidedef->rowoffset) return flags;
 
   /* Now decide on texture tiling */
   if (linedef->flags & ML_TWOSIDED) {
@@ -168,19 +182,20 @@ static void R_RecalcLineFlags(void)
     /* Does top texture need tiling */
     if ((c = frontsector->ceilingheight - backsector->ceilingheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->toptexture]] > c))
-      linedef->r_flags |= RF_TOP_TILE;
+      flags |= RF_TOP_TILE;
 
     /* Does bottom texture need tiling */
     if ((c = frontsector->floorheight - backsector->floorheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->bottomtexture]] > c))
-      linedef->r_flags |= RF_BOT_TILE;
+      flags |= RF_BOT_TILE;
   } else {
     int c;
     /* Does middle texture need tiling */
     if ((c = frontsector->ceilingheight - frontsector->floorheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->midtexture]] > c))
-      linedef->r_flags |= RF_MID_TILE;
+      flags |= RF_MID_TILE;
   }
+  return flags;
 }
 
 //
@@ -300,7 +315,7 @@ static void R_AddLine (seg_t *line)
   angle_t  angle2;
   angle_t  span;
   angle_t  tspan;
-  static sector_t tempsec;     // killough 3/8/98: ceiling/water hack
+  static THREADLOCAL sector_t tempsec; // killough 3/8/98: ceiling/water hack
 
   curline = line;
 
@@ -397,8 +412,12 @@ static void R_AddLine (seg_t *line)
     backsector = R_FakeFlat(backsector, &tempsec, NULL, NULL, true);
 
   /* cph - roll up linedef properties in flags */
-  if ((linedef = curline->linedef)->r_validcount != gametic)
-    R_RecalcLineFlags();
+  if ((linedef = curline->linedef)->r_validcount != gametic) {
+    linedef->r_flags = R_RecalcLineFlags();
+    /* publish the flags before the tic that marks them valid */
+    __sync_synchronize();
+    linedef->r_validcount = gametic;
+  }
 
   if (linedef->r_flags & RF_IGNORE)
   {
@@ -656,6 +675,8 @@ void R_RenderBSPNode(int bspnum)
     {
       const node_t *bsp = &nodes[bspnum];
 
+      rendered_nodes++;
+
       // Decide which side the view point is on.
       int side = R_PointOnSide(viewx, viewy, bsp);
       // Recursively divide front space.
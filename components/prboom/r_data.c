@@ -105,7 +105,7 @@ const byte *R_GetTextureColumn(const rpatch_t *texpatch, int col) {
     col += texpatch->width;
   col &= texpatch->widthmask;
   
-  return texpatch->columns[col].pixels;
+  return R_ColumnPixels(&texpatch->columns[col]);
 }
 
 //
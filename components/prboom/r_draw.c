@@ -43,6 +43,7 @@
 #include "g_game.h"
 #include "am_map.h"
 #include "lprintf.h"
+#include "esp_attr.h"
 
 //
 // All drawing to the view buffer is accomplished in this file.
@@ -66,7 +67,7 @@ int  viewwindowy;
 //
 
 // CPhipps - made const*'s
-const byte *tranmap;          // translucency filter maps 256x256   // phares
+THREADLOCAL const byte *tranmap; // translucency filter maps 256x256   // phares
 const byte *main_tranmap;     // killough 4/11/98
 
 //
@@ -85,17 +86,22 @@ typedef enum
    COL_FLEXADD
 } columntype_e;
 
-static int    temp_x = 0;
-static int    tempyl[4], tempyh[4];
-static byte           byte_tempbuf[MAX_SCREENHEIGHT * 4];
-static unsigned short short_tempbuf[MAX_SCREENHEIGHT * 4];
-static unsigned int   int_tempbuf[MAX_SCREENHEIGHT * 4];
-static int    startx = 0;
-static int    temptype = COL_NONE;
-static int    commontop, commonbot;
-static const byte *temptranmap = NULL;
+// The column buffer is per render thread. The main thread uses the static
+// buffers; other render threads get theirs from R_InitDrawThreadState.
+static THREADLOCAL int    temp_x = 0;
+static THREADLOCAL int    tempyl[4], tempyh[4];
+static byte           main_byte_tempbuf[MAX_SCREENHEIGHT * 4];
+static unsigned short main_short_tempbuf[MAX_SCREENHEIGHT * 4];
+static unsigned int   main_int_tempbuf[MAX_SCREENHEIGHT * 4];
+static THREADLOCAL byte           *byte_tempbuf = main_byte_tempbuf;
+static THREADLOCAL unsigned short *short_tempbuf = main_short_tempbuf;
+static THREADLOCAL unsigned int   *int_tempbuf = main_int_tempbuf;
+static THREADLOCAL int    startx = 0;
+static THREADLOCAL int    temptype = COL_NONE;
+static THREADLOCAL int    commontop, commonbot;
+static THREADLOCAL const byte *temptranmap = NULL;
 // SoM 7-28-04: Fix the fuzz problem.
-static const byte   *tempfuzzmap;
+static THREADLOCAL const byte   *tempfuzzmap;
 
 //
 // Spectre/Invisibility.
@@ -118,7 +124,7 @@ static const int fuzzoffset_org[FUZZTABLE] = {
 
 static int fuzzoffset[FUZZTABLE];
 
-static int fuzzpos = 0;
+static THREADLOCAL int fuzzpos = 0;
 
 // render pipelines
 #define RDC_STANDARD      1
@@ -173,9 +179,9 @@ static void R_QuadFlushError(void)
    I_Error("R_FlushQuadColumn called without being initialized.\n");
 }
 
-static void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
-static void (*R_FlushHTColumns)(void)    = R_FlushHTError;
-static void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
+static THREADLOCAL void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
+static THREADLOCAL void (*R_FlushHTColumns)(void)    = R_FlushHTError;
+static THREADLOCAL void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
 
 static void R_FlushColumns(void)
 {
@@ -189,6 +195,19 @@ static void R_FlushColumns(void)
    temp_x = 0;
 }
 
+//
+// R_InitDrawThreadState
+// Once in every render thread other than the main one.
+//
+void R_InitDrawThreadState(void)
+{
+  byte_tempbuf = malloc(MAX_SCREENHEIGHT * 4 * sizeof(*byte_tempbuf));
+  short_tempbuf = malloc(MAX_SCREENHEIGHT * 4 * sizeof(*short_tempbuf));
+  int_tempbuf = malloc(MAX_SCREENHEIGHT * 4 * sizeof(*int_tempbuf));
+  if (!byte_tempbuf || !short_tempbuf || !int_tempbuf)
+    I_Error("R_InitDrawThreadState: no memory for the column buffers");
+}
+
 //
 // R_ResetColumnBuffer
 //
@@ -673,6 +692,56 @@ R_DrawColumn_f R_GetDrawColumnFunc(enum column_pipeline_e type,
   return result;
 }
 
+//
+// R_DrawSpriteRuns8
+//
+// The sprite fast path (see R_DrawVisSprite): no column buffer, no edge
+// slopes, no texture height wrapping; R_DrawVisSprite only hands over runs
+// that stay inside the patch. Same pixels as the column functions.
+//
+void IRAM_ATTR R_DrawSpriteRuns8(int x, const spriterun_t *runs, int numruns,
+                                 fixed_t fracstep, const lighttable_t *colormap,
+                                 const byte *translation, const byte *tranmap)
+{
+  const int pitch = drawvars.byte_pitch;
+  byte *const column = drawvars.byte_topleft + x;
+
+  for (; numruns > 0; numruns--, runs++)
+  {
+    const byte *source = runs->source;
+    byte *dest = column + runs->yl*pitch;
+    fixed_t frac = runs->frac;
+    int count = runs->count;
+
+    if (tranmap)
+      while (count--)
+      {
+        *dest = tranmap[(*dest<<8) + colormap[source[frac>>FRACBITS]]];
+        dest += pitch;
+        frac += fracstep;
+      }
+    else if (translation)
+      while (count--)
+      {
+        *dest = colormap[translation[source[frac>>FRACBITS]]];
+        dest += pitch;
+        frac += fracstep;
+      }
+    else
+    {
+      while ((count -= 2) >= 0)
+      {
+        dest[0] = colormap[source[frac>>FRACBITS]];
+        dest[pitch] = colormap[source[(frac+fracstep)>>FRACBITS]];
+        dest += pitch*2;
+        frac += fracstep*2;
+      }
+      if (count & 1)
+        *dest = colormap[source[frac>>FRACBITS]];
+    }
+  }
+}
+
 void R_SetDefaultDrawColumnVars(draw_column_vars_t *dcvars) {
   dcvars->x = dcvars->yl = dcvars->yh = dcvars->z = 0;
   dcvars->iscale = dcvars->texturemid = dcvars->texheight = dcvars->texu = 0;
@@ -121,6 +121,10 @@ static void R_DRAWCOLUMN_FUNCNAME(draw_column_vars_t *dcvars)
   const fixed_t    slope_texu = dcvars->texu;
 #endif
 
+  // split-frame rendering: other threads own the columns outside our strip
+  if (dcvars->x < r_stripx1 || dcvars->x > r_stripx2)
+    return;
+
   // drop back to point filtering if we're minifying
 #if (R_DRAWCOLUMN_PIPELINE & (RDC_BILINEAR|RDC_ROUNDED))
   if (dcvars->iscale > drawvars.mag_threshold) {
@@ -58,6 +58,9 @@
 #include "g_game.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "m_argv.h"
+#include "m_bench.h"
+#include "m_census.h"
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048
@@ -182,8 +185,8 @@ PUREFUNC int R_PointOnSegSide(fixed_t x, fixed_t y, const seg_t *line)
 
 angle_t R_PointToAngle(fixed_t x, fixed_t y)
 {
-  static fixed_t oldx, oldy;
-  static angle_t oldresult;
+  static THREADLOCAL fixed_t oldx, oldy;
+  static THREADLOCAL angle_t oldresult;
 
   x -= viewx; y -= viewy;
 
@@ -452,6 +455,23 @@ void R_Init (void)
   R_InitTranslationTables();
   lprintf(LO_INFO, "R_InitPatches ");
   R_InitPatches();
+
+  {
+    int p;
+
+    r_numthreads = I_RenderThreads();
+    if ((p = M_CheckParm("-rthreads")) && p < myargc-1)
+      r_numthreads = atoi(myargv[p+1]);
+    if (r_numthreads < 1)
+      r_numthreads = 1;
+    if (r_numthreads > MAXRENDERTHREADS)
+      r_numthreads = MAXRENDERTHREADS;
+    r_verifysplit = M_CheckParm("-rverify") != 0;
+    r_spriteruns = !M_CheckParm("-nospriteruns");
+    r_spriteorder = !M_CheckParm("-nospriteorder");
+    if (r_numthreads > 1)
+      lprintf(LO_INFO, "\nR_Init: %d render threads", r_numthreads);
+  }
 }
 
 //
@@ -532,7 +552,28 @@ int autodetect_hom = 0;       // killough 2/7/98: HOM autodetection flag
 //
 // R_ShowStats
 //
-int rendered_visplanes, rendered_segs, rendered_vissprites;
+THREADLOCAL int rendered_visplanes, rendered_segs, rendered_vissprites;
+THREADLOCAL int rendered_nodes;
+static unsigned long bspnodes, bspframes;
+static unsigned long maskedpixels, runpixels;
+static sortstats_t sortstats;
+
+void R_GetBspStats(unsigned long *nodes, unsigned long *frames)
+{
+  *nodes = bspnodes;
+  *frames = bspframes;
+}
+
+void R_GetMaskedStats(unsigned long *pixels, unsigned long *runs)
+{
+  *pixels = maskedpixels;
+  *runs = runpixels;
+}
+
+void R_GetSortStats(sortstats_t *stats)
+{
+  *stats = sortstats;
+}
 boolean rendering_stats=1;
 
 static void R_ShowStats(void)
@@ -573,11 +614,40 @@ static void R_ShowStats(void)
 }
 
 //
-// R_RenderView
+// Split-frame rendering
 //
-void R_RenderPlayerView (player_t* player)
+// With more than one render thread the view is cut into vertical strips, one
+// per thread. Every thread walks the whole BSP and does all the clipping
+// (solidcol, drawsegs, visplanes, vissprites) in its own copy of the renderer
+// state, so wall pieces, spans and sprites are set up exactly as in a
+// single-threaded render, but only draws the columns of its own strip. The
+// composed frame is therefore byte-identical to the single-threaded one,
+// which -rverify checks every frame. The one exception is fuzz: fuzzpos
+// carries on from one fuzz pixel to the next in drawing order, and each
+// strip keeps its own.
+//
+
+int r_numthreads = 1;
+boolean r_verifysplit;
+THREADLOCAL int r_stripx1 = 0, r_stripx2 = INT_MAX;
+
+static int r_numslices; // strips in the frame being rendered
+
+static void R_RenderSlice(int slice)
 {
-  R_SetupFrame (player);
+  static THREADLOCAL boolean threadinit;
+
+  // the main thread (slice 0) renders into the static state
+  if (slice && !threadinit)
+  {
+    R_InitBspThreadState();
+    R_InitPlaneThreadState();
+    R_InitDrawThreadState();
+    threadinit = true;
+  }
+
+  r_stripx1 = viewwidth * slice / r_numslices;
+  r_stripx2 = viewwidth * (slice+1) / r_numslices - 1;
 
   // Clear buffers.
   R_ClearClipSegs ();
@@ -585,7 +655,125 @@ void R_RenderPlayerView (player_t* player)
   R_ClearPlanes ();
   R_ClearSprites ();
 
-  rendered_segs = rendered_visplanes = 0;
+  rendered_segs = rendered_visplanes = rendered_nodes = 0;
+  rendered_maskedpixels = rendered_runpixels = 0;
+
+  // The head node is the last node output.
+  // -benchmark times the main thread's slice
+  if (!slice) M_BenchBegin(BENCH_BSP);
+  R_RenderBSPNode (numnodes-1);
+  R_ResetColumnBuffer();
+  if (!slice) M_BenchEnd(BENCH_BSP);
+
+  if (!slice) M_BenchBegin(BENCH_PLANES);
+  if (V_GetMode() != VID_MODEGL)
+    R_DrawPlanes ();
+  if (!slice) M_BenchEnd(BENCH_PLANES);
+
+  if (!slice) M_BenchBegin(BENCH_MASKED);
+  if (V_GetMode() != VID_MODEGL) {
+    R_DrawMasked ();
+    R_ResetColumnBuffer();
+  }
+  if (!slice) M_BenchEnd(BENCH_MASKED);
+
+  // the main thread's strip counts for the stats
+  if (!slice) {
+    bspnodes += rendered_nodes;
+    bspframes++;
+    maskedpixels += rendered_maskedpixels;
+    runpixels += rendered_runpixels;
+    if (V_GetMode() != VID_MODEGL) {
+      sortstats.frames++;
+      sortstats.sprites += rendered_sortsprites;
+      sortstats.moves += rendered_sortmoves;
+      sortstats.fullsorts += rendered_fullsorts;
+      sortstats.us += rendered_sortus;
+    }
+  }
+
+  r_stripx1 = 0;
+  r_stripx2 = INT_MAX;
+}
+
+static void R_RenderSplit(int slices)
+{
+  r_numslices = slices;
+  if (slices > 1)
+    I_RunRenderThreads(slices, R_RenderSlice);
+  else
+    R_RenderSlice(0);
+}
+
+//
+// R_VerifySplit
+// Renders the frame again single-threaded and compares it with the split
+// render. Leaves the single-threaded frame on screen.
+//
+
+static void R_CopyView(byte *dest, const byte *src, int destpitch, int srcpitch)
+{
+  int y, bytes = viewwidth * V_GetPixelDepth();
+
+  for (y = 0; y < viewheight; y++)
+    memcpy(dest + y*destpitch, src + y*srcpitch, bytes);
+}
+
+static void R_VerifySplit(void)
+{
+  static byte *before, *split;
+  static int frames, badframes;
+  byte *view = drawvars.byte_topleft;
+  int pitch = drawvars.byte_pitch, rowbytes = viewwidth * V_GetPixelDepth();
+  int x, y, diffs = 0, firstx = 0, firsty = 0;
+
+  if (!before)
+  {
+    before = malloc(MAX_SCREENWIDTH * MAX_SCREENHEIGHT * 4);
+    split = malloc(MAX_SCREENWIDTH * MAX_SCREENHEIGHT * 4);
+    if (!before || !split)
+      I_Error("R_VerifySplit: no memory for the comparison screens");
+  }
+
+  if (V_GetMode() == VID_MODEGL)
+    return;
+
+  // Both renders start from the same screen, with fresh validcounts so
+  // neither skips the sprites of sectors the other has already projected
+  R_CopyView(before, view, rowbytes, pitch);
+  validcount++;
+  R_RenderSplit(r_numthreads);
+  R_CopyView(split, view, rowbytes, pitch);
+
+  R_CopyView(view, before, pitch, rowbytes);
+  validcount++;
+  R_RenderSplit(1);
+
+  for (y = 0; y < viewheight; y++)
+    for (x = 0; x < rowbytes; x++)
+      if (view[y*pitch + x] != split[y*rowbytes + x] && !diffs++)
+        firstx = x / V_GetPixelDepth(), firsty = y;
+
+  frames++;
+  if (diffs)
+  {
+    badframes++;
+    lprintf(LO_WARN, "R_VerifySplit: %d render threads differ from one in "
+            "%d bytes, first at %d,%d (%d of %d frames)\n", r_numthreads,
+            diffs, firstx, firsty, badframes, frames);
+  }
+  else if (!(frames % 350))
+    lprintf(LO_INFO, "R_VerifySplit: %d of %d frames differed\n",
+            badframes, frames);
+}
+
+//
+// R_RenderView
+//
+void R_RenderPlayerView (player_t* player)
+{
+  R_SetupFrame (player);
+
   if (V_GetMode() == VID_MODEGL)
   {
 #ifdef GL_DOOM
@@ -608,27 +796,10 @@ void R_RenderPlayerView (player_t* player)
   NetUpdate ();
 #endif
 
-  // The head node is the last node output.
-  R_RenderBSPNode (numnodes-1);
-  R_ResetColumnBuffer();
-
-  // Check for new console commands.
-#ifdef HAVE_NET
-  NetUpdate ();
-#endif
-
-  if (V_GetMode() != VID_MODEGL)
-    R_DrawPlanes ();
-
-  // Check for new console commands.
-#ifdef HAVE_NET
-  NetUpdate ();
-#endif
-
-  if (V_GetMode() != VID_MODEGL) {
-    R_DrawMasked ();
-    R_ResetColumnBuffer();
-  }
+  if (r_verifysplit && r_numthreads > 1)
+    R_VerifySplit();
+  else
+    R_RenderSplit(V_GetMode() == VID_MODEGL ? 1 : r_numthreads);
 
   // Check for new console commands.
 #ifdef HAVE_NET
@@ -644,7 +815,7 @@ void R_RenderPlayerView (player_t* player)
 #endif
   }
 
-  if (rendering_stats) R_ShowStats();
+  if (rendering_stats && !censusoverlay) R_ShowStats();
 
   R_RestoreInterpolations();
 }
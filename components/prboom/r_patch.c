@@ -40,7 +40,10 @@
 #include "r_draw.h"
 #include "lprintf.h"
 #include "r_patch.h"
+#include "m_argv.h"
+#include "md5.h"
 #include <assert.h>
+#include <errno.h>
 
 
 // posts are runs of non masked source pixels
@@ -76,6 +79,123 @@ static rpatch_t *patches = 0;
 
 static rpatch_t *texture_composites = 0;
 
+//---------------------------------------------------------------------------
+// Pre-baked patches
+//
+// -bakepatches writes every patch and composite texture, converted as
+// below, to a blob that later runs map and use in place (from flash on the
+// device) instead of converting them again. Column data only holds offsets,
+// so the blob works at any address. A hash of the WAD directories and
+// texture definitions ties it to the WADs it was made from.
+//---------------------------------------------------------------------------
+
+#define BAKED_MAGIC "RPB1"
+
+typedef struct {
+  char magic[4];
+  unsigned char hash[16];
+  int numpatches;             // then numlumps patch entries
+  int numcomposites;          // and numtextures composite ones
+} bakedheader_t;
+
+typedef struct {
+  int offset, size;           // in the blob, 0 size if not baked
+} bakedentry_t;
+
+// the start of each entry, followed by the pixels, columns and posts
+typedef struct {
+  int width, height;
+  int leftoffset, topoffset;
+  unsigned widthmask;
+  int isNotTileable;
+  int columns, posts;         // offsets from the pixels
+} bakedpatch_t;
+
+static int bakedfd = -1;
+static bakedentry_t *baked;   // patches, then composites
+
+#define IS_BAKED(index) (baked && baked[index].size)
+
+static void R_BakedHash(unsigned char digest[16])
+{
+  static const char *const deflumps[] = { "PNAMES", "TEXTURE1", "TEXTURE2" };
+  struct MD5Context md5;
+  int i;
+
+  MD5Init(&md5);
+  for (i = 0; i < numlumps; i++)
+  {
+    MD5Update(&md5, (const md5byte *)lumpinfo[i].name, 8);
+    MD5Update(&md5, (const md5byte *)&lumpinfo[i].size, sizeof(lumpinfo[i].size));
+    MD5Update(&md5, (const md5byte *)&lumpinfo[i].position, sizeof(lumpinfo[i].position));
+  }
+  for (i = 0; i < 3; i++)
+  {
+    int lump = W_CheckNumForName(deflumps[i]);
+
+    if (lump != -1)
+    {
+      MD5Update(&md5, W_CacheLumpNum(lump), W_LumpLength(lump));
+      W_UnlockLumpNum(lump);
+    }
+  }
+  MD5Final(digest, &md5);
+}
+
+static void R_InitBakedPatches(void)
+{
+  bakedheader_t header;
+  unsigned char hash[16];
+  int fd;
+
+  if (M_CheckParm("-bakepatches") || (fd = I_Open("rpatch.bin", 0)) < 0)
+    return;
+
+  I_Lseek(fd, 0, SEEK_SET);
+  I_Read(fd, &header, sizeof(header));
+  R_BakedHash(hash);
+  if (memcmp(header.magic, BAKED_MAGIC, 4) || header.numpatches != numlumps ||
+      header.numcomposites != numtextures || memcmp(header.hash, hash, 16))
+  {
+    lprintf(LO_WARN, "(rpatch.bin doesn't match the WADs, not using it) ");
+    I_Close(fd);
+    return;
+  }
+
+  baked = malloc((numlumps + numtextures) * sizeof(*baked));
+  if (!baked)
+    I_Error("R_InitBakedPatches: no memory for %d baked entries", numlumps + numtextures);
+  I_Lseek(fd, sizeof(header), SEEK_SET);
+  I_Read(fd, baked, (numlumps + numtextures) * sizeof(*baked));
+  bakedfd = fd;
+  lprintf(LO_INFO, "(pre-baked) ");
+}
+
+// Maps a baked patch or composite in for as long as it's locked
+static void mapBakedPatch(rpatch_t *patch, int index)
+{
+  const bakedpatch_t *bp = I_Mmap(NULL, baked[index].size, 0, 0, bakedfd, baked[index].offset);
+
+  if (!bp)
+    I_Error("mapBakedPatch: can't map entry %d", index);
+  patch->width = bp->width;
+  patch->height = bp->height;
+  patch->leftoffset = bp->leftoffset;
+  patch->topoffset = bp->topoffset;
+  patch->widthmask = bp->widthmask;
+  patch->isNotTileable = bp->isNotTileable;
+  patch->data = (unsigned char *)(bp + 1);
+  patch->pixels = patch->data;
+  patch->columns = (rcolumn_t *)(patch->data + bp->columns);
+  patch->posts = (rpost_t *)(patch->data + bp->posts);
+}
+
+static void unmapBakedPatch(rpatch_t *patch, int index)
+{
+  I_Munmap(patch->data - sizeof(bakedpatch_t), baked[index].size);
+  patch->data = NULL;
+}
+
 //---------------------------------------------------------------------------
 void R_InitPatches(void) {
   if (!patches)
@@ -90,6 +210,8 @@ void R_InitPatches(void) {
     // clear out new patches to signal they're uninitialized
     memset(texture_composites, 0, sizeof(rpatch_t)*numtextures);
   }
+  if (!baked)
+    R_InitBakedPatches();
 }
 
 //---------------------------------------------------------------------------
@@ -107,13 +229,35 @@ void R_FlushAllPatches(void) {
   if (texture_composites)
   {
     for (i=0; i<numtextures; i++)
-      if (texture_composites[i].data)
+      if (texture_composites[i].data && !IS_BAKED(numlumps+i))
         free(texture_composites[i].data);
     free(texture_composites);
     texture_composites = NULL;
   }
 }
 
+//---------------------------------------------------------------------------
+void R_GetPatchCensus(patchcensus_t *census) {
+  int i;
+
+  memset(census, 0, sizeof(*census));
+  if (!patches)
+    return;
+  Z_CensusOwners(patches, patches + numlumps, &census->patches);
+  Z_CensusOwners(texture_composites, texture_composites + numtextures,
+                 &census->composites);
+  for (i = 0; i < numlumps + numtextures; i++) {
+    const rpatch_t *patch = i < numlumps ? &patches[i] : &texture_composites[i-numlumps];
+
+    if (patch->locks > 0) {
+      census->locked++;
+      census->locks += patch->locks;
+      if (IS_BAKED(i))
+        census->mapped++;
+    }
+  }
+}
+
 //---------------------------------------------------------------------------
 int R_NumPatchWidth(int lump)
 {
@@ -275,9 +419,9 @@ static void createPatch(int id) {
     }
 
     // setup the column's data
-    patch->columns[x].pixels = patch->pixels + (x*patch->height) + 0;
+    patch->columns[x].pixelsOffset = (patch->pixels + (x*patch->height)) - (byte*)&patch->columns[x];
     patch->columns[x].numPosts = numPostsInColumn[x];
-    patch->columns[x].posts = patch->posts + numPostsUsedSoFar;
+    patch->columns[x].postsOffset = (byte*)(patch->posts + numPostsUsedSoFar) - (byte*)&patch->columns[x];
 
     while (oldColumn->topdelta != 0xff) {
       // set up the post's data
@@ -315,12 +459,12 @@ static void createPatch(int id) {
       column = R_GetPatchColumnClamped(patch, x);
       prevColumn = R_GetPatchColumnClamped(patch, x-1);
 
-      if (column->pixels[0] == 0xff) {
+      if (R_ColumnPixels(column)[0] == 0xff) {
         // force the first pixel (which is a hole), to use
         // the color from the next solid spot in the column
         for (y=0; y<patch->height; y++) {
-          if (column->pixels[y] != 0xff) {
-            column->pixels[0] = column->pixels[y];
+          if (R_ColumnPixels(column)[y] != 0xff) {
+            R_ColumnPixels(column)[0] = R_ColumnPixels(column)[y];
             break;
           }
         }
@@ -329,17 +473,17 @@ static void createPatch(int id) {
       // copy from above or to the left
       for (y=1; y<patch->height; y++) {
         //if (getIsSolidAtSpot(oldColumn, y)) continue;
-        if (column->pixels[y] != 0xff) continue;
+        if (R_ColumnPixels(column)[y] != 0xff) continue;
 
         // this pixel is a hole
 
-        if (x && prevColumn->pixels[y-1] != 0xff) {
+        if (x && R_ColumnPixels(prevColumn)[y-1] != 0xff) {
           // copy the color from the left
-          column->pixels[y] = prevColumn->pixels[y];
+          R_ColumnPixels(column)[y] = R_ColumnPixels(prevColumn)[y];
         }
         else {
           // copy the color from above
-          column->pixels[y] = column->pixels[y-1];
+          R_ColumnPixels(column)[y] = R_ColumnPixels(column)[y-1];
         }
       }
     }
@@ -380,8 +524,8 @@ static void removePostFromColumn(rcolumn_t *column, int post) {
 #endif
   if (post < column->numPosts)
     for (i=post; i<(column->numPosts-1); i++) {
-      rpost_t *post1 = &column->posts[i];
-      rpost_t *post2 = &column->posts[i+1];
+      rpost_t *post1 = &R_ColumnPosts(column)[i];
+      rpost_t *post2 = &R_ColumnPosts(column)[i+1];
       post1->topdelta = post2->topdelta;
       post1->length = post2->length;
       post1->slope = post2->slope;
@@ -480,9 +624,11 @@ static void createTextureCompositePatch(int id) {
 
   for (x=0; x<texture->width; x++) {
       // setup the column's data
-      composite_patch->columns[x].pixels = composite_patch->pixels + (x*composite_patch->height);
-      composite_patch->columns[x].numPosts = countsInColumn[x].posts;
-      composite_patch->columns[x].posts = composite_patch->posts + numPostsUsedSoFar;
+      rcolumn_t *column = &composite_patch->columns[x];
+
+      column->pixelsOffset = (composite_patch->pixels + (x*composite_patch->height)) - (byte*)column;
+      column->numPosts = countsInColumn[x].posts;
+      column->postsOffset = (byte*)(composite_patch->posts + numPostsUsedSoFar) - (byte*)column;
       numPostsUsedSoFar += countsInColumn[x].posts;
   }
 
@@ -513,7 +659,7 @@ static void createTextureCompositePatch(int id) {
       }
 
       while (oldColumn->topdelta != 0xff) {
-        rpost_t *post = &composite_patch->columns[tx].posts[countsInColumn[tx].posts_used];
+        rpost_t *post = &R_ColumnPosts(&composite_patch->columns[tx])[countsInColumn[tx].posts_used];
         oldColumnPixelData = (const byte *)oldColumn + 3;
         oy = texpatch->originy;
         count = oldColumn->length;
@@ -598,8 +744,8 @@ static void createTextureCompositePatch(int id) {
 
     i = 0;
     while (i<(column->numPosts-1)) {
-      rpost_t *post1 = &column->posts[i];
-      rpost_t *post2 = &column->posts[i+1];
+      rpost_t *post1 = &R_ColumnPosts(column)[i];
+      rpost_t *post2 = &R_ColumnPosts(column)[i+1];
       int length;
 
       if ((post2->topdelta - post1->topdelta) < 0)
@@ -630,12 +776,12 @@ static void createTextureCompositePatch(int id) {
       column = R_GetPatchColumnClamped(composite_patch, x);
       prevColumn = R_GetPatchColumnClamped(composite_patch, x-1);
 
-      if (column->pixels[0] == 0xff) {
+      if (R_ColumnPixels(column)[0] == 0xff) {
         // force the first pixel (which is a hole), to use
         // the color from the next solid spot in the column
         for (y=0; y<composite_patch->height; y++) {
-          if (column->pixels[y] != 0xff) {
-            column->pixels[0] = column->pixels[y];
+          if (R_ColumnPixels(column)[y] != 0xff) {
+            R_ColumnPixels(column)[0] = R_ColumnPixels(column)[y];
             break;
           }
         }
@@ -644,17 +790,17 @@ static void createTextureCompositePatch(int id) {
       // copy from above or to the left
       for (y=1; y<composite_patch->height; y++) {
         //if (getIsSolidAtSpot(oldColumn, y)) continue;
-        if (column->pixels[y] != 0xff) continue;
+        if (R_ColumnPixels(column)[y] != 0xff) continue;
 
         // this pixel is a hole
 
-        if (x && prevColumn->pixels[y-1] != 0xff) {
+        if (x && R_ColumnPixels(prevColumn)[y-1] != 0xff) {
           // copy the color from the left
-          column->pixels[y] = prevColumn->pixels[y];
+          R_ColumnPixels(column)[y] = R_ColumnPixels(prevColumn)[y];
         }
         else {
           // copy the color from above
-          column->pixels[y] = column->pixels[y-1];
+          R_ColumnPixels(column)[y] = R_ColumnPixels(column)[y-1];
         }
       }
     }
@@ -678,11 +824,16 @@ const rpatch_t *R_CachePatchNum(int id) {
     I_Error("createPatch: %i >= numlumps", id);
 #endif
 
-  if (!patches[id].data)
+  I_LockShared(); // render threads share the patch cache
+
+  if (IS_BAKED(id)) {
+    if (!patches[id].locks)
+      mapBakedPatch(&patches[id], id);
+  } else if (!patches[id].data)
     createPatch(id);
 
   /* cph - if wasn't locked but now is, tell z_zone to hold it */
-  if (!patches[id].locks && locks) {
+  if (!patches[id].locks && locks && !IS_BAKED(id)) {
     Z_ChangeTag(patches[id].data,PU_STATIC);
 #ifdef TIMEDIAG
     patches[id].locktic = gametic;
@@ -696,12 +847,15 @@ const rpatch_t *R_CachePatchNum(int id) {
 	    lumpinfo[id].name, patches[id].locks);
 #endif
 
+  I_UnlockShared();
   return &patches[id];
 }
 
 void R_UnlockPatchNum(int id)
 {
   const int unlocks = 1;
+
+  I_LockShared();
 #ifdef SIMPLECHECKS
   if ((signed short)patches[id].locks < unlocks)
     lprintf(LO_DEBUG, "R_UnlockPatchNum: Excess unlocks on %8s (%d-%d)\n", 
@@ -711,8 +865,13 @@ void R_UnlockPatchNum(int id)
   /* cph - Note: must only tell z_zone to make purgeable if currently locked, 
    * else it might already have been purged
    */
-  if (unlocks && !patches[id].locks)
-    Z_ChangeTag(patches[id].data, PU_CACHE);
+  if (unlocks && !patches[id].locks) {
+    if (IS_BAKED(id))
+      unmapBakedPatch(&patches[id], id);
+    else
+      Z_ChangeTag(patches[id].data, PU_CACHE);
+  }
+  I_UnlockShared();
 }
 
 //---------------------------------------------------------------------------
@@ -727,11 +886,16 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
     I_Error("createTextureCompositePatch: %i >= numtextures", id);
 #endif
 
-  if (!texture_composites[id].data)
+  I_LockShared(); // render threads share the patch cache
+
+  if (IS_BAKED(numlumps+id)) {
+    if (!texture_composites[id].locks)
+      mapBakedPatch(&texture_composites[id], numlumps+id);
+  } else if (!texture_composites[id].data)
     createTextureCompositePatch(id);
 
   /* cph - if wasn't locked but now is, tell z_zone to hold it */
-  if (!texture_composites[id].locks && locks) {
+  if (!texture_composites[id].locks && locks && !IS_BAKED(numlumps+id)) {
     Z_ChangeTag(texture_composites[id].data,PU_STATIC);
 #ifdef TIMEDIAG
     texture_composites[id].locktic = gametic;
@@ -745,6 +909,7 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
 	    textures[id]->name, texture_composites[id].locks);
 #endif
 
+  I_UnlockShared();
   return &texture_composites[id];
 
 }
@@ -752,6 +917,8 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
 void R_UnlockTextureCompositePatchNum(int id)
 {
   const int unlocks = 1;
+
+  I_LockShared();
 #ifdef SIMPLECHECKS
   if ((signed short)texture_composites[id].locks < unlocks)
     lprintf(LO_DEBUG, "R_UnlockTextureCompositePatchNum: Excess unlocks on %8s (%d-%d)\n", 
@@ -761,8 +928,156 @@ void R_UnlockTextureCompositePatchNum(int id)
   /* cph - Note: must only tell z_zone to make purgeable if currently locked, 
    * else it might already have been purged
    */
-  if (unlocks && !texture_composites[id].locks)
-    Z_ChangeTag(texture_composites[id].data, PU_CACHE);
+  if (unlocks && !texture_composites[id].locks) {
+    if (IS_BAKED(numlumps+id))
+      unmapBakedPatch(&texture_composites[id], numlumps+id);
+    else
+      Z_ChangeTag(texture_composites[id].data, PU_CACHE);
+  }
+  I_UnlockShared();
+}
+
+//---------------------------------------------------------------------------
+// Whether a lump looks enough like a patch to be converted as one
+static int R_IsPatchLump(int lump)
+{
+  const patch_t *patch;
+  int size = W_LumpLength(lump);
+  int width, height, x, ok;
+
+  if (size < (int)sizeof(patch_t))
+    return 0;
+
+  patch = (const patch_t *)W_CacheLumpNum(lump);
+  width = SHORT(patch->width);
+  height = SHORT(patch->height);
+  ok = width > 0 && height > 0 && size >= 8 + 4*width;
+
+  for (x = 0; ok && x < width; x++) {
+    int ofs = LONG(patch->columnofs[x]);
+
+    while (1) {
+      const column_t *column = (const column_t *)((const byte *)patch + ofs);
+
+      if (ofs < 8 + 4*width || ofs >= size) {
+        ok = 0;
+        break;
+      }
+      if (column->topdelta == 0xff)
+        break;
+      if (ofs + column->length + 4 > size || column->topdelta + column->length > height) {
+        ok = 0;
+        break;
+      }
+      ofs += column->length + 4;
+    }
+  }
+
+  W_UnlockLumpNum(lump);
+  return ok;
+}
+
+// What to bake first when the blob has to fit a partition: composite
+// textures are the most work to build, then status bar, menu and other
+// graphics drawn every frame, then sprites. Wall patches are only used to
+// build the composites.
+enum { BAKE_COMPOSITE, BAKE_GRAPHIC, BAKE_SPRITE, BAKE_WALLPATCH, NUMBAKECLASSES };
+
+void R_BakePatches(const char *file, int maxsize) {
+  FILE *f = fopen(file, "wb");
+  bakedheader_t header;
+  bakedentry_t *entries;
+  byte *wallpatch;
+  int i, n = numlumps + numtextures;
+  int bakeclass, numbaked = 0, numskipped = 0, pos;
+
+  if (!f)
+    I_Error("R_BakePatches: can't write %s: %s", file, strerror(errno));
+
+  wallpatch = calloc(numlumps, 1);
+  entries = calloc(n, sizeof(*entries));
+  if (!wallpatch || !entries)
+    I_Error("R_BakePatches: no memory for the directory of %d lumps", n);
+  for (i = 0; i < numtextures; i++) {
+    int j;
+    for (j = 0; j < textures[i]->patchcount; j++)
+      wallpatch[textures[i]->patches[j].patch] = 1;
+  }
+
+  memcpy(header.magic, BAKED_MAGIC, 4);
+  R_BakedHash(header.hash);
+  header.numpatches = numlumps;
+  header.numcomposites = numtextures;
+  fwrite(&header, sizeof(header), 1, f);
+  fwrite(entries, sizeof(*entries), n, f);
+  pos = sizeof(header) + n*sizeof(*entries);
+
+  for (bakeclass = 0; bakeclass < NUMBAKECLASSES; bakeclass++)
+    for (i = 0; i < n; i++) {
+      const rcolumn_t *last;
+      rpatch_t *patch;
+      bakedpatch_t bp;
+      int size;
+
+      if (i >= numlumps) {
+        if (bakeclass != BAKE_COMPOSITE)
+          continue;
+        createTextureCompositePatch(i - numlumps);
+        patch = &texture_composites[i - numlumps];
+      } else {
+        if (bakeclass != (wallpatch[i] ? BAKE_WALLPATCH :
+            lumpinfo[i].li_namespace == ns_sprites ? BAKE_SPRITE : BAKE_GRAPHIC) ||
+            !R_IsPatchLump(i))
+          continue;
+        createPatch(i);
+        patch = &patches[i];
+      }
+
+      // posts are in column order, unused ones only at the end
+      last = &patch->columns[patch->width-1];
+      size = (const byte *)(R_ColumnPosts(last) + last->numPosts) - patch->data;
+
+      if (maxsize && pos + (int)sizeof(bp) + size > maxsize) {
+        numskipped++;
+        Z_Free(patch->data);
+        continue;
+      }
+
+      bp.width = patch->width;
+      bp.height = patch->height;
+      bp.leftoffset = patch->leftoffset;
+      bp.topoffset = patch->topoffset;
+      bp.widthmask = patch->widthmask;
+      bp.isNotTileable = patch->isNotTileable;
+      bp.columns = (byte *)patch->columns - patch->data;
+      bp.posts = (byte *)patch->posts - patch->data;
+      fwrite(&bp, sizeof(bp), 1, f);
+      fwrite(patch->data, size, 1, f);
+
+      entries[i].offset = pos;
+      entries[i].size = sizeof(bp) + size;
+      pos += entries[i].size;
+      numbaked++;
+      Z_Free(patch->data);
+    }
+
+  fseek(f, sizeof(header), SEEK_SET);
+  fwrite(entries, sizeof(*entries), n, f);
+  // a short write would leave a file with a good header and missing
+  // patches, so don't leave it behind to be loaded
+  if (ferror(f) | fclose(f)) {
+    int err = errno;
+    remove(file);
+    I_Error("R_BakePatches: can't write %s: %s", file, strerror(err));
+  }
+  free(entries);
+  free(wallpatch);
+
+  lprintf(LO_INFO, "R_BakePatches: %d patches and textures, %d bytes written to %s",
+          numbaked, pos, file);
+  if (numskipped)
+    lprintf(LO_INFO, ", %d left out to fit %d bytes", numskipped, maxsize);
+  lprintf(LO_INFO, "\n");
 }
 
 //---------------------------------------------------------------------------
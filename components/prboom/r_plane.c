@@ -31,10 +31,9 @@
  *       while maintaining a per column clipping list only.
  *      Moreover, the sky areas have to be determined.
  *
- * MAXVISPLANES is no longer a limit on the number of visplanes,
- * but a limit on the number of hash slots; larger numbers mean
- * better performance usually but after a point they are wasted,
- * and memory and time overheads creep in.
+ * There is no limit on the number of visplanes; they come from an
+ * arena that grows in blocks and are found through an open addressed
+ * hash, see R_FindPlane.
  *
  * For more information on visplanes, see:
  *
@@ -59,50 +58,71 @@
 #include "r_plane.h"
 #include "v_video.h"
 #include "lprintf.h"
+#include "i_system.h"
 #include "esp_attr.h"
 
 
-#define MAXVISPLANES 128    /* must be a power of 2 */
+// Each render thread keeps its own visplanes, openings and clip arrays.
+// The main thread uses the static arrays; other render threads get theirs
+// from R_InitPlaneThreadState.
 
-static visplane_t *visplanes[MAXVISPLANES];   // killough
-static visplane_t *freetail;                  // killough
-static visplane_t **freehead = &freetail;     // killough
-visplane_t *floorplane, *ceilingplane;
+// Visplanes live in an arena of VISPLANEBLOCK-plane blocks that is kept
+// from frame to frame; planes[] lists them in the order they were made,
+// the first numplanes are in use this frame. visplaneindex is an open
+// addressed hash of plane number+1 by (height, picnum, light, offsets),
+// twice as big as the arena so it never fills up.
 
-// killough -- hash function for visplanes
-// Empirically verified to be fairly uniform:
+#define VISPLANEBLOCK 32
 
-#define visplane_hash(picnum,lightlevel,height) \
-  ((unsigned)((picnum)*3+(lightlevel)+(height)*7) & (MAXVISPLANES-1))
+static THREADLOCAL visplane_t **planes;
+static THREADLOCAL int numplanes, maxplanes;
+static THREADLOCAL unsigned short *visplaneindex;
+static THREADLOCAL unsigned indexmask;
+static census_t planecensus;          // all threads' planes, for the census
+THREADLOCAL visplane_t *floorplane, *ceilingplane;
 
-size_t maxopenings;
-int *openings,*lastopening; // dropoff overflow
+// killough -- hash function for visplanes, with the offsets mixed in
+// and spread over the whole index
+
+#define visplane_hash(picnum,lightlevel,height,xoffs,yoffs) \
+  (((unsigned)((picnum)*3+(lightlevel)+((height)>>FRACBITS)*7+ \
+  ((xoffs)>>FRACBITS)+((yoffs)>>FRACBITS)*5) * 2654435761u >> 16) & indexmask)
+
+THREADLOCAL size_t maxopenings;
+THREADLOCAL int *openings,*lastopening; // dropoff overflow
 
 // Clip values are the solid pixel bounding the range.
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 
-int floorclip[MAX_SCREENWIDTH], ceilingclip[MAX_SCREENWIDTH]; // dropoff overflow
+static int main_floorclip[MAX_SCREENWIDTH], main_ceilingclip[MAX_SCREENWIDTH];
+THREADLOCAL int *floorclip = main_floorclip;     // dropoff overflow
+THREADLOCAL int *ceilingclip = main_ceilingclip; // dropoff overflow
 
 // spanstart holds the start of a plane span; initialized to 0 at start
 
-static int spanstart[MAX_SCREENHEIGHT];                // killough 2/8/98
+static int main_spanstart[MAX_SCREENHEIGHT];
+static THREADLOCAL int *spanstart = main_spanstart;    // killough 2/8/98
 
 //
 // texture mapping
 //
 
-static const lighttable_t **planezlight;
-static fixed_t planeheight;
+static THREADLOCAL const lighttable_t **planezlight;
+static THREADLOCAL fixed_t planeheight;
 
 // killough 2/8/98: make variables static
 
-static fixed_t basexscale, baseyscale;
-static fixed_t cachedheight[MAX_SCREENHEIGHT];
-static fixed_t cacheddistance[MAX_SCREENHEIGHT];
-static fixed_t cachedxstep[MAX_SCREENHEIGHT];
-static fixed_t cachedystep[MAX_SCREENHEIGHT];
-static fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
+static THREADLOCAL fixed_t basexscale, baseyscale;
+static fixed_t main_cachedheight[MAX_SCREENHEIGHT];
+static fixed_t main_cacheddistance[MAX_SCREENHEIGHT];
+static fixed_t main_cachedxstep[MAX_SCREENHEIGHT];
+static fixed_t main_cachedystep[MAX_SCREENHEIGHT];
+static THREADLOCAL fixed_t *cachedheight = main_cachedheight;
+static THREADLOCAL fixed_t *cacheddistance = main_cacheddistance;
+static THREADLOCAL fixed_t *cachedxstep = main_cachedxstep;
+static THREADLOCAL fixed_t *cachedystep = main_cachedystep;
+static THREADLOCAL fixed_t xoffs,yoffs; // killough 2/28/98: flat offsets
 
 fixed_t yslope[MAX_SCREENHEIGHT], distscale[MAX_SCREENWIDTH];
 
@@ -114,6 +134,24 @@ void R_InitPlanes (void)
 {
 }
 
+//
+// R_InitPlaneThreadState
+// Once in every render thread other than the main one.
+//
+void R_InitPlaneThreadState(void)
+{
+  floorclip = malloc(MAX_SCREENWIDTH * sizeof(*floorclip));
+  ceilingclip = malloc(MAX_SCREENWIDTH * sizeof(*ceilingclip));
+  spanstart = malloc(MAX_SCREENHEIGHT * sizeof(*spanstart));
+  cachedheight = malloc(MAX_SCREENHEIGHT * sizeof(*cachedheight));
+  cacheddistance = malloc(MAX_SCREENHEIGHT * sizeof(*cacheddistance));
+  cachedxstep = malloc(MAX_SCREENHEIGHT * sizeof(*cachedxstep));
+  cachedystep = malloc(MAX_SCREENHEIGHT * sizeof(*cachedystep));
+  if (!floorclip || !ceilingclip || !spanstart || !cachedheight ||
+      !cacheddistance || !cachedxstep || !cachedystep)
+    I_Error("R_InitPlaneThreadState: no memory for the plane arrays");
+}
+
 //
 // R_MapPlane
 //
@@ -141,6 +179,9 @@ static void IRAM_ATTR R_MapPlane(int y, int x1, int x2, draw_span_vars_t *dsvars
     I_Error ("R_MapPlane: %i, %i at %i",x1,x2,y);
 #endif
 
+  if (x2 < r_stripx1 || x1 > r_stripx2)
+    return;
+
   if (planeheight != cachedheight[y])
     {
       cachedheight[y] = planeheight;
@@ -167,6 +208,16 @@ static void IRAM_ATTR R_MapPlane(int y, int x1, int x2, draw_span_vars_t *dsvars
     dsvars->yfrac -= (FRACUNIT>>1);
   }
 
+  // Clip the span to this thread's strip, stepping the texture coordinates
+  // the same way the span drawer would so the pixels match a full span
+  if (x1 < r_stripx1) {
+    dsvars->xfrac += (unsigned)(r_stripx1 - x1) * (unsigned)dsvars->xstep;
+    dsvars->yfrac += (unsigned)(r_stripx1 - x1) * (unsigned)dsvars->ystep;
+    x1 = r_stripx1;
+  }
+  if (x2 > r_stripx2)
+    x2 = r_stripx2;
+
   if (!(dsvars->colormap = fixedcolormap))
     {
       dsvars->z = distance;
@@ -202,32 +253,119 @@ void R_ClearPlanes(void)
   for (i=0 ; i<viewwidth ; i++)
     floorclip[i] = viewheight, ceilingclip[i] = -1;
 
-  for (i=0;i<MAXVISPLANES;i++)    // new code -- killough
-    for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
-      freehead = &(*freehead)->next;
+  numplanes = 0;
+  if (visplaneindex)
+    memset(visplaneindex, 0, (indexmask+1) * sizeof(*visplaneindex));
 
   lastopening = openings;
 
   // texture calculation
-  memset (cachedheight, 0, sizeof(cachedheight));
+  memset (cachedheight, 0, MAX_SCREENHEIGHT * sizeof(*cachedheight));
 
   // scale will be unit scale at SCREENWIDTH/2 distance
   basexscale = FixedDiv (viewsin,projection);
   baseyscale = FixedDiv (viewcos,projection);
 }
 
+// Adds another block of planes to the arena and rebuilds the index for it
+
+static void R_GrowVisplanes(void)
+{
+  visplane_t *block = malloc(VISPLANEBLOCK * sizeof(*block));
+  visplane_t **grown = NULL;
+  unsigned short *index = NULL;
+  unsigned mask = 1;
+  size_t oldbytes = maxplanes * sizeof(*planes) +
+    (visplaneindex ? (indexmask+1) * sizeof(*visplaneindex) : 0);
+  int i;
+
+  while (mask < 2*(maxplanes + VISPLANEBLOCK))
+    mask <<= 1;
+  if (block && (grown = realloc(planes, (maxplanes + VISPLANEBLOCK) * sizeof(*planes))))
+    planes = grown;
+  if (grown)
+    index = calloc(mask, sizeof(*index));
+  if (!index)
+    I_Error("R_GrowVisplanes: out of memory for %d visplanes", maxplanes + VISPLANEBLOCK);
+  for (i = 0; i < VISPLANEBLOCK; i++)
+    planes[maxplanes++] = &block[i];
+
+  free(visplaneindex);
+  visplaneindex = index;
+  indexmask = mask - 1;
+
+  I_LockShared();
+  planecensus.count += VISPLANEBLOCK;
+  planecensus.bytes += VISPLANEBLOCK * sizeof(*block) - oldbytes +
+    maxplanes * sizeof(*planes) + (indexmask+1) * sizeof(*visplaneindex);
+  planecensus.peak = planecensus.bytes;   // never given back
+  I_UnlockShared();
+
+  for (i = 0; i < numplanes; i++)
+  {
+    const visplane_t *pl = planes[i];
+    unsigned slot = visplane_hash(pl->picnum, pl->lightlevel, pl->height, pl->xoffs, pl->yoffs);
+
+    // Later duplicates replace earlier ones, as if inserted in order
+    while (visplaneindex[slot])
+    {
+      const visplane_t *check = planes[visplaneindex[slot]-1];
+      if (check->height == pl->height && check->picnum == pl->picnum &&
+          check->lightlevel == pl->lightlevel &&
+          check->xoffs == pl->xoffs && check->yoffs == pl->yoffs)
+        break;
+      slot = (slot+1) & indexmask;
+    }
+    visplaneindex[slot] = i+1;
+  }
+}
+
+void R_GetPlaneCensus(census_t *census)
+{
+  I_LockShared();
+  *census = planecensus;
+  I_UnlockShared();
+}
+
+// Finds the index slot for a plane key: the one holding the newest plane
+// with that key, or the empty one it goes into.
+
+inline static unsigned R_VisplaneSlot(fixed_t height, int picnum, int lightlevel,
+                                      fixed_t xoffs, fixed_t yoffs)
+{
+  unsigned slot = visplane_hash(picnum, lightlevel, height, xoffs, yoffs);
+
+  while (visplaneindex[slot])
+  {
+    const visplane_t *check = planes[visplaneindex[slot]-1];
+    if (height == check->height &&
+        picnum == check->picnum &&
+        lightlevel == check->lightlevel &&
+        xoffs == check->xoffs &&      // killough 2/28/98: Add offset checks
+        yoffs == check->yoffs)
+      break;
+    slot = (slot+1) & indexmask;
+  }
+  return slot;
+}
+
 // New function, by Lee Killough
 
-static visplane_t *new_visplane(unsigned hash)
+static visplane_t *new_visplane(fixed_t height, int picnum, int lightlevel,
+                                fixed_t xoffs, fixed_t yoffs)
 {
-  visplane_t *check = freetail;
-  if (!check)
-    check = calloc(1, sizeof *check);
-  else
-    if (!(freetail = freetail->next))
-      freehead = &freetail;
-  check->next = visplanes[hash];
-  visplanes[hash] = check;
+  visplane_t *check;
+
+  if (numplanes == maxplanes)
+    R_GrowVisplanes();
+  check = planes[numplanes++];
+  visplaneindex[R_VisplaneSlot(height, picnum, lightlevel, xoffs, yoffs)] = numplanes;
+
+  check->height = height;
+  check->picnum = picnum;
+  check->lightlevel = lightlevel;
+  check->xoffs = xoffs;               // killough 2/28/98: Save offsets
+  check->yoffs = yoffs;
   return check;
 }
 
@@ -238,14 +376,9 @@ static visplane_t *new_visplane(unsigned hash)
  */
 visplane_t *R_DupPlane(const visplane_t *pl, int start, int stop)
 {
-      unsigned hash = visplane_hash(pl->picnum, pl->lightlevel, pl->height);
-      visplane_t *new_pl = new_visplane(hash);
-
-      new_pl->height = pl->height;
-      new_pl->picnum = pl->picnum;
-      new_pl->lightlevel = pl->lightlevel;
-      new_pl->xoffs = pl->xoffs;           // killough 2/28/98
-      new_pl->yoffs = pl->yoffs;
+      visplane_t *new_pl = new_visplane(pl->height, pl->picnum, pl->lightlevel,
+                                        pl->xoffs, pl->yoffs);
+
       new_pl->minx = start;
       new_pl->maxx = stop;
       memset(new_pl->top, 0xff, sizeof new_pl->top);
@@ -260,31 +393,22 @@ visplane_t IRAM_ATTR *R_FindPlane(fixed_t height, int picnum, int lightlevel,
                         fixed_t xoffs, fixed_t yoffs)
 {
   visplane_t *check;
-  unsigned hash;                      // killough
+  unsigned slot;
 
   if (picnum == skyflatnum || picnum & PL_SKYFLAT)
     height = lightlevel = 0;         // killough 7/19/98: most skies map together
 
-  // New visplane algorithm uses hash table -- killough
-  hash = visplane_hash(picnum,lightlevel,height);
-
-  for (check=visplanes[hash]; check; check=check->next)  // killough
-    if (height == check->height &&
-        picnum == check->picnum &&
-        lightlevel == check->lightlevel &&
-        xoffs == check->xoffs &&      // killough 2/28/98: Add offset checks
-        yoffs == check->yoffs)
-      return check;
+  if (visplaneindex)
+  {
+    slot = R_VisplaneSlot(height, picnum, lightlevel, xoffs, yoffs);
+    if (visplaneindex[slot])
+      return planes[visplaneindex[slot]-1];
+  }
 
-  check = new_visplane(hash);         // killough
+  check = new_visplane(height, picnum, lightlevel, xoffs, yoffs);
 
-  check->height = height;
-  check->picnum = picnum;
-  check->lightlevel = lightlevel;
   check->minx = viewwidth; // Was SCREENWIDTH -- killough 11/98
   check->maxx = -1;
-  check->xoffs = xoffs;               // killough 2/28/98: Save offsets
-  check->yoffs = yoffs;
 
   memset (check->top, 0xff, sizeof check->top);
 
@@ -337,8 +461,9 @@ static void R_MakeSpans(int x, unsigned int t1, unsigned int b1,
 }
 
 // New function, by Lee Killough
+// flat is the plane's flat, already cached; NULL for skies
 
-static void IRAM_ATTR R_DoDrawPlane(visplane_t *pl)
+static void IRAM_ATTR R_DoDrawPlane(visplane_t *pl, const byte *flat)
 {
   register int x;
   draw_column_vars_t dcvars;
@@ -346,112 +471,108 @@ static void IRAM_ATTR R_DoDrawPlane(visplane_t *pl)
 
   R_SetDefaultDrawColumnVars(&dcvars);
 
-  if (pl->minx <= pl->maxx) {
-    if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT) { // sky flat
-      int texture;
-      const rpatch_t *tex_patch;
-      angle_t an, flip;
+  if (!flat) { // sky flat
+    int texture;
+    const rpatch_t *tex_patch;
+    angle_t an, flip;
 
-      // killough 10/98: allow skies to come from sidedefs.
-      // Allows scrolling and/or animated skies, as well as
-      // arbitrary multiple skies per level without having
-      // to use info lumps.
+    // killough 10/98: allow skies to come from sidedefs.
+    // Allows scrolling and/or animated skies, as well as
+    // arbitrary multiple skies per level without having
+    // to use info lumps.
 
-      an = viewangle;
+    an = viewangle;
 
-      if (pl->picnum & PL_SKYFLAT)
-      {
-        // Sky Linedef
-        const line_t *l = &lines[pl->picnum & ~PL_SKYFLAT];
+    if (pl->picnum & PL_SKYFLAT)
+    {
+      // Sky Linedef
+      const line_t *l = &lines[pl->picnum & ~PL_SKYFLAT];
 
-        // Sky transferred from first sidedef
-        const side_t *s = *l->sidenum + sides;
+      // Sky transferred from first sidedef
+      const side_t *s = *l->sidenum + sides;
 
-        // Texture comes from upper texture of reference sidedef
-        texture = texturetranslation[s->toptexture];
+      // Texture comes from upper texture of reference sidedef
+      texture = texturetranslation[s->toptexture];
 
-        // Horizontal offset is turned into an angle offset,
-        // to allow sky rotation as well as careful positioning.
-        // However, the offset is scaled very small, so that it
-        // allows a long-period of sky rotation.
+      // Horizontal offset is turned into an angle offset,
+      // to allow sky rotation as well as careful positioning.
+      // However, the offset is scaled very small, so that it
+      // allows a long-period of sky rotation.
 
-        an += s->textureoffset;
+      an += s->textureoffset;
 
-        // Vertical offset allows careful sky positioning.
+      // Vertical offset allows careful sky positioning.
 
-        dcvars.texturemid = s->rowoffset - 28*FRACUNIT;
+      dcvars.texturemid = s->rowoffset - 28*FRACUNIT;
 
-        // We sometimes flip the picture horizontally.
-        //
-        // Doom always flipped the picture, so we make it optional,
-        // to make it easier to use the new feature, while to still
-        // allow old sky textures to be used.
+      // We sometimes flip the picture horizontally.
+      //
+      // Doom always flipped the picture, so we make it optional,
+      // to make it easier to use the new feature, while to still
+      // allow old sky textures to be used.
 
-        flip = l->special==272 ? 0u : ~0u;
-      }
-      else
-      {    // Normal Doom sky, only one allowed per level
-        dcvars.texturemid = skytexturemid;    // Default y-offset
-        texture = skytexture;             // Default texture
-        flip = 0;                         // Doom flips it
-      }
+      flip = l->special==272 ? 0u : ~0u;
+    }
+    else
+    {    // Normal Doom sky, only one allowed per level
+      dcvars.texturemid = skytexturemid;    // Default y-offset
+      texture = skytexture;             // Default texture
+      flip = 0;                         // Doom flips it
+    }
 
-      /* Sky is always drawn full bright, i.e. colormaps[0] is used.
-       * Because of this hack, sky is not affected by INVUL inverse mapping.
-       * Until Boom fixed this. Compat option added in MBF. */
+    /* Sky is always drawn full bright, i.e. colormaps[0] is used.
+     * Because of this hack, sky is not affected by INVUL inverse mapping.
+     * Until Boom fixed this. Compat option added in MBF. */
 
-      if (comp[comp_skymap] || !(dcvars.colormap = fixedcolormap))
-        dcvars.colormap = fullcolormap;          // killough 3/20/98
+    if (comp[comp_skymap] || !(dcvars.colormap = fixedcolormap))
+      dcvars.colormap = fullcolormap;          // killough 3/20/98
 
-      dcvars.nextcolormap = dcvars.colormap; // for filtering -- POPE
+    dcvars.nextcolormap = dcvars.colormap; // for filtering -- POPE
 
-      //dcvars.texturemid = skytexturemid;
-      dcvars.texheight = textureheight[skytexture]>>FRACBITS; // killough
-      // proff 09/21/98: Changed for high-res
-      dcvars.iscale = FRACUNIT*200/viewheight;
+    //dcvars.texturemid = skytexturemid;
+    dcvars.texheight = textureheight[skytexture]>>FRACBITS; // killough
+    // proff 09/21/98: Changed for high-res
+    dcvars.iscale = FRACUNIT*200/viewheight;
 
-      tex_patch = R_CacheTextureCompositePatchNum(texture);
+    tex_patch = R_CacheTextureCompositePatchNum(texture);
 
-  // killough 10/98: Use sky scrolling offset, and possibly flip picture
-        for (x = pl->minx; (dcvars.x = x) <= pl->maxx; x++)
-          if ((dcvars.yl = pl->top[x]) != -1 && dcvars.yl <= (dcvars.yh = pl->bottom[x])) // dropoff overflow
-            {
-              dcvars.source = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x])^flip) >> ANGLETOSKYSHIFT);
-              dcvars.prevsource = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x-1])^flip) >> ANGLETOSKYSHIFT);
-              dcvars.nextsource = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x+1])^flip) >> ANGLETOSKYSHIFT);
-              colfunc(&dcvars);
-            }
+// killough 10/98: Use sky scrolling offset, and possibly flip picture
+      for (x = MAX(pl->minx, r_stripx1); (dcvars.x = x) <= MIN(pl->maxx, r_stripx2); x++)
+        if ((dcvars.yl = pl->top[x]) != -1 && dcvars.yl <= (dcvars.yh = pl->bottom[x])) // dropoff overflow
+          {
+            dcvars.source = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x])^flip) >> ANGLETOSKYSHIFT);
+            dcvars.prevsource = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x-1])^flip) >> ANGLETOSKYSHIFT);
+            dcvars.nextsource = R_GetTextureColumn(tex_patch, ((an + xtoviewangle[x+1])^flip) >> ANGLETOSKYSHIFT);
+            colfunc(&dcvars);
+          }
 
-      R_UnlockTextureCompositePatchNum(texture);
+    R_UnlockTextureCompositePatchNum(texture);
 
-    } else {     // regular flat
+  } else {     // regular flat
 
-      int stop, light;
-      draw_span_vars_t dsvars;
+    int stop, light;
+    draw_span_vars_t dsvars;
 
-      dsvars.source = W_CacheLumpNum(firstflat + flattranslation[pl->picnum]);
+    dsvars.source = flat;
 
-      xoffs = pl->xoffs;  // killough 2/28/98: Add offsets
-      yoffs = pl->yoffs;
-      planeheight = D_abs(pl->height-viewz);
-      light = (pl->lightlevel >> LIGHTSEGSHIFT) + extralight;
+    xoffs = pl->xoffs;  // killough 2/28/98: Add offsets
+    yoffs = pl->yoffs;
+    planeheight = D_abs(pl->height-viewz);
+    light = (pl->lightlevel >> LIGHTSEGSHIFT) + extralight;
 
-      if (light >= LIGHTLEVELS)
+    if (light >= LIGHTLEVELS)
   light = LIGHTLEVELS-1;
 
-      if (light < 0)
+    if (light < 0)
   light = 0;
 
-      stop = pl->maxx + 1;
-      planezlight = zlight[light];
-      pl->top[pl->minx-1] = pl->top[stop] = 0xffffffffu; // dropoff overflow
-
-      for (x = pl->minx ; x <= stop ; x++)
-         R_MakeSpans(x,pl->top[x-1],pl->bottom[x-1],
-                     pl->top[x],pl->bottom[x], &dsvars);
+    stop = pl->maxx + 1;
+    planezlight = zlight[light];
+    pl->top[pl->minx-1] = pl->top[stop] = 0xffffffffu; // dropoff overflow
 
-      W_UnlockLumpNum(firstflat + flattranslation[pl->picnum]);
-    }
+    for (x = pl->minx ; x <= stop ; x++)
+       R_MakeSpans(x,pl->top[x-1],pl->bottom[x-1],
+                   pl->top[x],pl->bottom[x], &dsvars);
   }
 }
 
@@ -460,11 +581,44 @@ static void IRAM_ATTR R_DoDrawPlane(visplane_t *pl)
 // At the end of each frame.
 //
 
+static int R_ComparePlanes(const void *a, const void *b)
+{
+  const visplane_t *x = *(const visplane_t *const *)a, *y = *(const visplane_t *const *)b;
+
+  if (x->picnum != y->picnum)
+    return x->picnum < y->picnum ? -1 : 1;
+  return x < y ? -1 : x > y;
+}
+
+// Planes are drawn grouped by flat, so every flat is cached once a frame
+// and stays in the data cache while all of its planes are drawn. Planes
+// don't overlap, so the order doesn't change the picture. This reorders
+// planes[], the index is stale until the next R_ClearPlanes.
+
 void R_DrawPlanes (void)
 {
-  visplane_t *pl;
-  int i;
-  for (i=0;i<MAXVISPLANES;i++)
-    for (pl=visplanes[i]; pl; pl=pl->next, rendered_visplanes++)
-      R_DoDrawPlane(pl);
+  int i, j;
+
+  qsort(planes, numplanes, sizeof(*planes), R_ComparePlanes);
+
+  for (i = 0; i < numplanes; i = j)
+  {
+    int picnum = planes[i]->picnum;
+    boolean sky = picnum == skyflatnum || picnum & PL_SKYFLAT;
+    const byte *flat = NULL;
+
+    for (j = i; j < numplanes && planes[j]->picnum == picnum; j++, rendered_visplanes++)
+    {
+      visplane_t *pl = planes[j];
+
+      // Nothing to do if the plane is empty or outside this thread's strip
+      if (pl->minx > pl->maxx || pl->maxx < r_stripx1 || pl->minx > r_stripx2)
+        continue;
+      if (!sky && !flat)
+        flat = W_CacheLumpNum(firstflat + flattranslation[picnum]);
+      R_DoDrawPlane(pl, flat);
+    }
+    if (flat)
+      W_UnlockLumpNum(firstflat + flattranslation[picnum]);
+  }
 }
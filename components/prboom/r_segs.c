@@ -49,48 +49,49 @@
 // OPTIMIZE: closed two sided lines as single sided
 
 // killough 1/6/98: replaced globals with statics where appropriate
+// All of this is per render thread, see R_RenderPlayerView.
 
 // True if any of the segs textures might be visible.
-static boolean  segtextured;
-static boolean  markfloor;      // False if the back side is the same plane.
-static boolean  markceiling;
-static boolean  maskedtexture;
-static int      toptexture;
-static int      bottomtexture;
-static int      midtexture;
+static THREADLOCAL boolean  segtextured;
+static THREADLOCAL boolean  markfloor;      // False if the back side is the same plane.
+static THREADLOCAL boolean  markceiling;
+static THREADLOCAL boolean  maskedtexture;
+static THREADLOCAL int      toptexture;
+static THREADLOCAL int      bottomtexture;
+static THREADLOCAL int      midtexture;
 
-static fixed_t  toptexheight, midtexheight, bottomtexheight; // cph
+static THREADLOCAL fixed_t  toptexheight, midtexheight, bottomtexheight; // cph
 
-angle_t         rw_normalangle; // angle to line origin
-int             rw_angle1;
-fixed_t         rw_distance;
+THREADLOCAL angle_t         rw_normalangle; // angle to line origin
+THREADLOCAL int             rw_angle1;
+THREADLOCAL fixed_t         rw_distance;
 
 //
 // regular wall
 //
-static int      rw_x;
-static int      rw_stopx;
-static angle_t  rw_centerangle;
-static fixed_t  rw_offset;
-static fixed_t  rw_scale;
-static fixed_t  rw_scalestep;
-static fixed_t  rw_midtexturemid;
-static fixed_t  rw_toptexturemid;
-static fixed_t  rw_bottomtexturemid;
-static int      rw_lightlevel;
-static int      worldtop;
-static int      worldbottom;
-static int      worldhigh;
-static int      worldlow;
-static fixed_t  pixhigh;
-static fixed_t  pixlow;
-static fixed_t  pixhighstep;
-static fixed_t  pixlowstep;
-static fixed_t  topfrac;
-static fixed_t  topstep;
-static fixed_t  bottomfrac;
-static fixed_t  bottomstep;
-static int      *maskedtexturecol; // dropoff overflow
+static THREADLOCAL int      rw_x;
+static THREADLOCAL int      rw_stopx;
+static THREADLOCAL angle_t  rw_centerangle;
+static THREADLOCAL fixed_t  rw_offset;
+static THREADLOCAL fixed_t  rw_scale;
+static THREADLOCAL fixed_t  rw_scalestep;
+static THREADLOCAL fixed_t  rw_midtexturemid;
+static THREADLOCAL fixed_t  rw_toptexturemid;
+static THREADLOCAL fixed_t  rw_bottomtexturemid;
+static THREADLOCAL int      rw_lightlevel;
+static THREADLOCAL int      worldtop;
+static THREADLOCAL int      worldbottom;
+static THREADLOCAL int      worldhigh;
+static THREADLOCAL int      worldlow;
+static THREADLOCAL fixed_t  pixhigh;
+static THREADLOCAL fixed_t  pixlow;
+static THREADLOCAL fixed_t  pixhighstep;
+static THREADLOCAL fixed_t  pixlowstep;
+static THREADLOCAL fixed_t  topfrac;
+static THREADLOCAL fixed_t  topstep;
+static THREADLOCAL fixed_t  bottomfrac;
+static THREADLOCAL fixed_t  bottomstep;
+static THREADLOCAL int      *maskedtexturecol; // dropoff overflow
 
 //
 // R_ScaleFromGlobalAngle
@@ -126,6 +127,14 @@ void IRAM_ATTR R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
   draw_column_vars_t dcvars;
   angle_t angle;
 
+  // Only this thread's strip of columns gets drawn
+  if (x1 < r_stripx1)
+    x1 = r_stripx1;
+  if (x2 > r_stripx2)
+    x2 = r_stripx2;
+  if (x1 > x2)
+    return;
+
   R_SetDefaultDrawColumnVars(&dcvars);
 
   // Calculate light table.
@@ -262,7 +271,7 @@ void IRAM_ATTR R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 
 #define HEIGHTBITS 12
 #define HEIGHTUNIT (1<<HEIGHTBITS)
-static int didsolidcol; /* True if at least one column was marked solid */
+static THREADLOCAL int didsolidcol; /* True if at least one column was marked solid */
 
 static void IRAM_ATTR R_RenderSegLoop (void)
 {
@@ -282,6 +291,9 @@ static void IRAM_ATTR R_RenderSegLoop (void)
       int yh = bottomfrac>>HEIGHTBITS;
       int yl = (topfrac+HEIGHTUNIT-1)>>HEIGHTBITS;
 
+      // Outside this thread's strip only the clipping is kept up to date
+      boolean instrip = rw_x >= r_stripx1 && rw_x <= r_stripx2;
+
       // no space above wall?
       int bottom,top = ceilingclip[rw_x]+1;
 
@@ -351,14 +363,16 @@ static void IRAM_ATTR R_RenderSegLoop (void)
           dcvars.yl = yl;     // single sided line
           dcvars.yh = yh;
           dcvars.texturemid = rw_midtexturemid;
-          tex_patch = R_CacheTextureCompositePatchNum(midtexture);
-          dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
-          dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
-          dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
-          dcvars.texheight = midtexheight;
-          colfunc (&dcvars);
-          R_UnlockTextureCompositePatchNum(midtexture);
-          tex_patch = NULL;
+          if (instrip) {
+            tex_patch = R_CacheTextureCompositePatchNum(midtexture);
+            dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
+            dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
+            dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
+            dcvars.texheight = midtexheight;
+            colfunc (&dcvars);
+            R_UnlockTextureCompositePatchNum(midtexture);
+            tex_patch = NULL;
+          }
           ceilingclip[rw_x] = viewheight;
           floorclip[rw_x] = -1;
         }
@@ -380,14 +394,16 @@ static void IRAM_ATTR R_RenderSegLoop (void)
                   dcvars.yl = yl;
                   dcvars.yh = mid;
                   dcvars.texturemid = rw_toptexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(toptexture);
-                  dcvars.source = R_GetTextureColumn(tex_patch,texturecolumn);
-                  dcvars.prevsource = R_GetTextureColumn(tex_patch,texturecolumn-1);
-                  dcvars.nextsource = R_GetTextureColumn(tex_patch,texturecolumn+1);
-                  dcvars.texheight = toptexheight;
-                  colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(toptexture);
-                  tex_patch = NULL;
+                  if (instrip) {
+                    tex_patch = R_CacheTextureCompositePatchNum(toptexture);
+                    dcvars.source = R_GetTextureColumn(tex_patch,texturecolumn);
+                    dcvars.prevsource = R_GetTextureColumn(tex_patch,texturecolumn-1);
+                    dcvars.nextsource = R_GetTextureColumn(tex_patch,texturecolumn+1);
+                    dcvars.texheight = toptexheight;
+                    colfunc (&dcvars);
+                    R_UnlockTextureCompositePatchNum(toptexture);
+                    tex_patch = NULL;
+                  }
                   ceilingclip[rw_x] = mid;
                 }
               else
@@ -414,14 +430,16 @@ static void IRAM_ATTR R_RenderSegLoop (void)
                   dcvars.yl = mid;
                   dcvars.yh = yh;
                   dcvars.texturemid = rw_bottomtexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(bottomtexture);
-                  dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
-                  dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
-                  dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
-                  dcvars.texheight = bottomtexheight;
-                  colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(bottomtexture);
-                  tex_patch = NULL;
+                  if (instrip) {
+                    tex_patch = R_CacheTextureCompositePatchNum(bottomtexture);
+                    dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
+                    dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
+                    dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
+                    dcvars.texheight = bottomtexheight;
+                    colfunc (&dcvars);
+                    R_UnlockTextureCompositePatchNum(bottomtexture);
+                    tex_patch = NULL;
+                  }
                   floorclip[rw_x] = mid;
                 }
               else
@@ -532,8 +550,6 @@ void R_StoreWallRange(const int start, const int stop)
   rw_stopx = stop+1;
 
   {     // killough 1/6/98, 2/1/98: remove limit on openings
-    extern int *openings; // dropoff overflow
-    extern size_t maxopenings;
     size_t pos = lastopening - openings;
     size_t need = (rw_stopx - start)*4 + pos;
     if (need > maxopenings)
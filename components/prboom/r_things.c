@@ -41,6 +41,8 @@
 #include "r_fps.h"
 #include "v_video.h"
 #include "lprintf.h"
+#include "i_system.h"
+#include "m_bench.h"
 
 #define MINZ        (FRACUNIT*4)
 #define BASEYCENTER 100
@@ -262,8 +264,53 @@ static void R_InitSpriteDefs(const char * const * namelist)
 // GAME FUNCTIONS
 //
 
-static vissprite_t *vissprites, **vissprite_ptrs;  // killough
-static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+// Per render thread, like the rest of the frame's renderer state.
+// vissprite_ptrs holds twice num_vissprite_alloc pointers, the sorted
+// order and the sort's scratch space, and grows with vissprites.
+static THREADLOCAL vissprite_t *vissprites, **vissprite_ptrs;  // killough
+static THREADLOCAL size_t num_vissprite, num_vissprite_alloc;
+static census_t spritecensus;         // all threads' vissprites, for the census
+
+// Last frame's draw order by thing, an open hash of twice
+// num_vissprite_alloc entries that this frame's sort starts from.
+// Entries from older frames have an older stamp and count as empty.
+typedef struct {
+  const mobj_t *thing;
+  int rank;
+  unsigned stamp;
+} spriterank_t;
+
+static THREADLOCAL spriterank_t *lastranks;
+static THREADLOCAL int num_lastranks;  // sprites in last frame's order
+static THREADLOCAL unsigned rankstamp;
+
+// Sprites sorted, places they moved in the insertion pass, and sorts
+// that were left to msort
+THREADLOCAL int rendered_sortsprites, rendered_sortmoves, rendered_fullsorts;
+THREADLOCAL unsigned rendered_sortus;  // -benchmark only
+boolean r_spriteorder = true;  // -nospriteorder sorts every frame afresh
+
+static void R_CensusVisSprites(size_t sprites, size_t bytes)
+{
+  I_LockShared();
+  spritecensus.count += sprites;
+  spritecensus.bytes += bytes;
+  spritecensus.peak = spritecensus.bytes;   // never given back
+  I_UnlockShared();
+}
+
+void R_GetSpriteCensus(census_t *census)
+{
+  I_LockShared();
+  *census = spritecensus;
+  I_UnlockShared();
+}
+
+// Frame each sector's things were last projected in. Every render thread
+// projects all visible things itself, so this can't be sector_t's shared
+// validcount.
+static THREADLOCAL int *sectorvalid;
+static THREADLOCAL int numsectorvalid;
 
 //
 // R_InitSprites
@@ -286,6 +333,14 @@ void R_InitSprites(const char * const *namelist)
 void R_ClearSprites (void)
 {
   num_vissprite = 0;            // killough
+
+  if (numsectorvalid < numsectors)
+    {
+      sectorvalid = realloc(sectorvalid, numsectors * sizeof(*sectorvalid));
+      memset(sectorvalid + numsectorvalid, 0,
+        (numsectors - numsectorvalid) * sizeof(*sectorvalid));
+      numsectorvalid = numsectors;
+    }
 }
 
 //
@@ -301,10 +356,24 @@ static vissprite_t *R_NewVisSprite(void)
       num_vissprite_alloc = num_vissprite_alloc ? num_vissprite_alloc*2 : 128;
       lprintf(LO_DEBUG, "R_NewVisSprite: reallocing vissprites array to %d\n", num_vissprite_alloc);
       vissprites = realloc(vissprites,num_vissprite_alloc*sizeof(*vissprites));
+      vissprite_ptrs = realloc(vissprite_ptrs,
+                               num_vissprite_alloc*2*sizeof(*vissprite_ptrs));
+
+      // last frame's order goes, this frame is sorted from scratch
+      free(lastranks);
+      lastranks = calloc(num_vissprite_alloc*2, sizeof(*lastranks));
+      if (!vissprites || !vissprite_ptrs || !lastranks)
+        I_Error("R_NewVisSprite: no memory for %d vissprites",
+                (int)num_vissprite_alloc);
+      num_lastranks = 0;
+      rankstamp = 1;
 
       //e6y: set all fields to zero
       memset(vissprites + num_vissprite_alloc_prev, 0,
         (num_vissprite_alloc - num_vissprite_alloc_prev)*sizeof(*vissprites));
+      R_CensusVisSprites(num_vissprite_alloc - num_vissprite_alloc_prev,
+        (num_vissprite_alloc - num_vissprite_alloc_prev)*
+        (sizeof(*vissprites) + 2*sizeof(*vissprite_ptrs) + 2*sizeof(*lastranks)));
     }
  return vissprites + num_vissprite++;
 }
@@ -316,10 +385,14 @@ static vissprite_t *R_NewVisSprite(void)
 //  in posts/runs of opaque pixels.
 //
 
-int   *mfloorclip;   // dropoff overflow
-int   *mceilingclip; // dropoff overflow
-fixed_t spryscale;
-fixed_t sprtopscreen;
+THREADLOCAL int   *mfloorclip;   // dropoff overflow
+THREADLOCAL int   *mceilingclip; // dropoff overflow
+THREADLOCAL fixed_t spryscale;
+THREADLOCAL fixed_t sprtopscreen;
+
+// Masked pixels drawn, and how many of them by R_DrawSpriteRuns8
+THREADLOCAL int rendered_maskedpixels, rendered_runpixels;
+boolean r_spriteruns = true;   // -nospriteruns turns the fast path off
 
 void R_DrawMaskedColumn(
   const rpatch_t *patch,
@@ -337,7 +410,7 @@ void R_DrawMaskedColumn(
 
   dcvars->texheight = patch->height; // killough 11/98
   for (i=0; i<column->numPosts; i++) {
-      const rpost_t *post = &column->posts[i];
+      const rpost_t *post = &R_ColumnPosts(column)[i];
 
       // calculate unclipped screen coordinates for post
       topscreen = sprtopscreen + spryscale*post->topdelta;
@@ -355,9 +428,10 @@ void R_DrawMaskedColumn(
       // killough 3/2/98, 3/27/98: Failsafe against overflow/crash:
       if (dcvars->yl <= dcvars->yh && dcvars->yh < viewheight)
         {
-          dcvars->source = column->pixels + post->topdelta;
-          dcvars->prevsource = prevcolumn->pixels + post->topdelta;
-          dcvars->nextsource = nextcolumn->pixels + post->topdelta;
+          rendered_maskedpixels += dcvars->yh - dcvars->yl + 1;
+          dcvars->source = R_ColumnPixels(column) + post->topdelta;
+          dcvars->prevsource = R_ColumnPixels(prevcolumn) + post->topdelta;
+          dcvars->nextsource = R_ColumnPixels(nextcolumn) + post->topdelta;
 
           dcvars->texturemid = basetexturemid - (post->topdelta<<FRACBITS);
 
@@ -372,6 +446,95 @@ void R_DrawMaskedColumn(
   dcvars->texturemid = basetexturemid;
 }
 
+//
+// R_DrawVisSpriteRuns
+// The columns of a point sampled 8 bit sprite with square edges. All the
+// posts of a column are clipped first and the visible runs drawn together
+// by R_DrawSpriteRuns8, without the column buffer. A run that would make
+// the column function wrap around the patch height (rounding at the top or
+// bottom of a post) is left to the column function instead, so the pixels
+// are the same either way.
+//
+
+#define MAXSPRITERUNS 16
+
+static void R_DrawVisSpriteRuns(const vissprite_t *vis, const rpatch_t *patch,
+                                R_DrawColumn_f colfunc, draw_column_vars_t *dcvars,
+                                const byte *runtranmap, int x1, int x2, fixed_t frac)
+{
+  spriterun_t runs[MAXSPRITERUNS];
+  const fixed_t fracstep = dcvars->iscale;
+  const fixed_t basetexturemid = dcvars->texturemid;
+  const int_64_t fraclimit = (int_64_t)patch->height << FRACBITS;
+  int x;
+
+  // whatever is in the column buffer was drawn before this sprite
+  R_ResetColumnBuffer();
+  dcvars->texheight = patch->height;
+
+  for (x = x1; x <= x2; x++, frac += vis->xiscale)
+    {
+      const rcolumn_t *column = R_GetPatchColumnClamped(patch, frac>>FRACBITS);
+      const rpost_t *post = R_ColumnPosts(column);
+      const byte *pixels = R_ColumnPixels(column);
+      const int floorclip = mfloorclip[x], ceilingclip = mceilingclip[x];
+      int i, n = 0;
+
+      for (i = 0; i < column->numPosts; i++, post++)
+        {
+          // as in R_DrawMaskedColumn and the column function
+          int topscreen = sprtopscreen + spryscale*post->topdelta;
+          int bottomscreen = topscreen + spryscale*post->length;
+          int yl = (topscreen+FRACUNIT-1)>>FRACBITS;
+          int yh = (bottomscreen-1)>>FRACBITS;
+          fixed_t texturemid = basetexturemid - (post->topdelta<<FRACBITS);
+          fixed_t start;
+
+          if (yh >= floorclip)
+            yh = floorclip-1;
+          if (yl <= ceilingclip)
+            yl = ceilingclip+1;
+          if (yl > yh || yh >= viewheight)
+            continue;
+
+          rendered_maskedpixels += yh - yl + 1;
+          start = texturemid + (yl-centery)*fracstep;
+          if (patch->height &&
+              (start < 0 || start + (int_64_t)(yh-yl)*fracstep >= fraclimit))
+            {
+              dcvars->x = x;
+              dcvars->yl = yl;
+              dcvars->yh = yh;
+              dcvars->texu = frac;
+              dcvars->source = pixels + post->topdelta;
+              dcvars->texturemid = texturemid;
+              dcvars->drawingmasked = 1;
+              colfunc(dcvars);
+              dcvars->drawingmasked = 0;
+              R_ResetColumnBuffer();
+              continue;
+            }
+
+          if (n == MAXSPRITERUNS)
+            {
+              R_DrawSpriteRuns8(x, runs, n, fracstep, dcvars->colormap,
+                                dcvars->translation, runtranmap);
+              n = 0;
+            }
+          runs[n].yl = yl;
+          runs[n].count = yh - yl + 1;
+          runs[n].frac = start;
+          runs[n].source = pixels + post->topdelta;
+          rendered_runpixels += runs[n].count;
+          n++;
+        }
+      if (n)
+        R_DrawSpriteRuns8(x, runs, n, fracstep, dcvars->colormap,
+                          dcvars->translation, runtranmap);
+    }
+  dcvars->texturemid = basetexturemid;
+}
+
 //
 // R_DrawVisSprite
 //  mfloorclip and mceilingclip should also be set.
@@ -381,12 +544,22 @@ static void R_DrawVisSprite(vissprite_t *vis, int x1, int x2)
 {
   int      texturecolumn;
   fixed_t  frac;
-  const rpatch_t *patch = R_CachePatchNum(vis->patch+firstspritelump);
+  const rpatch_t *patch;
   R_DrawColumn_f colfunc;
   draw_column_vars_t dcvars;
   enum draw_filter_type_e filter;
   enum draw_filter_type_e filterz;
+  const byte *runtranmap = NULL;
+
+  // Only this thread's strip of columns gets drawn
+  if (x1 < r_stripx1)
+    x1 = r_stripx1;
+  if (x2 > r_stripx2)
+    x2 = r_stripx2;
+  if (x1 > x2)
+    return;
 
+  patch = R_CachePatchNum(vis->patch+firstspritelump);
   R_SetDefaultDrawColumnVars(&dcvars);
   if (vis->isplayersprite) {
     dcvars.edgetype = drawvars.patch_edges;
@@ -417,7 +590,7 @@ static void R_DrawVisSprite(vissprite_t *vis, int x1, int x2)
       if (vis->mobjflags & MF_TRANSLUCENT && general_translucency) // phares
         {
           colfunc = R_GetDrawColumnFunc(RDC_PIPELINE_TRANSLUCENT, filter, filterz);
-          tranmap = main_tranmap;       // killough 4/11/98
+          tranmap = runtranmap = main_tranmap;       // killough 4/11/98
         }
       else
         colfunc = R_GetDrawColumnFunc(RDC_PIPELINE_STANDARD, filter, filterz); // killough 3/14/98, 4/11/98
@@ -425,13 +598,23 @@ static void R_DrawVisSprite(vissprite_t *vis, int x1, int x2)
 // proff 11/06/98: Changed for high-res
   dcvars.iscale = FixedDiv (FRACUNIT, vis->scale);
   dcvars.texturemid = vis->texturemid;
-  frac = vis->startfrac;
+  // start part way in if clipped to a strip, exactly as if stepped there
+  frac = vis->startfrac + (unsigned)(x1 - vis->x1) * (unsigned)vis->xiscale;
   if (filter == RDRAW_FILTER_LINEAR)
     frac -= (FRACUNIT>>1);
   spryscale = vis->scale;
   sprtopscreen = centeryfrac - FixedMul(dcvars.texturemid,spryscale);
 
-  for (dcvars.x=vis->x1 ; dcvars.x<=vis->x2 ; dcvars.x++, frac += vis->xiscale)
+  if (r_spriteruns && V_GetMode() == VID_MODE8 && dcvars.colormap &&
+      filter == RDRAW_FILTER_POINT && filterz == RDRAW_FILTER_POINT &&
+      dcvars.edgetype != RDRAW_MASKEDCOLUMNEDGE_SLOPED)
+    {
+      R_DrawVisSpriteRuns(vis, patch, colfunc, &dcvars, runtranmap, x1, x2, frac);
+      R_UnlockPatchNum(vis->patch+firstspritelump);
+      return;
+    }
+
+  for (dcvars.x=x1 ; dcvars.x<=x2 ; dcvars.x++, frac += vis->xiscale)
     {
       texturecolumn = frac>>FRACBITS;
       dcvars.texu = frac;
@@ -612,6 +795,8 @@ static void R_ProjectSprite (mobj_t* thing, int lightlevel)
     return;
   }
 #endif
+  vis->thing = thing;                      // for the sort order next frame
+
   // killough 3/27/98: save sector for special clipping later
   vis->heightsec = heightsec;
 
@@ -670,11 +855,11 @@ void R_AddSprites(subsector_t* subsec, int lightlevel)
   //  subsectors during BSP building.
   // Thus we check whether its already added.
 
-  if (sec->validcount == validcount)
+  if (sectorvalid[sec - sectors] == validcount)
     return;
 
   // Well, now it will be done.
-  sec->validcount = validcount;
+  sectorvalid[sec - sectors] = validcount;
 
   // Handle all things in sector.
 
@@ -849,6 +1034,11 @@ void R_DrawPlayerSprites(void)
 
 #endif
 
+// Nearest first; sprites at the same distance keep the order they were
+// projected in, so that every frame and every render thread agrees.
+#define SPRITE_BEFORE(a, b) \
+  ((a)->scale > (b)->scale || ((a)->scale == (b)->scale && (a) < (b)))
+
 // killough 9/2/98: merge sort
 
 static void msort(vissprite_t **s, vissprite_t **t, int n)
@@ -861,7 +1051,7 @@ static void msort(vissprite_t **s, vissprite_t **t, int n)
       msort(s1, t, n1);
       msort(s2, t, n2);
 
-      while ((*s1)->scale > (*s2)->scale ?
+      while (SPRITE_BEFORE(*s1, *s2) ?
              (*d++ = *s1++, --n1) : (*d++ = *s2++, --n2));
 
       if (n2)
@@ -877,41 +1067,138 @@ static void msort(vissprite_t **s, vissprite_t **t, int n)
       for (i = 1; i < n; i++)
         {
           vissprite_t *temp = s[i];
-          if (s[i-1]->scale < temp->scale)
+          if (SPRITE_BEFORE(temp, s[i-1]))
             {
               int j = i;
-              while ((s[j] = s[j-1])->scale < temp->scale && --j);
+              while ((s[j] = s[j-1], SPRITE_BEFORE(temp, s[j])) && --j);
               s[j] = temp;
             }
         }
     }
 }
 
+static unsigned R_SpriteHash(const mobj_t *thing)
+{
+  return ((unsigned)((size_t)thing >> 3) * 2654435761u) &
+    (num_vissprite_alloc*2 - 1);
+}
+
+// Puts this frame's sprites in last frame's order, so that the insertion
+// pass only has to move the ones that changed place. Things that weren't
+// drawn last frame go after the rest, in the order they were projected.
+static void R_CarrySpriteOrder(void)
+{
+  vissprite_t **order = vissprite_ptrs + num_vissprite_alloc;
+  int n = num_vissprite, carried = 0, i, j;
+
+  memset(order, 0, num_lastranks * sizeof(*order));
+  for (i = 0; i < n; i++)
+    {
+      vissprite_t *vis = vissprites + i;
+      unsigned h = R_SpriteHash(vis->thing);
+      int rank = -1;
+
+      for (; lastranks[h].stamp == rankstamp; h = (h+1) & (num_vissprite_alloc*2 - 1))
+        if (lastranks[h].thing == vis->thing)
+          {
+            rank = lastranks[h].rank;
+            break;
+          }
+
+      if (rank >= 0 && rank < num_lastranks && !order[rank])
+        order[rank] = vis, carried++;
+      else
+        vissprite_ptrs[n - 1 - (i - carried)] = vis;  // newcomers fill from the end
+    }
+
+  for (i = j = 0; j < carried; i++)
+    if (order[i])
+      vissprite_ptrs[j++] = order[i];
+  for (i = carried, j = n - 1; i < j; i++, j--)
+    {
+      vissprite_t *t = vissprite_ptrs[i];
+      vissprite_ptrs[i] = vissprite_ptrs[j];
+      vissprite_ptrs[j] = t;
+    }
+}
+
+// Insertion sort, which gives up once it has moved sprites more places
+// than msort would have taken; returns false then.
+static boolean R_RepairSpriteOrder(vissprite_t **s, int n)
+{
+  int budget = n * 8, i;
+
+  for (i = 1; i < n; i++)
+    {
+      vissprite_t *temp = s[i];
+      if (SPRITE_BEFORE(temp, s[i-1]))
+        {
+          int j = i;
+          do
+            s[j] = s[j-1], rendered_sortmoves++, budget--;
+          while (--j && SPRITE_BEFORE(temp, s[j-1]));
+          s[j] = temp;
+          if (budget < 0)
+            return false;
+        }
+    }
+  return true;
+}
+
+// Remembers this frame's order for the next one
+static void R_SaveSpriteOrder(void)
+{
+  int i;
+
+  rankstamp++;
+  for (i = 0; i < (int)num_vissprite; i++)
+    {
+      unsigned h = R_SpriteHash(vissprite_ptrs[i]->thing);
+
+      while (lastranks[h].stamp == rankstamp)
+        h = (h+1) & (num_vissprite_alloc*2 - 1);
+      lastranks[h].thing = vissprite_ptrs[i]->thing;
+      lastranks[h].rank = i;
+      lastranks[h].stamp = rankstamp;
+    }
+  num_lastranks = num_vissprite;
+}
+
 void R_SortVisSprites (void)
 {
+  rendered_sortsprites = num_vissprite;
+  rendered_sortmoves = rendered_fullsorts = 0;
+
   if (num_vissprite)
     {
-      int i = num_vissprite;
+      // The depth order hardly changes from one tic to the next, so start
+      // from last frame's and let insertion sort repair it. A jump to a new
+      // view, or a crowd coming into sight, is left to the merge sort.
 
-      // If we need to allocate more pointers for the vissprites,
-      // allocate as many as were allocated for sprites -- killough
-      // killough 9/22/98: allocate twice as many
-
-      if (num_vissprite_ptrs < num_vissprite*2)
+      if (r_spriteorder)
+        R_CarrySpriteOrder();
+      else
         {
-          free(vissprite_ptrs);  // better than realloc -- no preserving needed
-          vissprite_ptrs = malloc((num_vissprite_ptrs = num_vissprite_alloc*2)
-                                  * sizeof *vissprite_ptrs);
+          int i = num_vissprite;
+          while (--i>=0)
+            vissprite_ptrs[i] = vissprites+i;
         }
 
-      while (--i>=0)
-        vissprite_ptrs[i] = vissprites+i;
+      if (!r_spriteorder || !R_RepairSpriteOrder(vissprite_ptrs, num_vissprite))
+        {
+          // killough 9/22/98: replace qsort with merge sort, since the keys
+          // are roughly in order to begin with, due to BSP rendering.
 
-      // killough 9/22/98: replace qsort with merge sort, since the keys
-      // are roughly in order to begin with, due to BSP rendering.
+          msort(vissprite_ptrs, vissprite_ptrs + num_vissprite_alloc,
+                num_vissprite);
+          rendered_fullsorts = 1;
+        }
 
-      msort(vissprite_ptrs, vissprite_ptrs + num_vissprite, num_vissprite);
+      if (r_spriteorder)
+        R_SaveSpriteOrder();
     }
+  else
+    num_lastranks = 0;
 }
 
 //
@@ -928,8 +1215,13 @@ static void R_DrawSprite (vissprite_t* spr)
   int     r2;
   fixed_t scale;
   fixed_t lowscale;
+  int     x1 = MAX(spr->x1, r_stripx1); // the part in this thread's strip
+  int     x2 = MIN(spr->x2, r_stripx2);
+
+  if (x1 > x2)
+    return;
 
-  for (x = spr->x1 ; x<=spr->x2 ; x++)
+  for (x = x1 ; x<=x2 ; x++)
     clipbot[x] = cliptop[x] = -2;
 
   // Scan drawsegs from end to start for obscuring segs.
@@ -943,12 +1235,12 @@ static void R_DrawSprite (vissprite_t* spr)
 
   for (ds=ds_p ; ds-- > drawsegs ; )  // new -- killough
     {      // determine if the drawseg obscures the sprite
-      if (ds->x1 > spr->x2 || ds->x2 < spr->x1 ||
+      if (ds->x1 > x2 || ds->x2 < x1 ||
           (!ds->silhouette && !ds->maskedtexturecol))
         continue;      // does not cover sprite
 
-      r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
-      r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
+      r1 = ds->x1 < x1 ? x1 : ds->x1;
+      r2 = ds->x2 > x2 ? x2 : ds->x2;
 
       if (ds->scale1 > ds->scale2)
         {
@@ -998,13 +1290,13 @@ static void R_DrawSprite (vissprite_t* spr)
           (h >>= FRACBITS) < viewheight) {
         if (mh <= 0 || (phs != -1 && viewz > sectors[phs].floorheight))
           {                          // clip bottom
-            for (x=spr->x1 ; x<=spr->x2 ; x++)
+            for (x=x1 ; x<=x2 ; x++)
               if (clipbot[x] == -2 || h < clipbot[x])
                 clipbot[x] = h;
           }
         else                        // clip top
     if (phs != -1 && viewz <= sectors[phs].floorheight) // killough 11/98
-      for (x=spr->x1 ; x<=spr->x2 ; x++)
+      for (x=x1 ; x<=x2 ; x++)
         if (cliptop[x] == -2 || h > cliptop[x])
     cliptop[x] = h;
       }
@@ -1014,12 +1306,12 @@ static void R_DrawSprite (vissprite_t* spr)
           (h >>= FRACBITS) < viewheight) {
         if (phs != -1 && viewz >= sectors[phs].ceilingheight)
           {                         // clip bottom
-            for (x=spr->x1 ; x<=spr->x2 ; x++)
+            for (x=x1 ; x<=x2 ; x++)
               if (clipbot[x] == -2 || h < clipbot[x])
                 clipbot[x] = h;
           }
         else                       // clip top
-          for (x=spr->x1 ; x<=spr->x2 ; x++)
+          for (x=x1 ; x<=x2 ; x++)
             if (cliptop[x] == -2 || h > cliptop[x])
               cliptop[x] = h;
       }
@@ -1029,7 +1321,7 @@ static void R_DrawSprite (vissprite_t* spr)
   // all clipping has been performed, so draw the sprite
   // check for unclipped columns
 
-  for (x = spr->x1 ; x<=spr->x2 ; x++) {
+  for (x = x1 ; x<=x2 ; x++) {
     if (clipbot[x] == -2)
       clipbot[x] = viewheight;
 
@@ -1039,7 +1331,7 @@ static void R_DrawSprite (vissprite_t* spr)
 
   mfloorclip = clipbot;
   mceilingclip = cliptop;
-  R_DrawVisSprite (spr, spr->x1, spr->x2);
+  R_DrawVisSprite (spr, x1, x2);
 }
 
 //
@@ -1050,8 +1342,11 @@ void R_DrawMasked(void)
 {
   int i;
   drawseg_t *ds;
+  unsigned long sortstart = benchmark ? I_GetTimeUS() : 0;
 
   R_SortVisSprites();
+  if (benchmark)
+    rendered_sortus = I_GetTimeUS() - sortstart;
 
   // draw all vissprites back to front
 
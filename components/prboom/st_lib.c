@@ -38,6 +38,7 @@
 #include "st_stuff.h"
 #include "st_lib.h"
 #include "r_main.h"
+#include "r_patch.h"
 #include "lprintf.h"
 
 int sts_always_red;      //jff 2/18/98 control to disable status color changes
@@ -51,6 +52,17 @@ void STlib_init(void)
   // cph - no longer hold STMINUS pointer
 }
 
+//
+// STlib_markPatch()
+//
+// Tells the status bar where a patch drawn at x,y lands, so that the
+// display can send just that
+//
+static void STlib_markPatch(int x, int y, const patchnum_t* p)
+{
+  ST_MarkDirty(x - p->leftoffset, y - p->topoffset, p->width, p->height);
+}
+
 //
 // STlib_initNum()
 //
@@ -134,6 +146,7 @@ static void STlib_drawNum
 #endif
 
   V_CopyRect(x, n->y - ST_Y, BG, w*numdigits, h, x, n->y, FG, VPT_STRETCH);
+  ST_MarkDirty(x, n->y, w*numdigits, h);
 
   // if non-number, do not draw it
   if (num == 1994)
@@ -143,10 +156,12 @@ static void STlib_drawNum
 
   //jff 2/16/98 add color translation to digit output
   // in the special case of 0, you draw 0
-  if (!num)
+  if (!num) {
     // CPhipps - patch drawing updated, reformatted
     V_DrawNumPatch(x - w, n->y, FG, n->p[0].lumpnum, cm,
        (((cm!=CR_DEFAULT) && !sts_always_red) ? VPT_TRANS : VPT_NONE) | VPT_STRETCH);
+    STlib_markPatch(x - w, n->y, &n->p[0]);
+  }
 
   // draw the new number
   //jff 2/16/98 add color translation to digit output
@@ -155,15 +170,23 @@ static void STlib_drawNum
     x -= w;
     V_DrawNumPatch(x, n->y, FG, n->p[num % 10].lumpnum, cm,
        (((cm!=CR_DEFAULT) && !sts_always_red) ? VPT_TRANS : VPT_NONE) | VPT_STRETCH);
+    STlib_markPatch(x, n->y, &n->p[num % 10]);
     num /= 10;
   }
 
   // draw a minus sign if necessary
   //jff 2/16/98 add color translation to digit output
   // cph - patch drawing updated, load by name instead of acquiring pointer earlier
-  if (neg)
-    V_DrawNamePatch(x - w, n->y, FG, "STTMINUS", cm,
+  if (neg) {
+    int lump = W_GetNumForName("STTMINUS");
+    const rpatch_t *minus = R_CachePatchNum(lump);
+
+    ST_MarkDirty(x - w - minus->leftoffset, n->y - minus->topoffset,
+                 minus->width, minus->height);
+    R_UnlockPatchNum(lump);
+    V_DrawNumPatch(x - w, n->y, FG, lump, cm,
        (((cm!=CR_DEFAULT) && !sts_always_red) ? VPT_TRANS : VPT_NONE) | VPT_STRETCH);
+  }
 }
 
 /*
@@ -232,6 +255,7 @@ void STlib_updatePercent
     V_DrawNumPatch(per->n.x, per->n.y, FG, per->p->lumpnum,
        sts_pct_always_gray ? CR_GRAY : cm,
        (sts_always_red ? VPT_NONE : VPT_TRANS) | VPT_STRETCH);
+    STlib_markPatch(per->n.x, per->n.y, per->p);
   }
 
   STlib_updateNum(&per->n, cm, refresh);
@@ -297,9 +321,13 @@ void STlib_updateMultIcon
 #endif
 
       V_CopyRect(x, y-ST_Y, BG, w, h, x, y, FG, VPT_STRETCH);
+      ST_MarkDirty(x, y, w, h);
     }
     if (*mi->inum != -1)  // killough 2/16/98: redraw only if != -1
+    {
       V_DrawNumPatch(mi->x, mi->y, FG, mi->p[*mi->inum].lumpnum, CR_DEFAULT, VPT_STRETCH);
+      STlib_markPatch(mi->x, mi->y, &mi->p[*mi->inum]);
+    }
     mi->oldinum = *mi->inum;
   }
 }
@@ -368,6 +396,7 @@ void STlib_updateBinIcon
       V_DrawNumPatch(bi->x, bi->y, FG, bi->p->lumpnum, CR_DEFAULT, VPT_STRETCH);
     else
       V_CopyRect(x, y-ST_Y, BG, w, h, x, y, FG, VPT_STRETCH);
+    ST_MarkDirty(x, y, w, h);
 
     bi->oldval = *bi->val;
   }
@@ -47,6 +47,7 @@
 #include "sounds.h"
 #include "dstrings.h"
 #include "r_draw.h"
+#include "lprintf.h"
 
 //
 // STATUS BAR DATA
@@ -383,6 +384,146 @@ extern char     *mapnames[];
 
 static void ST_Stop(void);
 
+//
+// The widgets are drawn into a buffer of the status bar's own, screens[FG],
+// rather than into the frame. It keeps its contents across page flips, so
+// only what changed needs redrawing, and each frame gets a copy. It holds
+// the frame from a row above ST_SCALED_Y, for the widgets at ST_Y that
+// stretch onto that row (which the copy leaves to the view), and
+// screens[FG].top lets the widgets keep drawing in frame coordinates.
+//
+// What the widgets redraw is also collected as rects in screen pixels, so a
+// display that keeps the last frame only needs those below the view.
+//
+#define ST_COMPOSITE_Y (ST_SCALED_Y - 1)
+
+static byte *st_composite;
+static int st_compositepitch;
+
+static stdirty_t st_dirty[ST_MAXDIRTY];
+static int st_numdirty;
+static boolean st_drawn;           // the status bar is in the current frame
+static boolean st_sendall = true;  // the display shows something else there
+static stdamagestats_t st_damagestats;
+
+static void ST_initComposite(void)
+{
+  if (st_composite && st_compositepitch == screens[0].byte_pitch)
+    return;
+
+  free(st_composite);
+  st_compositepitch = screens[0].byte_pitch;
+  st_composite = malloc(st_compositepitch * (SCREENHEIGHT - ST_COMPOSITE_Y));
+  if (!st_composite)
+    I_Error("ST_initComposite: no memory for the status bar composite");
+  screens[FG].data = st_composite;
+  screens[FG].not_on_heap = true;
+  screens[FG].width = SCREENWIDTH;
+  screens[FG].height = SCREENHEIGHT - ST_COMPOSITE_Y;
+  screens[FG].top = ST_COMPOSITE_Y;
+  screens[FG].byte_pitch = st_compositepitch;
+  screens[FG].short_pitch = st_compositepitch / V_GetModePixelDepth(VID_MODE16);
+  screens[FG].int_pitch = st_compositepitch / V_GetModePixelDepth(VID_MODE32);
+  st_firsttime = true;
+}
+
+static void ST_unionRect(stdirty_t *r, const stdirty_t *s)
+{
+  int x2 = MAX(r->x + r->w, s->x + s->w);
+  int y2 = MAX(r->y + r->h, s->y + s->h);
+
+  r->x = MIN(r->x, s->x);
+  r->y = MIN(r->y, s->y);
+  r->w = x2 - r->x;
+  r->h = y2 - r->y;
+}
+
+void ST_MarkDirty(int x, int y, int w, int h)
+{
+  stdirty_t r;
+  int i;
+
+  // a pixel of slack each side for how the stretched drawing rounds
+  r.x = MAX(x * SCREENWIDTH / 320 - 1, 0);
+  r.y = MAX(y * SCREENHEIGHT / 200 - 1, ST_SCALED_Y);
+  r.w = MIN((x + w) * SCREENWIDTH / 320 + 1, SCREENWIDTH) - r.x;
+  r.h = MIN((y + h) * SCREENHEIGHT / 200 + 1, SCREENHEIGHT) - r.y;
+  if (r.w <= 0 || r.h <= 0)
+    return;
+
+  // take in every rect this one touches
+  for (i = 0; i < st_numdirty; )
+  {
+    const stdirty_t *d = &st_dirty[i];
+
+    if (d->x <= r.x + r.w && r.x <= d->x + d->w &&
+        d->y <= r.y + r.h && r.y <= d->y + d->h)
+    {
+      ST_unionRect(&r, d);
+      st_dirty[i] = st_dirty[--st_numdirty];
+      i = 0;
+    }
+    else
+      i++;
+  }
+
+  // no room: merge with the one that grows least
+  if (st_numdirty == ST_MAXDIRTY)
+  {
+    int best = 0, bestgrowth = INT_MAX;
+
+    for (i = 0; i < st_numdirty; i++)
+    {
+      stdirty_t u = r;
+      int growth;
+
+      ST_unionRect(&u, &st_dirty[i]);
+      growth = u.w * u.h - st_dirty[i].w * st_dirty[i].h;
+      if (growth < bestgrowth)
+        bestgrowth = growth, best = i;
+    }
+    ST_unionRect(&r, &st_dirty[best]);
+    st_dirty[best] = st_dirty[--st_numdirty];
+  }
+  st_dirty[st_numdirty++] = r;
+}
+
+void ST_Overdrawn(void)
+{
+  st_drawn = false;
+}
+
+int ST_GetDirtyRects(stdirty_t *rects)
+{
+  int i, n = -1;
+
+  if (st_drawn)
+  {
+    st_damagestats.frames++;
+    if (st_sendall)
+      st_damagestats.fullframes++;
+    else
+    {
+      n = st_numdirty;
+      for (i = 0; i < n; i++)
+      {
+        rects[i] = st_dirty[i];
+        st_damagestats.pixels += rects[i].w * rects[i].h;
+      }
+      st_damagestats.rects += n;
+    }
+  }
+  st_sendall = !st_drawn;
+  st_drawn = false;
+  st_numdirty = 0;
+  return n;
+}
+
+void ST_GetDamageStats(stdamagestats_t *stats)
+{
+  *stats = st_damagestats;
+}
+
 static void ST_refreshBackground(void)
 {
   int y=0;
@@ -404,6 +545,7 @@ static void ST_refreshBackground(void)
            displayplayer ? (VPT_TRANS | VPT_STRETCH) : VPT_STRETCH);
       }
       V_CopyRect(ST_X, y, BG, ST_SCALED_WIDTH, ST_SCALED_HEIGHT, ST_X, ST_SCALED_Y, FG, VPT_NONE);
+      ST_MarkDirty(ST_X, ST_Y, ST_WIDTH, ST_HEIGHT);
     }
 }
 
@@ -849,10 +991,17 @@ void ST_Drawer(boolean statusbaron, boolean refresh)
   ST_doPaletteStuff();  // Do red-/gold-shifts from damage/items
 
   if (statusbaron) {
+    if (V_GetMode() != VID_MODEGL)
+      ST_initComposite();
     if (st_firsttime || (V_GetMode() == VID_MODEGL))
       ST_doRefresh();     /* If just after ST_Start(), refresh all */
     else
       ST_diffDraw();      /* Otherwise, update as little as possible */
+    if (V_GetMode() != VID_MODEGL) {
+      V_CopyRect(0, ST_SCALED_Y, FG, SCREENWIDTH, ST_SCALED_HEIGHT,
+                 0, ST_SCALED_Y, 0, VPT_NONE);
+      st_drawn = true;
+    }
   }
 }
 
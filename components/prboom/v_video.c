@@ -138,6 +138,8 @@ static void FUNC_V_CopyRect(int srcx, int srcy, int srcscrn, int width,
     I_Error ("V_CopyRect: Bad arguments");
 #endif
 
+  srcy -= screens[srcscrn].top;
+  desty -= screens[destscrn].top;
   src = screens[srcscrn].data+screens[srcscrn].byte_pitch*srcy+srcx*V_GetPixelDepth();
   dest = screens[destscrn].data+screens[destscrn].byte_pitch*desty+destx*V_GetPixelDepth();
 
@@ -239,6 +241,7 @@ void V_Init (void)
     screens[i].byte_pitch = 0;
     screens[i].short_pitch = 0;
     screens[i].int_pitch = 0;
+    screens[i].top = 0;
   }
 }
 
@@ -277,10 +280,10 @@ static void IRAM_ATTR V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *pat
 
   if (V_GetMode() == VID_MODE8 && !(flags & VPT_STRETCH)) {
     int             col;
-    byte           *desttop = screens[scrn].data+y*screens[scrn].byte_pitch+x*V_GetPixelDepth();
+    byte           *desttop = screens[scrn].data+(y-screens[scrn].top)*screens[scrn].byte_pitch+x*V_GetPixelDepth();
     unsigned int    w = patch->width;
 
-    if (y<0 || y+patch->height > ((flags & VPT_STRETCH) ? 200 :  SCREENHEIGHT)) {
+    if (y<screens[scrn].top || y+patch->height > ((flags & VPT_STRETCH) ? 200 :  SCREENHEIGHT)) {
       // killough 1/19/98: improved error message:
       lprintf(LO_WARN, "V_DrawMemPatch8: Patch (%d,%d)-(%d,%d) exceeds LFB in vertical direction (horizontal is clipped)\n"
               "Bad V_DrawMemPatch8 (flags=%u)", x, y, x+patch->width, y+patch->height, flags);
@@ -301,10 +304,10 @@ static void IRAM_ATTR V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *pat
 
       // step through the posts in a column
       for (i=0; i<column->numPosts; i++) {
-        const rpost_t *post = &column->posts[i];
+        const rpost_t *post = &R_ColumnPosts(column)[i];
         // killough 2/21/98: Unrolled and performance-tuned
 
-        const byte *source = column->pixels + post->topdelta;
+        const byte *source = R_ColumnPixels(column) + post->topdelta;
         byte *dest = desttop + post->topdelta*screens[scrn].byte_pitch;
         int count = post->length;
 
@@ -435,14 +438,14 @@ static void IRAM_ATTR V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *pat
 
       // step through the posts in a column
       for (i=0; i<column->numPosts; i++) {
-        const rpost_t *post = &column->posts[i];
+        const rpost_t *post = &R_ColumnPosts(column)[i];
         int yoffset = 0;
 
         dcvars.yl = (((y + post->topdelta) * DY)>>FRACBITS);
         dcvars.yh = (((y + post->topdelta + post->length) * DY - (FRACUNIT>>1))>>FRACBITS);
         dcvars.edgeslope = post->slope;
 
-        if ((dcvars.yh < 0) || (dcvars.yh < top))
+        if ((dcvars.yh < screens[scrn].top) || (dcvars.yh < top))
           continue;
         if ((dcvars.yl >= SCREENHEIGHT) || (dcvars.yl >= bottom))
           continue;
@@ -456,9 +459,9 @@ static void IRAM_ATTR V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *pat
           dcvars.edgeslope &= ~RDRAW_EDGESLOPE_BOT_MASK;
         }
 
-        if (dcvars.yl < 0) {
-          yoffset = 0-dcvars.yl;
-          dcvars.yl = 0;
+        if (dcvars.yl < screens[scrn].top) {
+          yoffset = screens[scrn].top-dcvars.yl;
+          dcvars.yl = screens[scrn].top;
           dcvars.edgeslope &= ~RDRAW_EDGESLOPE_TOP_MASK;
         }
         if (dcvars.yl < top) {
@@ -467,10 +470,12 @@ static void IRAM_ATTR V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *pat
           dcvars.edgeslope &= ~RDRAW_EDGESLOPE_TOP_MASK;
         }
 
-        dcvars.source = column->pixels + post->topdelta + yoffset;
-        dcvars.prevsource = prevcolumn ? prevcolumn->pixels + post->topdelta + yoffset: dcvars.source;
-        dcvars.nextsource = nextcolumn ? nextcolumn->pixels + post->topdelta + yoffset: dcvars.source;
+        dcvars.source = R_ColumnPixels(column) + post->topdelta + yoffset;
+        dcvars.prevsource = prevcolumn ? R_ColumnPixels(prevcolumn) + post->topdelta + yoffset: dcvars.source;
+        dcvars.nextsource = nextcolumn ? R_ColumnPixels(nextcolumn) + post->topdelta + yoffset: dcvars.source;
 
+        dcvars.yl -= screens[scrn].top;
+        dcvars.yh -= screens[scrn].top;
         dcvars.texturemid = -((dcvars.yl-centery)*dcvars.iscale);
 
         colfunc(&dcvars);
@@ -570,34 +575,39 @@ void V_UpdateTrueColorPalette(video_mode_t mode) {
     V_Palette32 = Palettes32 + paletteNum*256*VID_NUMCOLORWEIGHTS;
   }
   else if (mode == VID_MODE16) {
-    if (!Palettes16) {
+    // Only the palette in use is kept, all 14 of them would take 448K.
+    // Palette changes are a few per second at most.
+    static int palettes16Num = -1;
+    if (!Palettes16 || palettes16Num != paletteNum) {
       // set short palette
-      Palettes16 = (short*)malloc(numPals*256*sizeof(short)*VID_NUMCOLORWEIGHTS);
-      for (p=0; p<numPals; p++) {
-        for (i=0; i<256; i++) {
-          r = gtable[pal[(256*p+i)*3+0]];
-          g = gtable[pal[(256*p+i)*3+1]];
-          b = gtable[pal[(256*p+i)*3+2]];
-          
-          // ideally, we should always round up, but very bright colors
-          // overflow the blending adds, so they don't get rounded.
-          roundUpR = (r > dontRoundAbove) ? 0 : 0.5f;
-          roundUpG = (g > dontRoundAbove) ? 0 : 0.5f;
-          roundUpB = (b > dontRoundAbove) ? 0 : 0.5f;
-                   
-          for (w=0; w<VID_NUMCOLORWEIGHTS; w++) {
-            t = (float)(w)/(float)(VID_NUMCOLORWEIGHTS-1);
-            nr = (int)((r>>3)*t+roundUpR);
-            ng = (int)((g>>2)*t+roundUpG);
-            nb = (int)((b>>3)*t+roundUpB);
-            Palettes16[((p*256+i)*VID_NUMCOLORWEIGHTS)+w] = (
-              (nr<<11) | (ng<<5) | nb
-            );
-          }
+      if (!Palettes16)
+        Palettes16 = (short*)malloc(256*sizeof(short)*VID_NUMCOLORWEIGHTS);
+      palettes16Num = paletteNum;
+      p = paletteNum;
+      for (i=0; i<256; i++) {
+        // no gamma, like the LCD palette of the 8 bit mode, so both look alike
+        r = pal[(256*p+i)*3+0];
+        g = pal[(256*p+i)*3+1];
+        b = pal[(256*p+i)*3+2];
+        
+        // ideally, we should always round up, but very bright colors
+        // overflow the blending adds, so they don't get rounded.
+        roundUpR = (r > dontRoundAbove) ? 0 : 0.5f;
+        roundUpG = (g > dontRoundAbove) ? 0 : 0.5f;
+        roundUpB = (b > dontRoundAbove) ? 0 : 0.5f;
+                 
+        for (w=0; w<VID_NUMCOLORWEIGHTS; w++) {
+          t = (float)(w)/(float)(VID_NUMCOLORWEIGHTS-1);
+          nr = (int)((r>>3)*t+roundUpR);
+          ng = (int)((g>>2)*t+roundUpG);
+          nb = (int)((b>>3)*t+roundUpB);
+          Palettes16[(i*VID_NUMCOLORWEIGHTS)+w] = VID_SWAP16(
+            (nr<<11) | (ng<<5) | nb
+          );
         }
       }
     }
-    V_Palette16 = Palettes16 + paletteNum*256*VID_NUMCOLORWEIGHTS;
+    V_Palette16 = Palettes16;
   }
   else if (mode == VID_MODE15) {
     if (!Palettes15) {
@@ -75,18 +75,38 @@ void W_PrintLump(FILE* fp, void* p) {
 }
 #endif
 
-#ifdef TIMEDIAG
-static void W_ReportLocks(void)
+void W_ReportLocks(void)
 {
   int i;
-  lprintf(LO_DEBUG, "W_ReportLocks:\nLump     Size   Locks  Tics\n");
+#ifdef TIMEDIAG
+  lprintf(LO_INFO, "W_ReportLocks:\nLump     Size   Locks  Tics\n");
+#else
+  lprintf(LO_INFO, "W_ReportLocks:\nLump     Size   Locks\n");
+#endif
   for (i=0; i<numlumps; i++) {
     if (cachelump[i].locks > 0)
-      lprintf(LO_DEBUG, "%8.8s %6u %2d   %6d\n", lumpinfo[i].name,
+#ifdef TIMEDIAG
+      lprintf(LO_INFO, "%8.8s %6u %2d   %6d\n", lumpinfo[i].name,
         W_LumpLength(i), cachelump[i].locks, gametic - cachelump[i].locktic);
+#else
+      lprintf(LO_INFO, "%8.8s %6u %2d\n", lumpinfo[i].name,
+        W_LumpLength(i), cachelump[i].locks);
+#endif
   }
 }
-#endif
+
+void W_GetLockCensus(census_t *copies, unsigned *locked, unsigned *locks)
+{
+  int i;
+
+  Z_CensusOwners(cachelump, cachelump + numlumps, copies);
+  *locked = *locks = 0;
+  for (i=0; i<numlumps; i++)
+    if (cachelump[i].locks > 0) {
+      (*locked)++;
+      *locks += cachelump[i].locks;
+    }
+}
 
 void W_InitCache(void)
 {
@@ -118,12 +138,16 @@ W_UnlockLumpNum decreases it and if it's -1 it can un-mmap the lump. NOTE: W_Loc
 
 const void* W_CacheLumpNum(int lump)
 {
+	const void *adr;
+
 #ifdef RANGECHECK
   if ((unsigned)lump >= (unsigned)numlumps)
     I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
 #endif
-	cachelump[lump].mmapadr=I_Mmap(NULL, W_LumpLength(lump), 0, 0, lumpinfo[lump].wadfile->handle, lumpinfo[lump].position);
-	return (char*)cachelump[lump].mmapadr;
+	I_LockShared(); // render threads cache flats and patches concurrently
+	adr=cachelump[lump].mmapadr=I_Mmap(NULL, W_LumpLength(lump), 0, 0, lumpinfo[lump].wadfile->handle, lumpinfo[lump].position);
+	I_UnlockShared();
+	return adr;
 }
 
 /*
@@ -169,7 +193,9 @@ const void* W_LockLumpNum(int lump)
 void W_UnlockLumpNum(int lump) {
   if (cachelump[lump].locks == -1) {
     // this lump is memory mapped
+    I_LockShared();
     I_Munmap(cachelump[lump].mmapadr, W_LumpLength(lump));
+    I_UnlockShared();
     return;
   }
 #ifdef SIMPLECHECKS
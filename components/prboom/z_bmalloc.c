@@ -28,6 +28,12 @@
  *
  * DESCRIPTION:
  * This is designed to be a fast allocator for small, regularly used block sizes
+ *
+ * Pools are aligned to their power of two size, so the pool a block belongs
+ * to is found by masking its address. A pool keeps a bitmap of the blocks
+ * in use; only pools with a free block are on the zone's list, so the first
+ * pool on it always has one, found by counting trailing ones in its bitmap.
+ * Pools are not freed when they empty, only with the zone's tag.
  *-----------------------------------------------------------------------------
  */
 
@@ -35,89 +41,118 @@
 #include "config.h"
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "doomtype.h"
 #include "z_zone.h"
 #include "z_bmalloc.h"
 #include "lprintf.h"
 
+// Most pools allocated at once, see Z_BNewPools
+#define MAXSLABPOOLS 16
+
 typedef struct bmalpool_s {
-  struct bmalpool_s *nextpool;
-  size_t             blocks;
-  byte               used[0];
+  struct bmalpool_s *nextpool;             // pools with a free block
+  unsigned           free;
+  uint32_t           used[1];              // really (blocks+31)/32 words
 } bmalpool_t;
 
-inline static void* getelem(bmalpool_t *p, size_t size, size_t n)
+#define POOLHEADER(words) \
+  ((offsetof(bmalpool_t, used) + (words)*sizeof(uint32_t) + 7) & ~7)
+
+inline static byte *getelem(const struct block_memory_alloc_s *pzone, bmalpool_t *p, size_t n)
 {
-  return (((byte*)p) + sizeof(bmalpool_t) + sizeof(byte)*(p->blocks) + size*n);
+  return (byte *)p + pzone->header + pzone->size*n;
 }
 
-inline static PUREFUNC int iselem(const bmalpool_t *pool, size_t size, const void* p)
+// Picks the pool size: the power of two holding at least perpool blocks,
+// filled up with as many as fit.
+static void Z_BSetup(struct block_memory_alloc_s *pzone)
 {
-  // CPhipps - need portable # of bytes between pointers
-  int dif = (const char*)p - (const char*)pool;
-
-  dif -= sizeof(bmalpool_t);
-  dif -= pool->blocks;
-  if (dif<0) return -1;
-  dif /= size;
-  return (((size_t)dif >= pool->blocks) ? -1 : dif);
+  size_t blocks = pzone->perpool, span = 64;
+
+  while (span < POOLHEADER((blocks+31)/32) + blocks*pzone->size)
+    span <<= 1;
+  while (POOLHEADER((blocks+32)/32) + (blocks+1)*pzone->size <= span)
+    blocks++;
+
+  pzone->span = span;
+  pzone->blocks = blocks;
+  pzone->header = POOLHEADER((blocks+31)/32);
 }
 
-enum { unused_block = 0, used_block = 1};
+// Pools are allocated a slab at a time, twice as many each time up to
+// MAXSLABPOOLS, so the slack lost to aligning the slab stays small.
+static bmalpool_t *Z_BNewPools(struct block_memory_alloc_s *pzone)
+{
+  int count = pzone->slabpools ? pzone->slabpools : 1;
+  size_t words = (pzone->blocks+31)/32;
+  byte *slab;
+  int i;
+
+  if (!pzone->span)
+    Z_BSetup(pzone);
+
+  slab = Z_Malloc((count+1)*pzone->span, pzone->tag, NULL);
+  slab = (byte *)(((uintptr_t)slab + pzone->span-1) & ~(uintptr_t)(pzone->span-1));
+
+  for (i = count; i--; )
+  {
+    bmalpool_t *pool = (bmalpool_t *)(slab + i*pzone->span);
+
+    memset(pool->used, 0, words*sizeof(uint32_t));
+    if (pzone->blocks & 31)     // bits past the last block stay set
+      pool->used[words-1] = ~0u << (pzone->blocks & 31);
+    pool->free = pzone->blocks;
+    pool->nextpool = pzone->firstpool;
+    pzone->firstpool = pool;
+  }
+
+  if (count < MAXSLABPOOLS)
+    pzone->slabpools = count*2;
+  return pzone->firstpool;
+}
 
 void* Z_BMalloc(struct block_memory_alloc_s *pzone)
 {
-  register bmalpool_t **pool = (bmalpool_t **)&(pzone->firstpool);
-  while (*pool != NULL) {
-    byte *p = memchr((*pool)->used, unused_block, (*pool)->blocks); // Scan for unused marker
-    if (p) {
-      int n = p - (*pool)->used;
-#ifdef SIMPLECHECKS
-      if ((n<0) || ((size_t)n>=(*pool)->blocks))
-  I_Error("Z_BMalloc: memchr returned pointer outside of array");
-#endif
-      (*pool)->used[n] = used_block;
-      return getelem(*pool, pzone->size, n);
-    } else
-      pool = &((*pool)->nextpool);
-  }
-  {
-    // Nothing available, must allocate a new pool
-    bmalpool_t *newpool;
+  bmalpool_t *pool = pzone->firstpool;
+  uint32_t *word;
+  int bit;
 
-    // CPhipps: Allocate new memory, initialised to 0
+  if (!pool)
+    pool = Z_BNewPools(pzone);
 
-    *pool = newpool = Z_Calloc(sizeof(*newpool) + (sizeof(byte) + pzone->size)*(pzone->perpool),
-             1,  pzone->tag, NULL);
-    newpool->nextpool = NULL; // NULL = (void*)0 so this is redundant
+  for (word = pool->used; !~*word; word++)
+    ;
+  bit = __builtin_ctz(~*word);
+  *word |= 1u << bit;
 
-    // Return element 0 from this pool to satisfy the request
-    newpool->used[0] = used_block;
-    newpool->blocks = pzone->perpool;
-    return getelem(newpool, pzone->size, 0);
+  if (!--pool->free)
+  {
+    // full, off the list until a block is freed
+    pzone->firstpool = pool->nextpool;
   }
+  return getelem(pzone, pool, (word - pool->used)*32 + bit);
 }
 
 void Z_BFree(struct block_memory_alloc_s *pzone, void* p)
 {
-  register bmalpool_t **pool = (bmalpool_t**)&(pzone->firstpool);
+  bmalpool_t *pool = (bmalpool_t *)((uintptr_t)p & ~(uintptr_t)(pzone->span-1));
+  size_t n = ((byte *)p - getelem(pzone, pool, 0)) / pzone->size;
 
-  while (*pool != NULL) {
-    int n = iselem(*pool, pzone->size, p);
-    if (n >= 0) {
 #ifdef SIMPLECHECKS
-      if ((*pool)->used[n] == unused_block)
-  I_Error("Z_BFree: Refree in zone %s", pzone->desc);
+  if (!pzone->span || n >= pzone->blocks)
+    I_Error("Z_BFree: Free not in zone %s", pzone->desc);
+  if (!(pool->used[n/32] & (1u << (n&31))))
+    I_Error("Z_BFree: Refree in zone %s", pzone->desc);
 #endif
-      (*pool)->used[n] = unused_block;
-      if (memchr(((*pool)->used), used_block, (*pool)->blocks) == NULL) {
-  // Block is all unused, can be freed
-  bmalpool_t *oldpool = *pool;
-  *pool = (*pool)->nextpool;
-  Z_Free(oldpool);
-      }
-      return;
-    } else pool = &((*pool)->nextpool);
+  pool->used[n/32] &= ~(1u << (n&31));
+
+  if (!pool->free++)
+  {
+    // had been full, back on the list
+    pool->nextpool = pzone->firstpool;
+    pzone->firstpool = pool;
   }
-  I_Error("Z_BFree: Free not in zone %s", pzone->desc);
 }
@@ -55,6 +55,7 @@
 #include "v_video.h"
 #include "g_game.h"
 #include "lprintf.h"
+#include "i_system.h"
 
 #ifdef DJGPP
 #include <dpmi.h>
@@ -83,6 +84,16 @@
 // Number of mallocs & frees kept in history buffer (must be a power of 2)
 #define ZONE_HISTORY 4
 
+// Bump allocate PU_LEVEL and PU_LEVSPEC blocks from arenas reset per level
+#define ZONE_ARENAS
+
+// Size of the chunks the level arenas grow by, in slow and in fast RAM
+#define ARENA_CHUNK (64*1024)
+#define ARENA_FAST_CHUNK (8*1024)
+
+// Largest block (header excluded) recycled when freed and put in fast RAM
+#define ARENA_SMALL 512
+
 // End Tunables
 
 typedef struct memblock {
@@ -95,6 +106,8 @@ typedef struct memblock {
   size_t size;
   void **user;
   unsigned char tag;
+  unsigned char arena;        // ARENA_NONE if malloc'ed
+  unsigned char fast;         // in fast internal RAM, for the census
 
 #ifdef INSTRUMENTED
   const char *file;
@@ -110,6 +123,248 @@ static const size_t HEADER_SIZE = (sizeof(memblock_t)+CHUNK_SIZE-1) & ~(CHUNK_SI
 
 static memblock_t *blockbytag[PU_MAX];
 
+enum {ARENA_NONE, ARENA_FAST, ARENA_SLOW, NUMARENAS};
+
+#ifdef ZONE_ARENAS
+
+/* Level arenas
+ *
+ * Most of what a level allocates (mobjs, thinkers, sector nodes, the map
+ * itself) lives exactly until the next Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1).
+ * Those blocks are bump allocated from chunks that are kept from one level
+ * to the next, so that neither allocating nor freeing them goes through
+ * malloc. Small blocks go to an arena in fast internal RAM while the
+ * platform has some to spare, everything else to an arena in the big RAM.
+ *
+ * Freed small blocks are recycled by size; a bigger one is only given back
+ * if it was the last one allocated, otherwise it stays used until the
+ * arena is reset, which happens when the level is freed and nothing is
+ * left alive in it.
+ */
+
+typedef struct arenachunk {
+  struct arenachunk *next;
+  size_t size, used;
+} arenachunk_t;
+
+#define ARENA_HEADER ((sizeof(arenachunk_t)+CACHE_ALIGN-1) & ~(CACHE_ALIGN-1))
+
+typedef struct {
+  arenachunk_t *chunks, *cur;
+  memblock_t *recycle[ARENA_SMALL/CHUNK_SIZE+1];
+  zonearenastats_t stats;
+} arena_t;
+
+static arena_t arenas[NUMARENAS];
+
+static memblock_t *Z_ArenaTake(int a, size_t size)
+{
+  arena_t *arena = &arenas[a];
+  size_t total = size + HEADER_SIZE;
+  memblock_t *block;
+  arenachunk_t *chunk;
+
+  if (size <= ARENA_SMALL && (block = arena->recycle[size/CHUNK_SIZE]))
+    arena->recycle[size/CHUNK_SIZE] = block->next;
+  else
+  {
+    // chunks after the current one are empty since the last reset
+    for (chunk = arena->cur; chunk; chunk = chunk->next)
+      if (chunk->size - chunk->used >= total)
+        break;
+
+    if (!chunk)
+    {
+      size_t csize = a == ARENA_FAST ? ARENA_FAST_CHUNK : ARENA_CHUNK;
+
+      if (csize < ARENA_HEADER + total)
+        csize = ARENA_HEADER + total;
+
+      if (!(chunk = I_ZoneArenaAlloc(csize, a == ARENA_FAST)))
+        return NULL;
+      chunk->next = NULL;
+      chunk->size = csize - ARENA_HEADER;
+      chunk->used = 0;
+      if (arena->cur)
+      {
+        arenachunk_t *last = arena->cur;
+        while (last->next)
+          last = last->next;
+        last->next = chunk;
+      }
+      else
+        arena->chunks = chunk;
+      arena->stats.reserved += csize;
+    }
+
+    arena->cur = chunk;
+    block = (memblock_t *)((char *) chunk + ARENA_HEADER + chunk->used);
+    chunk->used += total;
+    arena->stats.used += total;
+    if (arena->stats.used > arena->stats.peak)
+      arena->stats.peak = arena->stats.used;
+  }
+
+  arena->stats.live += total;
+  block->arena = a;
+  return block;
+}
+
+static memblock_t *Z_ArenaAlloc(size_t size)
+{
+  memblock_t *block;
+
+  if (size <= ARENA_SMALL && (block = Z_ArenaTake(ARENA_FAST, size)))
+    return block;
+  return Z_ArenaTake(ARENA_SLOW, size);
+}
+
+static void Z_ArenaFree(memblock_t *block)
+{
+  arena_t *arena = &arenas[block->arena];
+  size_t total = block->size + HEADER_SIZE;
+  arenachunk_t *chunk = arena->cur;
+
+  arena->stats.live -= total;
+  if (block->size <= ARENA_SMALL)
+  {
+    block->next = arena->recycle[block->size/CHUNK_SIZE];
+    arena->recycle[block->size/CHUNK_SIZE] = block;
+  }
+  else if ((char *) block + total == (char *) chunk + ARENA_HEADER + chunk->used)
+  {
+    chunk->used -= total;
+    arena->stats.used -= total;
+  }
+}
+
+// How much of the arenas the level ended with is still alive
+static void Z_ArenaReport(void)
+{
+  arena_t *fast = &arenas[ARENA_FAST], *slow = &arenas[ARENA_SLOW];
+
+  lprintf(LO_INFO, "Z_FreeTags: level arenas: fast %luK live of %luK used, "
+          "slow %luK live of %luK used, %luK reserved\n",
+          (unsigned long) fast->stats.live >> 10, (unsigned long) fast->stats.used >> 10,
+          (unsigned long) slow->stats.live >> 10, (unsigned long) slow->stats.used >> 10,
+          (unsigned long) (fast->stats.reserved + slow->stats.reserved) >> 10);
+}
+
+// Forgets everything allocated in the arenas once the level is freed
+static void Z_ArenaReset(void)
+{
+  int a;
+
+  for (a = ARENA_FAST; a < NUMARENAS; a++)
+  {
+    arena_t *arena = &arenas[a];
+    arenachunk_t *chunk;
+
+    if (!arena->stats.used)
+      continue;
+    if (arena->stats.live)    // Z_ChangeTag'ed out of the level tags
+    {
+      arena->stats.pinned++;
+      continue;
+    }
+    for (chunk = arena->chunks; chunk; chunk = chunk->next)
+      chunk->used = 0;
+    arena->cur = arena->chunks;
+    memset(arena->recycle, 0, sizeof(arena->recycle));
+    arena->stats.used = 0;
+    arena->stats.resets++;
+  }
+}
+
+#endif
+
+void Z_GetArenaStats(zonearenastats_t *fast, zonearenastats_t *slow)
+{
+#ifdef ZONE_ARENAS
+  *fast = arenas[ARENA_FAST].stats;
+  *slow = arenas[ARENA_SLOW].stats;
+#else
+  memset(fast, 0, sizeof(*fast));
+  memset(slow, 0, sizeof(*slow));
+#endif
+}
+
+/* Memory census
+ *
+ * Blocks and bytes per tag and kind of RAM, kept by every allocation so
+ * that they can be looked at any time, not only in INSTRUMENTED builds.
+ */
+
+static census_t zonecensus[PU_MAX][2];
+
+static void Z_CensusCount(census_t *census, size_t bytes)
+{
+  census->count++;
+  if ((census->bytes += bytes) > census->peak)
+    census->peak = census->bytes;
+}
+
+static void Z_CensusAdd(const memblock_t *block)
+{
+  Z_CensusCount(&zonecensus[block->tag][block->fast], block->size + HEADER_SIZE);
+  Z_CensusCount(&zonecensus[PU_FREE][block->fast], block->size + HEADER_SIZE);
+}
+
+static void Z_CensusRemove(const memblock_t *block)
+{
+  census_t *census = &zonecensus[block->tag][block->fast];
+
+  census->count--;
+  census->bytes -= block->size + HEADER_SIZE;
+  census = &zonecensus[PU_FREE][block->fast];
+  census->count--;
+  census->bytes -= block->size + HEADER_SIZE;
+}
+
+void Z_GetCensus(census_t census[PU_MAX][2])
+{
+  I_LockShared();
+  memcpy(census, zonecensus, sizeof(zonecensus));
+  I_UnlockShared();
+}
+
+void Z_ResetCensusPeaks(void)
+{
+  int tag;
+
+  I_LockShared();
+  for (tag = 0; tag < PU_MAX; tag++)
+  {
+    zonecensus[tag][0].peak = zonecensus[tag][0].bytes;
+    zonecensus[tag][1].peak = zonecensus[tag][1].bytes;
+  }
+  I_UnlockShared();
+}
+
+void Z_CensusOwners(const void *lo, const void *hi, census_t *census)
+{
+  int tag;
+
+  census->count = 0;
+  census->bytes = 0;
+  I_LockShared();
+  for (tag = PU_FREE+1; tag < PU_MAX; tag++)
+  {
+    const memblock_t *block = blockbytag[tag];
+
+    if (block)
+      do
+      {
+        if ((const void *) block->user >= lo && (const void *) block->user < hi)
+        {
+          census->count++;
+          census->bytes += block->size + HEADER_SIZE;
+        }
+      } while ((block = block->next) != blockbytag[tag]);
+  }
+  I_UnlockShared();
+}
+
 // 0 means unlimited, any other value is a hard limit
 //static int memory_size = 8192*1024;
 static int memory_size = 0;
@@ -364,6 +619,8 @@ void *(Z_Malloc)(size_t size, int tag, void **user
 
   size = (size+CHUNK_SIZE-1) & ~(CHUNK_SIZE-1);  // round to chunk size
 
+  I_LockShared();                                // render threads allocate too
+
   if (memory_size > 0 && ((free_memory + memory_size) < (int)(size + HEADER_SIZE)))
   {
     memblock_t *end_block;
@@ -387,23 +644,32 @@ void *(Z_Malloc)(size_t size, int tag, void **user
     block = NULL;
   }
 
+#ifdef ZONE_ARENAS
+  if ((tag == PU_LEVEL || tag == PU_LEVSPEC) && (block = Z_ArenaAlloc(size)))
+    ;
+  else
+#endif
+  {
 #ifdef HAVE_LIBDMALLOC
-  while (!(block = dmalloc_malloc(file,line,size + HEADER_SIZE,DMALLOC_FUNC_MALLOC,0,0))) {
+    while (!(block = dmalloc_malloc(file,line,size + HEADER_SIZE,DMALLOC_FUNC_MALLOC,0,0))) {
 #else
-  while (!(block = (malloc)(size + HEADER_SIZE))) {
+    while (!(block = (malloc)(size + HEADER_SIZE))) {
 #endif
-    if (!blockbytag[PU_CACHE])
-      I_Error ("Z_Malloc: Failure trying to allocate %lu bytes"
+      if (!blockbytag[PU_CACHE])
+        I_Error ("Z_Malloc: Failure trying to allocate %lu bytes"
 #ifdef INSTRUMENTED
-               "\nSource: %s:%d"
+                 "\nSource: %s:%d"
 #endif
-               ,(unsigned long) size
+                 ,(unsigned long) size
 #ifdef INSTRUMENTED
-               , file, line
+                 , file, line
 #endif
-      );
-    Z_FreeTags(PU_CACHE,PU_CACHE);
+        );
+      Z_FreeTags(PU_CACHE,PU_CACHE);
+    }
+    block->arena = ARENA_NONE;
   }
+  block->fast = block->arena ? block->arena == ARENA_FAST : I_IsFastMemory(block);
 
   if (!blockbytag[tag])
   {
@@ -438,6 +704,7 @@ void *(Z_Malloc)(size_t size, int tag, void **user
 #endif
   block->tag = tag;           // tag
   block->user = user;         // user
+  Z_CensusAdd(block);
   block = (memblock_t *)((char *) block + HEADER_SIZE);
   if (user)                   // if there is a user
     *user = block;            // set user to point to new block
@@ -448,6 +715,7 @@ void *(Z_Malloc)(size_t size, int tag, void **user
   memset(block, gametic & 0xff, size);
 #endif
 
+  I_UnlockShared();
   return block;
 }
 
@@ -471,6 +739,7 @@ void (Z_Free)(void *p
   if (!p)
     return;
 
+  I_LockShared();
 
 #ifdef ZONEIDCHECK
   if (block->id != ZONEID)
@@ -496,6 +765,7 @@ void (Z_Free)(void *p
   block->next->prev = block->prev;
 
   free_memory += block->size;
+  Z_CensusRemove(block);
 #ifdef INSTRUMENTED
   if (block->tag >= PU_PURGELEVEL)
     purgable_memory -= block->size;
@@ -503,9 +773,14 @@ void (Z_Free)(void *p
     active_memory -= block->size;
 
   /* scramble memory -- weed out any bugs */
-  memset(block, gametic & 0xff, block->size + HEADER_SIZE);
+  memset((char *) block + HEADER_SIZE, gametic & 0xff, block->size);
 #endif
 
+#ifdef ZONE_ARENAS
+  if (block->arena)
+    Z_ArenaFree(block);
+  else
+#endif
 #ifdef HAVE_LIBDMALLOC
   dmalloc_free(file,line,block,DMALLOC_FUNC_MALLOC);
 #else
@@ -514,6 +789,7 @@ void (Z_Free)(void *p
 #ifdef INSTRUMENTED
       Z_DrawStats();           // print memory allocation stats
 #endif
+  I_UnlockShared();
 }
 
 void (Z_FreeTags)(int lowtag, int hightag
@@ -522,6 +798,10 @@ void (Z_FreeTags)(int lowtag, int hightag
 #endif
                  )
 {
+#ifdef ZONE_ARENAS
+  boolean levelfreed;
+#endif
+
 #ifdef HEAPDUMP
   Z_DumpMemory();
 #endif
@@ -532,6 +812,12 @@ void (Z_FreeTags)(int lowtag, int hightag
   if (hightag > PU_CACHE)
     hightag = PU_CACHE;
 
+#ifdef ZONE_ARENAS
+  levelfreed = lowtag <= PU_LEVEL && hightag >= PU_LEVSPEC;
+  if (levelfreed && devparm)
+    Z_ArenaReport();
+#endif
+
   for (;lowtag <= hightag; lowtag++)
   {
     memblock_t *block, *end_block;
@@ -552,6 +838,11 @@ void (Z_FreeTags)(int lowtag, int hightag
       block = next;               // Advance to next block
     }
   }
+
+#ifdef ZONE_ARENAS
+  if (levelfreed)
+    Z_ArenaReset();
+#endif
 }
 
 void (Z_ChangeTag)(void *ptr, int tag
@@ -566,9 +857,14 @@ void (Z_ChangeTag)(void *ptr, int tag
   if (!ptr)
     return;
 
+  I_LockShared();
+
   // proff - do nothing if tag doesn't differ
   if (tag == block->tag)
+  {
+    I_UnlockShared();
     return;
+  }
 
 #ifdef INSTRUMENTED
 #ifdef CHECKHEAP
@@ -632,7 +928,10 @@ void (Z_ChangeTag)(void *ptr, int tag
     }
 #endif
 
+  Z_CensusRemove(block);
   block->tag = tag;
+  Z_CensusAdd(block);
+  I_UnlockShared();
 }
 
 void *(Z_Realloc)(void *ptr, size_t n, int tag, void **user